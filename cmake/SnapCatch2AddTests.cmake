@@ -0,0 +1,193 @@
+# - Discover the test cases of a snapcatch2 test binary
+#
+# This script is included by ctest through the file generated by the
+# snapcatch2_add_tests() function (see SnapCatch2Config.cmake). It is not
+# expected to be used directly.
+#
+# The list of test cases is saved in ${SNAPCATCH2_CACHE_FILE} along the
+# SHA256 of the binary. The binary is only run again to list its test
+# cases once it changed.
+#
+# License:
+#
+# Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+#
+# https://snapwebsites.org/project/snapcatch2
+# contact@m2osw.com
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# ctest does not set any policy, make sure the list commands do not
+# silently drop empty elements
+#
+cmake_policy(SET CMP0007 NEW)
+
+
+# The list commands do not preserve escaped semicolons, so the semicolons
+# found in the names are replaced by this character while we work on them
+#
+string(ASCII 31 SNAPCATCH2_SEMICOLON)
+
+
+# Read a text file as a list of non-empty lines
+#
+# The semicolons found in the lines are replaced by ${SNAPCATCH2_SEMICOLON}
+# so they do not get viewed as list separators.
+#
+function(snapcatch2_read_lines FILENAME OUTPUT)
+    set(lines)
+    if(EXISTS "${FILENAME}")
+        file(READ "${FILENAME}" content)
+        string(REPLACE ";" "${SNAPCATCH2_SEMICOLON}" content "${content}")
+        string(REPLACE "\n" ";" lines "${content}")
+        list(FILTER lines EXCLUDE REGEX "^$")
+    endif()
+    set(${OUTPUT} "${lines}" PARENT_SCOPE)
+endfunction()
+
+
+if(NOT EXISTS "${SNAPCATCH2_EXECUTABLE}")
+    # the test fails since the command does not exist
+    #
+    add_test("${SNAPCATCH2_TARGET}_NOT_BUILT" "${SNAPCATCH2_TARGET}_NOT_BUILT")
+    return()
+endif()
+
+
+# get the list of test cases, from the cache if the binary did not change
+#
+file(SHA256 "${SNAPCATCH2_EXECUTABLE}" snapcatch2_hash)
+snapcatch2_read_lines("${SNAPCATCH2_CACHE_FILE}" snapcatch2_tests)
+list(LENGTH snapcatch2_tests snapcatch2_count)
+if(snapcatch2_count GREATER 0)
+    list(GET snapcatch2_tests 0 snapcatch2_cached_hash)
+else()
+    set(snapcatch2_cached_hash)
+endif()
+
+if(snapcatch2_cached_hash STREQUAL snapcatch2_hash)
+    list(REMOVE_AT snapcatch2_tests 0)
+else()
+    set(snapcatch2_list "${SNAPCATCH2_CACHE_FILE}.tmp")
+    execute_process(
+        COMMAND
+            "${SNAPCATCH2_EXECUTABLE}"
+                --list-tests
+                --verbosity quiet
+                --out "${snapcatch2_list}"
+                --tmp-dir "${SNAPCATCH2_TMP_DIR}/discovery"
+        WORKING_DIRECTORY
+            "${SNAPCATCH2_WORKING_DIRECTORY}"
+        TIMEOUT
+            ${SNAPCATCH2_DISCOVERY_TIMEOUT}
+        RESULT_VARIABLE
+            snapcatch2_result
+        OUTPUT_QUIET
+        ERROR_VARIABLE
+            snapcatch2_errors
+    )
+    if(NOT snapcatch2_result EQUAL 0)
+        message(WARNING
+            "snapcatch2: could not list the test cases of \"${SNAPCATCH2_EXECUTABLE}\""
+            " (${snapcatch2_result}):\n${snapcatch2_errors}")
+        add_test("${SNAPCATCH2_TARGET}_NOT_DISCOVERED" "${SNAPCATCH2_TARGET}_NOT_DISCOVERED")
+        return()
+    endif()
+
+    snapcatch2_read_lines("${snapcatch2_list}" snapcatch2_tests)
+    file(REMOVE "${snapcatch2_list}")
+
+    # the binary could have been rebuilt in between, this is fine since
+    # that means the next run of ctest lists the test cases again
+    #
+    list(JOIN snapcatch2_tests "\n" snapcatch2_content)
+    string(REPLACE "${SNAPCATCH2_SEMICOLON}" ";" snapcatch2_content "${snapcatch2_content}")
+    file(WRITE "${SNAPCATCH2_CACHE_FILE}" "${snapcatch2_hash}\n${snapcatch2_content}\n")
+endif()
+
+
+# load the duration of the previous runs, the last one wins
+#
+snapcatch2_read_lines("${SNAPCATCH2_TIMINGS}" snapcatch2_timings)
+set(snapcatch2_timings_count 0)
+set(snapcatch2_timed_tests)
+foreach(snapcatch2_line IN LISTS snapcatch2_timings)
+    string(FIND "${snapcatch2_line}" " " snapcatch2_pos)
+    if(snapcatch2_pos GREATER 0)
+        string(SUBSTRING "${snapcatch2_line}" 0 ${snapcatch2_pos} snapcatch2_seconds)
+        math(EXPR snapcatch2_pos "${snapcatch2_pos} + 1")
+        string(SUBSTRING "${snapcatch2_line}" ${snapcatch2_pos} -1 snapcatch2_name)
+        string(MD5 snapcatch2_key "${snapcatch2_name}")
+        if(NOT DEFINED snapcatch2_cost_${snapcatch2_key})
+            list(APPEND snapcatch2_timed_tests "${snapcatch2_name}")
+        endif()
+        set(snapcatch2_cost_${snapcatch2_key} "${snapcatch2_seconds}")
+        math(EXPR snapcatch2_timings_count "${snapcatch2_timings_count} + 1")
+    endif()
+endforeach()
+
+# the file gets appended to on each run, so compact it once in a while
+#
+list(LENGTH snapcatch2_timed_tests snapcatch2_count)
+math(EXPR snapcatch2_limit "${snapcatch2_count} * 4")
+if(snapcatch2_timings_count GREATER snapcatch2_limit)
+    set(snapcatch2_content)
+    foreach(snapcatch2_name IN LISTS snapcatch2_timed_tests)
+        string(MD5 snapcatch2_key "${snapcatch2_name}")
+        string(APPEND snapcatch2_content "${snapcatch2_cost_${snapcatch2_key}} ${snapcatch2_name}\n")
+    endforeach()
+    string(REPLACE "${SNAPCATCH2_SEMICOLON}" ";" snapcatch2_content "${snapcatch2_content}")
+    file(WRITE "${SNAPCATCH2_TIMINGS}" "${snapcatch2_content}")
+endif()
+
+
+# register one test per test case
+#
+set(snapcatch2_index 0)
+foreach(snapcatch2_name IN LISTS snapcatch2_tests)
+    string(REPLACE "${SNAPCATCH2_SEMICOLON}" ";" snapcatch2_test "${snapcatch2_name}")
+
+    # the name is used as a test spec, so escape the characters which
+    # have a special meaning in a spec
+    #
+    string(REGEX REPLACE "([]\\\\,[*\"~])" "\\\\\\1" snapcatch2_spec "${snapcatch2_test}")
+
+    set(snapcatch2_test "${SNAPCATCH2_TEST_PREFIX}${snapcatch2_test}")
+    add_test(
+        "${snapcatch2_test}"
+        "${SNAPCATCH2_EXECUTABLE}"
+            "${snapcatch2_spec}"
+            --source-dir "${SNAPCATCH2_SOURCE_DIR}"
+            --binary-dir "${SNAPCATCH2_BINARY_DIR}"
+            --tmp-dir "${SNAPCATCH2_TMP_DIR}/${snapcatch2_index}"
+            --timings "${SNAPCATCH2_TIMINGS}"
+            ${SNAPCATCH2_EXTRA_ARGS}
+    )
+
+    set(snapcatch2_properties WORKING_DIRECTORY "${SNAPCATCH2_WORKING_DIRECTORY}")
+    string(MD5 snapcatch2_key "${snapcatch2_name}")
+    if(DEFINED snapcatch2_cost_${snapcatch2_key})
+        list(APPEND snapcatch2_properties COST "${snapcatch2_cost_${snapcatch2_key}}")
+    endif()
+    set_tests_properties(
+        "${snapcatch2_test}"
+        PROPERTIES
+            ${snapcatch2_properties}
+            ${SNAPCATCH2_PROPERTIES}
+    )
+
+    math(EXPR snapcatch2_index "${snapcatch2_index} + 1")
+endforeach()
+
+# vim: ts=4 sw=4 et
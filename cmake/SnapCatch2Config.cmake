@@ -4,6 +4,9 @@
 # SNAPCATCH2_INCLUDE_DIRS - The SnapCatch2 include directories
 # SNAPCATCH2_LIBRARIES    - The libraries need to link against Catch2
 #
+# snapcatch2_add_tests(<target> ...) - Register each test case of <target>
+#                                      as a separate CTest test
+#
 # TBD: There is a libCatch2Main.a library, I don't think we want it because
 #      we use our own main() function in Snap! C++...
 #
@@ -60,4 +63,114 @@ find_package_handle_standard_args(
         SNAPCATCH2_LIBRARY
 )
 
+
+# Location of the script ctest runs to discover the test cases
+#
+set(SNAPCATCH2_ADD_TESTS_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/SnapCatch2AddTests.cmake)
+
+
+# Register each test case of a snapcatch2 test binary with CTest
+#
+# Usage:
+#
+#   snapcatch2_add_tests(<target>
+#       [TEST_PREFIX <prefix>]
+#       [SOURCE_DIR <dir>]
+#       [BINARY_DIR <dir>]
+#       [TMP_DIR <dir>]
+#       [TIMINGS <file>]
+#       [WORKING_DIRECTORY <dir>]
+#       [DISCOVERY_TIMEOUT <seconds>]
+#       [EXTRA_ARGS <arg> ...]
+#       [PROPERTIES <name> <value> ...]
+#   )
+#
+# The test cases are discovered when ctest starts by running the binary
+# with `--list-tests`. The list is cached along the SHA256 of the binary
+# so the binary only gets run again once it was rebuilt.
+#
+# Each test case runs in its own process with:
+#
+#   --source-dir <SOURCE_DIR>   (default: ${PROJECT_SOURCE_DIR})
+#   --binary-dir <BINARY_DIR>   (default: ${PROJECT_BINARY_DIR})
+#   --tmp-dir <TMP_DIR>/<n>     (default: ${CMAKE_CURRENT_BINARY_DIR}/tmp/<target>)
+#   --timings <TIMINGS>         (default: ${CMAKE_CURRENT_BINARY_DIR}/<target>-timings.txt)
+#
+# so tests running in parallel do not share (and delete) the same
+# temporary directory. The duration of the last run of each test case
+# found in the TIMINGS file is used as its COST property so `ctest -j`
+# starts the longest tests first.
+#
+# Note: the function expects a single configuration generator (i.e. make).
+#
+function(snapcatch2_add_tests TARGET)
+    cmake_parse_arguments(
+        ARG
+        ""
+        "TEST_PREFIX;SOURCE_DIR;BINARY_DIR;TMP_DIR;TIMINGS;WORKING_DIRECTORY;DISCOVERY_TIMEOUT"
+        "EXTRA_ARGS;PROPERTIES"
+        ${ARGN}
+    )
+
+    if(NOT TARGET ${TARGET})
+        message(FATAL_ERROR "snapcatch2_add_tests(): \"${TARGET}\" is not a target.")
+    endif()
+
+    if(NOT ARG_SOURCE_DIR)
+        set(ARG_SOURCE_DIR ${PROJECT_SOURCE_DIR})
+    endif()
+    if(NOT ARG_BINARY_DIR)
+        set(ARG_BINARY_DIR ${PROJECT_BINARY_DIR})
+    endif()
+    if(NOT ARG_TMP_DIR)
+        set(ARG_TMP_DIR ${CMAKE_CURRENT_BINARY_DIR}/tmp/${TARGET})
+    endif()
+    if(NOT ARG_TIMINGS)
+        set(ARG_TIMINGS ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}-timings.txt)
+    endif()
+    if(NOT ARG_WORKING_DIRECTORY)
+        set(ARG_WORKING_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR})
+    endif()
+    if(NOT ARG_DISCOVERY_TIMEOUT)
+        set(ARG_DISCOVERY_TIMEOUT 60)
+    endif()
+
+    set(ctest_include_file ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}-snapcatch2-tests.cmake)
+    file(GENERATE
+        OUTPUT
+            ${ctest_include_file}
+        CONTENT
+            "# generated by snapcatch2_add_tests(), do not edit
+#
+# ctest sets no policy; with CMP0011 the policies set by the script stay
+# in the script instead of generating a developer warning
+#
+cmake_policy(PUSH)
+cmake_policy(SET CMP0011 NEW)
+set(SNAPCATCH2_TARGET [==[${TARGET}]==])
+set(SNAPCATCH2_EXECUTABLE [==[$<TARGET_FILE:${TARGET}>]==])
+set(SNAPCATCH2_TEST_PREFIX [==[${ARG_TEST_PREFIX}]==])
+set(SNAPCATCH2_SOURCE_DIR [==[${ARG_SOURCE_DIR}]==])
+set(SNAPCATCH2_BINARY_DIR [==[${ARG_BINARY_DIR}]==])
+set(SNAPCATCH2_TMP_DIR [==[${ARG_TMP_DIR}]==])
+set(SNAPCATCH2_TIMINGS [==[${ARG_TIMINGS}]==])
+set(SNAPCATCH2_WORKING_DIRECTORY [==[${ARG_WORKING_DIRECTORY}]==])
+set(SNAPCATCH2_DISCOVERY_TIMEOUT [==[${ARG_DISCOVERY_TIMEOUT}]==])
+set(SNAPCATCH2_EXTRA_ARGS [==[${ARG_EXTRA_ARGS}]==])
+set(SNAPCATCH2_PROPERTIES [==[${ARG_PROPERTIES}]==])
+set(SNAPCATCH2_CACHE_FILE [==[${CMAKE_CURRENT_BINARY_DIR}/${TARGET}-snapcatch2-tests.list]==])
+include([==[${SNAPCATCH2_ADD_TESTS_SCRIPT}]==])
+cmake_policy(POP)
+"
+    )
+
+    set_property(
+        DIRECTORY
+        APPEND
+        PROPERTY
+            TEST_INCLUDE_FILES ${ctest_include_file}
+    )
+endfunction()
+
+
 # vim: ts=4 sw=4 et
@@ -44,6 +44,7 @@ mkdir -p ${OUTPUT_PATH}/projects/Generated
 		-DCMAKE_POSITION_INDEPENDENT_CODE=ON \
 		-DCATCH_CONFIG_POSIX_SIGNALS=OFF \
 		-DCATCH_CONFIG_NO_POSIX_SIGNALS=ON \
+		-DCATCH_CONFIG_THREAD_SAFE_ASSERTIONS=ON \
 			../..
 )
 
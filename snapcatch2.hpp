@@ -30,22 +30,91 @@
 #include    <catch2/catch_test_macros.hpp>
 #include    <catch2/catch_approx.hpp>
 #include    <catch2/matchers/catch_matchers.hpp>
+#include    <catch2/reporters/catch_reporter_event_listener.hpp>
+#include    <catch2/reporters/catch_reporter_registrars.hpp>
+#include    <catch2/reporters/catch_reporter_streaming_base.hpp>
+#include    <catch2/catch_assertion_result.hpp>
+#include    <catch2/catch_config.hpp>
+#include    <catch2/benchmark/detail/catch_benchmark_stats.hpp>
+#include    <catch2/catch_test_case_info.hpp>
+#include    <catch2/interfaces/catch_interfaces_capture.hpp>
+#include    <catch2/interfaces/catch_interfaces_registry_hub.hpp>
+#include    <catch2/interfaces/catch_interfaces_testcase.hpp>
+#include    <catch2/internal/catch_context.hpp>
+#include    <catch2/internal/catch_istream.hpp>
+#include    <catch2/internal/catch_reporter_registry.hpp>
+#include    <catch2/internal/catch_test_case_registry_impl.hpp>
 #pragma GCC diagnostic pop
 
 
 // C++
 //
+#include    <algorithm>
+#include    <atomic>
+#include    <charconv>
+#include    <chrono>
+#include    <cmath>
+#include    <condition_variable>
+#include    <cxxabi.h>
+#include    <deque>
+#include    <exception>
+#include    <filesystem>
 #include    <stdexcept>
 #include    <fstream>
+#include    <functional>
 #include    <iomanip>
 #include    <iostream>
+#include    <iterator>
+#include    <limits>
+#include    <map>
+#include    <memory>
+#include    <memory_resource>
+#include    <mutex>
+#include    <random>
+#include    <set>
 #include    <sstream>
+#if __cplusplus >= 202002L
+#include    <span>
+#endif
+#include    <string_view>
+#include    <thread>
+#include    <type_traits>
+#include    <vector>
 
 
 // C
 //
+#include    <dirent.h>
+#include    <dlfcn.h>
+#include    <fnmatch.h>
+#include    <errno.h>
+#include    <execinfo.h>
+#include    <elf.h>
+#include    <fcntl.h>
+#include    <link.h>
+#include    <netinet/in.h>
+#include    <poll.h>
+#include    <pthread.h>
+#include    <sched.h>
+#include    <signal.h>
 #include    <string.h>
+#include    <sys/epoll.h>
+#include    <sys/eventfd.h>
+#include    <sys/file.h>
+#include    <sys/inotify.h>
+#include    <sys/mman.h>
+#include    <sys/resource.h>
+#include    <sys/socket.h>
+#include    <sys/stat.h>
+#include    <sys/syscall.h>
+#include    <sys/time.h>
+#include    <sys/un.h>
+#include    <sys/wait.h>
+#include    <time.h>
 #include    <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include    <x86intrin.h>
+#endif
 
 
 /** \brief Allow for the literals defined by Catch.
@@ -430,23 +499,305 @@ inline void wctombs(std::string & out, char32_t wc)
 }
 
 
-inline std::string random_string(
-          std::size_t length_min
+namespace detail
+{
+
+
+/** \brief Check whether 8 bytes are all ASCII.
+ *
+ * This is the fast path of the UTF-8 functions. Eight bytes are tested
+ * at once with a single mask.
+ *
+ * \param[in] p  A pointer to at least 8 bytes.
+ *
+ * \return true if all 8 bytes are ASCII.
+ */
+inline bool is_ascii_block(char const * p)
+{
+    std::uint64_t v(0);
+    memcpy(&v, p, sizeof(v));
+    return (v & 0x8080808080808080ULL) == 0;
+}
+
+
+/** \brief Decode one UTF-8 sequence.
+ *
+ * Overlong sequences, surrogates and code points over 0x10FFFF are
+ * considered invalid.
+ *
+ * \param[in] p  The start of the sequence.
+ * \param[in] left  The number of bytes available at \p p.
+ * \param[out] wc  The decoded character.
+ *
+ * \return The length of the sequence or 0 if it is invalid.
+ */
+inline std::size_t decode_utf8_sequence(unsigned char const * p, std::size_t left, char32_t & wc)
+{
+    unsigned char const c(p[0]);
+    std::size_t length(0);
+    char32_t minimum(0);
+    if(c < 0x80)
+    {
+        wc = c;
+        return 1;
+    }
+    if(c >= 0xC2 && c <= 0xDF)
+    {
+        length = 2;
+        minimum = 0x80;
+        wc = c & 0x1F;
+    }
+    else if(c >= 0xE0 && c <= 0xEF)
+    {
+        length = 3;
+        minimum = 0x800;
+        wc = c & 0x0F;
+    }
+    else if(c >= 0xF0 && c <= 0xF4)
+    {
+        length = 4;
+        minimum = 0x10000;
+        wc = c & 0x07;
+    }
+    else
+    {
+        return 0;
+    }
+    if(left < length)
+    {
+        return 0;
+    }
+    for(std::size_t idx(1); idx < length; ++idx)
+    {
+        if((p[idx] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        wc = (wc << 6) | (p[idx] & 0x3F);
+    }
+    if(wc < minimum
+    || wc > 0x10FFFF
+    || (wc >= 0xD800 && wc <= 0xDFFF))
+    {
+        return 0;
+    }
+    return length;
+}
+
+
+/** \brief Decode or validate a UTF-8 string.
+ *
+ * When \p out is a nullptr, the function only validates the input.
+ *
+ * \param[in] in  The UTF-8 string.
+ * \param[out] out  The output buffer (at least `in.length()` characters)
+ * or nullptr.
+ * \param[out] count  The number of characters decoded.
+ *
+ * \return The offset of the first invalid byte or std::string_view::npos.
+ */
+inline std::size_t decode_utf8(std::string_view in, char32_t * out, std::size_t & count)
+{
+    char const * s(in.data());
+    std::size_t const size(in.length());
+    std::size_t pos(0);
+    count = 0;
+    while(pos < size)
+    {
+        while(pos + 8 <= size && is_ascii_block(s + pos))
+        {
+            if(out != nullptr)
+            {
+                for(std::size_t idx(0); idx < 8; ++idx)
+                {
+                    out[count + idx] = static_cast<char32_t>(s[pos + idx]);
+                }
+            }
+            count += 8;
+            pos += 8;
+        }
+        if(pos >= size)
+        {
+            break;
+        }
+
+        char32_t wc(U'\0');
+        std::size_t const length(decode_utf8_sequence(
+                  reinterpret_cast<unsigned char const *>(s + pos)
+                , size - pos
+                , wc));
+        if(length == 0)
+        {
+            return pos;
+        }
+        if(out != nullptr)
+        {
+            out[count] = wc;
+        }
+        ++count;
+        pos += length;
+    }
+
+    return std::string_view::npos;
+}
+
+
+} // detail namespace
+
+
+/** \brief Find the first invalid byte of a UTF-8 string.
+ *
+ * Runs of ASCII characters are checked 8 bytes at a time.
+ *
+ * \param[in] s  The string to validate.
+ *
+ * \return The offset of the first invalid byte or std::string_view::npos
+ * if the whole string is valid.
+ */
+inline std::size_t find_invalid_utf8(std::string_view s)
+{
+    std::size_t count(0);
+    return detail::decode_utf8(s, nullptr, count);
+}
+
+
+/** \brief Convert a UTF-8 string to UTF-32 in a caller provided buffer.
+ *
+ * The \p out buffer must be large enough for `in.length()` characters.
+ *
+ * \exception std::runtime_error
+ * The input is not valid UTF-8.
+ *
+ * \param[in] in  The UTF-8 string.
+ * \param[out] out  The output buffer.
+ *
+ * \return The number of characters written to \p out.
+ */
+inline std::size_t utf8_to_utf32(std::string_view in, char32_t * out)
+{
+    std::size_t count(0);
+    std::size_t const pos(detail::decode_utf8(in, out, count));
+    if(pos != std::string_view::npos)
+    {
+        throw std::runtime_error("invalid UTF-8 sequence at offset " + std::to_string(pos) + ".");
+    }
+    return count;
+}
+
+
+inline std::u32string utf8_to_utf32(std::string_view in)
+{
+    std::u32string result(in.length(), U'\0');
+    result.resize(utf8_to_utf32(in, result.data()));
+    return result;
+}
+
+
+/** \brief Convert a UTF-32 string to UTF-8 in a caller provided buffer.
+ *
+ * This is the bulk version of wctombs(). The \p out buffer must be large
+ * enough for `in.length() * 4` bytes. Runs of ASCII characters are
+ * converted 8 characters at a time.
+ *
+ * \exception std::runtime_error
+ * The input includes a surrogate or a character over 0x10FFFF.
+ *
+ * \param[in] in  The UTF-32 string.
+ * \param[out] out  The output buffer.
+ *
+ * \return The number of bytes written to \p out.
+ */
+inline std::size_t utf32_to_utf8(std::u32string_view in, char * out)
+{
+    char32_t const * s(in.data());
+    std::size_t const size(in.length());
+    char * const start(out);
+    std::size_t pos(0);
+    while(pos < size)
+    {
+        while(pos + 8 <= size
+           && (s[pos + 0] | s[pos + 1] | s[pos + 2] | s[pos + 3]
+             | s[pos + 4] | s[pos + 5] | s[pos + 6] | s[pos + 7]) < 0x80)
+        {
+            for(std::size_t idx(0); idx < 8; ++idx)
+            {
+                out[idx] = static_cast<char>(s[pos + idx]);
+            }
+            out += 8;
+            pos += 8;
+        }
+        if(pos >= size)
+        {
+            break;
+        }
+
+        char32_t const wc(s[pos]);
+        if(wc < 0x80)
+        {
+            *out++ = static_cast<char>(wc);
+        }
+        else if(wc < 0x800)
+        {
+            *out++ = static_cast<char>((wc >> 6) | 0xC0);
+            *out++ = static_cast<char>((wc & 0x3F) | 0x80);
+        }
+        else if(wc < 0x10000)
+        {
+            if(wc >= 0xD800 && wc <= 0xDFFF)
+            {
+                throw std::runtime_error("surrogate found in UTF-32 string at position " + std::to_string(pos) + ".");
+            }
+            *out++ = static_cast<char>((wc >> 12) | 0xE0);
+            *out++ = static_cast<char>(((wc >> 6) & 0x3F) | 0x80);
+            *out++ = static_cast<char>((wc & 0x3F) | 0x80);
+        }
+        else if(wc < 0x110000)
+        {
+            *out++ = static_cast<char>((wc >> 18) | 0xF0);
+            *out++ = static_cast<char>(((wc >> 12) & 0x3F) | 0x80);
+            *out++ = static_cast<char>(((wc >> 6) & 0x3F) | 0x80);
+            *out++ = static_cast<char>((wc & 0x3F) | 0x80);
+        }
+        else
+        {
+            throw std::runtime_error("invalid character in UTF-32 string at position " + std::to_string(pos) + ".");
+        }
+        ++pos;
+    }
+
+    return static_cast<std::size_t>(out - start);
+}
+
+
+inline std::string utf32_to_utf8(std::u32string_view in)
+{
+    std::string result(in.length() * 4, '\0');
+    result.resize(utf32_to_utf8(in, result.data()));
+    return result;
+}
+
+
+namespace detail
+{
+
+
+inline void append_random_string(
+          std::string & result
+        , std::size_t length_min
         , std::size_t length_max // inclusive
-        , character_t category = character_t::CHARACTER_ASCII)
+        , character_t category)
 {
     std::size_t length(0);
     random(length);
     length = length % (length_max + 1 - length_min) + length_min;
 
-    std::string result;
     for(std::size_t i(0); i < length; ++i)
     {
         char32_t c(random_char(category));
 
         // labels cannot start with a digit
         //
-        while(result.empty()
+        while(i == 0
            && category == character_t::CHARACTER_LABEL
            && c >= '0'
            && c <= '9')
@@ -456,7 +807,19 @@ inline std::string random_string(
 
         wctombs(result, c);
     }
+}
+
 
+} // detail namespace
+
+
+inline std::string random_string(
+          std::size_t length_min
+        , std::size_t length_max // inclusive
+        , character_t category = character_t::CHARACTER_ASCII)
+{
+    std::string result;
+    detail::append_random_string(result, length_min, length_max, category);
     return result;
 }
 
@@ -479,6 +842,200 @@ inline std::vector<std::uint8_t> random_buffer(
 }
 
 
+/** \brief A string allocated in an arena.
+ *
+ * Use g_arena() to create such strings in the arena of the current
+ * section:
+ *
+ * \code
+ *     SNAP_CATCH2_NAMESPACE::arena_string s(SNAP_CATCH2_NAMESPACE::g_arena());
+ * \endcode
+ */
+typedef std::pmr::string                arena_string;
+
+template<typename T>
+using arena_vector = std::pmr::vector<T>;
+
+template<typename K, typename V, typename C = std::less<K>>
+using arena_map = std::pmr::map<K, V, C>;
+
+
+namespace detail
+{
+
+
+/** \brief The arenas of the current test case and sections.
+ *
+ * Each time Catch2 enters a section (the test case itself is the first
+ * section), a new monotonic arena is made current. When the section
+ * exits, everything allocated in that arena is released at once.
+ *
+ * Each level keeps its first block of memory so entering and leaving
+ * sections over and over does not allocate anything unless the data
+ * grows over that first block.
+ *
+ * \warning
+ * The arenas are not thread safe. Only allocate from the thread running
+ * the test case.
+ */
+class section_arena
+{
+public:
+    static constexpr std::size_t const INITIAL_SIZE = 64 * 1024;
+
+    static section_arena & instance()
+    {
+        static section_arena arena;
+
+        return arena;
+    }
+
+    section_arena(section_arena const &) = delete;
+    section_arena & operator = (section_arena const &) = delete;
+
+    void push()
+    {
+        if(m_depth == m_levels.size())
+        {
+            level_t l;
+            l.f_buffer = std::make_unique<std::byte[]>(INITIAL_SIZE);
+            l.f_resource = std::make_unique<std::pmr::monotonic_buffer_resource>(l.f_buffer.get(), INITIAL_SIZE);
+            m_levels.push_back(std::move(l));
+        }
+        ++m_depth;
+    }
+
+    void pop()
+    {
+        if(m_depth > 0)
+        {
+            --m_depth;
+            m_levels[m_depth].f_resource->release();
+        }
+    }
+
+    void clear()
+    {
+        while(m_depth > 0)
+        {
+            pop();
+        }
+    }
+
+    std::pmr::memory_resource * current() const
+    {
+        if(m_depth == 0)
+        {
+            return std::pmr::get_default_resource();
+        }
+        return m_levels[m_depth - 1].f_resource.get();
+    }
+
+private:
+    struct level_t
+    {
+        std::unique_ptr<std::byte[]>                            f_buffer = std::unique_ptr<std::byte[]>();
+        std::unique_ptr<std::pmr::monotonic_buffer_resource>    f_resource = std::unique_ptr<std::pmr::monotonic_buffer_resource>();
+    };
+
+    section_arena()
+    {
+    }
+
+    std::vector<level_t>    m_levels = std::vector<level_t>();
+    std::size_t             m_depth = 0;
+};
+
+
+} // detail namespace
+
+
+/** \brief Get the arena of the current section.
+ *
+ * This function returns the memory resource of the innermost section
+ * currently running. The memory allocated from it is released in bulk
+ * when that section exits, so generated test data does not go through
+ * malloc() and free() each time.
+ *
+ * Outside of a test case (or when snap_catch2_main() is not used), the
+ * function returns the default memory resource.
+ *
+ * \code
+ *     SNAP_CATCH2_NAMESPACE::arena_vector<int> values(SNAP_CATCH2_NAMESPACE::g_arena());
+ * \endcode
+ *
+ * \return The memory resource of the current section.
+ */
+inline std::pmr::memory_resource * g_arena()
+{
+    return detail::section_arena::instance().current();
+}
+
+
+/** \brief Generate a random string in an arena.
+ *
+ * This overload does the same as random_string() except that the string
+ * is saved in \p arena and a view is returned. The view remains valid
+ * until the arena is released (i.e. the section using g_arena() exits).
+ *
+ * \param[in] arena  The arena where the string is allocated.
+ * \param[in] length_min  The minimum number of characters.
+ * \param[in] length_max  The maximum number of characters (inclusive).
+ * \param[in] category  The category of characters to generate.
+ *
+ * \return A view of the string in \p arena.
+ */
+inline std::string_view random_string(
+          std::pmr::memory_resource * arena
+        , std::size_t length_min
+        , std::size_t length_max // inclusive
+        , character_t category = character_t::CHARACTER_ASCII)
+{
+    // the scratch buffer keeps its capacity between calls
+    //
+    thread_local std::string scratch;
+    scratch.clear();
+    detail::append_random_string(scratch, length_min, length_max, category);
+
+    char * data(static_cast<char *>(arena->allocate(scratch.length() + 1, alignof(char))));
+    memcpy(data, scratch.c_str(), scratch.length() + 1);
+    return std::string_view(data, scratch.length());
+}
+
+
+#if __cplusplus >= 202002L
+/** \brief Generate a random buffer in an arena.
+ *
+ * This overload does the same as random_buffer() except that the buffer
+ * is allocated in \p arena. The span remains valid until the arena is
+ * released.
+ *
+ * \param[in] arena  The arena where the buffer is allocated.
+ * \param[in] size_min  The minimum size of the buffer.
+ * \param[in] size_max  The maximum size of the buffer (inclusive).
+ *
+ * \return A span over the buffer in \p arena.
+ */
+inline std::span<std::uint8_t> random_buffer(
+          std::pmr::memory_resource * arena
+        , std::size_t size_min  // inclusive
+        , std::size_t size_max) // inclusive
+{
+    std::size_t size(0);
+    random(size);
+    size = size % (size_max + 1 - size_min) + size_min;
+
+    std::uint8_t * data(static_cast<std::uint8_t *>(arena->allocate(std::max<std::size_t>(size, 1), alignof(std::uint8_t))));
+    for(std::size_t i(0); i < size; ++i)
+    {
+        random(data[i]);
+    }
+
+    return std::span<std::uint8_t>(data, size);
+}
+#endif
+
+
 namespace detail
 {
 
@@ -568,585 +1125,10110 @@ inline bool & g_verbose()
 }
 
 
-#ifdef CATCH_CONFIG_RUNNER
-/** \brief The main function to initialize and run the unit tests.
+/** \brief The default time limit of one test case.
  *
- * This inline function initializes and runs the snapcatch2 tests.
+ * This value is set with the `--test-timeout <seconds>` command line
+ * option. When not zero, a watchdog thread verifies that each test case
+ * completes within that amount of time. If a test case takes longer,
+ * the watchdog dumps the stacks of all the threads, the name of the
+ * test case and section being run and records the test case as a
+ * failure.
  *
- * The \p init_callback parameter is used to initialize your test before
- * we parse the command line. Use the \p callback function to do further
- * initialization after the command line is parsed and basic functions
- * run (i.e. the `--version` command line option will run and the
- * function exit before \p callback gets called. So when the user uses
- * that command line option, you do not get \p callback called, however,
- * \p init_callback will always be called).
+ * A test case can override the default with a tag such as
+ * `[timeout=300]`. A value of 0 in the tag turns the watchdog off
+ * for that test case.
  *
- * We do it this way because the function will try/catch std::exception
- * so if an exception occurs in your \p init_callback, it will always
- * be captured and a message printed out before the application
- * exits cleanly with an error code (i.e. `exit(1)`).
+ * \return A read-write reference to the test timeout in seconds.
+ */
+inline int & g_test_timeout()
+{
+    static int timeout = 0;
+
+    return timeout;
+}
+
+
+/** \brief Whether each test case runs in its own process.
  *
- * The \p init_callback can be set to a nullptr if you do not need to
- * initialize anything futher early on.
+ * This flag is set by the `--isolate` command line option. In that mode,
+ * the snap_catch2_main() function runs the initialization once and then
+ * forks one child process per test case. A test case which crashes or
+ * pollutes the global state of the process does not affect the other
+ * test cases.
  *
- * One thing we use the \p init_callback for is to prevent our
- * libexcept exceptions from generating a stack trace because that's
- * very slow and in a test which generate thousands if not million
- * of exception cases, it makes it really very slow.
+ * \return A read-write reference to the `isolate` flag.
+ */
+inline bool & g_isolate()
+{
+    static bool isolate = false;
+
+    return isolate;
+}
+
+
+/** \brief The number of test cases to run concurrently.
  *
- * \code
- *     snap_catch2_main(
- *           "libutf8"
- *         , "1.2.3"
- *         , argc
- *         , argv
- *         , []() { libexcept::set_collect_stack(libexcept::collect_stack_t::COLLECT_STACK_NO); }
- *     );
- * \endcode
+ * This value is set by the `--jobs <count>` command line option. It is
+ * only used along the `--isolate` option since only child processes can
+ * safely run test cases in parallel.
  *
- * The \p add_user_options parameter is a pointer to a function which
- * adds command line options supported by your test. This pointer can
- * be set to nullptr, For example, if you wanted to support a path to
- * a temporary directory, you would write:
+ * \return A read-write reference to the number of jobs.
+ */
+inline int & g_jobs()
+{
+    static int jobs = 1;
+
+    return jobs;
+}
+
+
+/** \brief The seed used to initialize the random number generators.
  *
- * \code
- *     namespace SNAP_CATCH2_NAMESPACE
- *     {
+ * This value is set by the snap_catch2_main() function once the command
+ * line was parsed. It is either the value of the `--seed` command line
+ * option or the time when the test started.
  *
- *     std::string g_conf_dir = std::string("/etc/config");
+ * \return A read-write reference to the seed.
+ */
+inline unsigned int & g_seed()
+{
+    static unsigned int seed = 0;
+
+    return seed;
+}
+
+
+/** \brief Whether passing test cases that did not change are skipped.
  *
- *     Catch::Clara::Parser add_command_line_options(Catch::Clara::Parser const & cli)
- *     {
- *         return cli
- *              | Catch::Clara::Opt(g_conf_dir, "conf-dir")
- *                   ["--conf-dir"]
- *                   ("a path to a configuration directory used by the test.");
- *     }
+ * This flag is set by the `--skip-unchanged` command line option. When
+ * set, the results of the test cases are saved in a cache under the
+ * g_binary_dir() folder. A test case which passed is skipped on the next
+ * run if its key did not change. The key is a hash of the build-id of the
+ * binaries loaded in memory, the name of the test case, the seed and the
+ * contents of the input files declared with an `[input=<path>]` tag.
+ * The path is relative to g_source_dir() and it can be a directory.
  *
- *     }
+ * \note
+ * Since the seed is part of the key, you want to use `--seed <value>`
+ * along this option. Otherwise each run gets a new seed and nothing
+ * ever gets skipped.
  *
- *     ...snip...
+ * \return A read-write reference to the `skip_unchanged` flag.
+ */
+inline bool & g_skip_unchanged()
+{
+    static bool skip_unchanged = false;
+
+    return skip_unchanged;
+}
+
+
+/** \brief Whether the output of the test cases gets captured.
  *
- *     snap_catch2_main(
- *           "libutf8"
- *         , "1.2.3"
- *         , argc
- *         , argv
- *         , nullptr
- *         , &add_command_line_options
- *     );
- * \endcode
+ * This flag is set by the `--capture` command line option. In that mode,
+ * everything written to stdout and stderr while a test case runs is
+ * saved in memory and only printed if the test case fails. This allows
+ * for running with `--verbose` without paying for the terminal output
+ * of the test cases which pass.
  *
- * \warning
- * It is possible to add a one letter command line option such as ["-t"],
- * however, catch2 already uses most of these options. The `-t` is used
- * to list tags, for example.
+ * With `--isolate`, the output of the children is already buffered and
+ * only shown on failure, so this flag is ignored.
  *
- * The \p callback function gets called just before the tests run.
- * In other words, we give you one more chance to verify command line
- * parameters or do additional initilalizations, now that you have access
- * to the user defined command line parameters. We pass the session to
- * the function, although in many cases you will not use it because your
- * parameters are already set as expected.
+ * \return A read-write reference to the `capture` flag.
+ */
+inline bool & g_capture()
+{
+    static bool capture = false;
+
+    return capture;
+}
+
+
+/** \brief Whether the test cases most likely to fail run first.
  *
- * \code
- *     namespace SNAP_CATCH2_NAMESPACE
- *     {
+ * This flag is set by the `--failed-first` command line option. The
+ * test cases which failed recently run first, then the new test cases
+ * and the ones which source file changed, then the others. Within each
+ * group, the fastest test cases run first. Along `--abort`, this gives
+ * the first failure as quickly as possible.
+ *
+ * The history of the previous runs is saved under g_binary_dir().
+ *
+ * \note
+ * Catch2 does not offer a way to change the order of the test cases
+ * running in one process so this option must be used along `--isolate`.
+ *
+ * \return A read-write reference to the `failed_first` flag.
+ */
+inline bool & g_failed_first()
+{
+    static bool failed_first = false;
+
+    return failed_first;
+}
+
+
+/** \brief Whether the tests run again each time their input changes.
+ *
+ * This flag is set by the `--watch` command line option. Once the
+ * selected test cases ran, the process waits for one of their input
+ * files (see the `[input=<path>]` tags) to change and runs the affected
+ * test cases again, without restarting the process. When the test binary
+ * itself gets rebuilt, the process executes it again with the same
+ * command line.
+ *
+ * \return A read-write reference to the `watch` flag.
+ */
+inline bool & g_watch()
+{
+    static bool watch = false;
+
+    return watch;
+}
+
+
+/** \brief The file where the duration of each test case gets appended.
+ *
+ * This parameter is set by the `--timings <file>` command line option.
+ * When not empty, one line per test case that ran is appended to
+ * \p file: the duration in seconds, a space, and the name of the test
+ * case. The `snapcatch2_add_tests()` CMake function reads that file to
+ * set the COST property of each test so `ctest -j` starts the longest
+ * tests first.
+ *
+ * \return A read-write reference to the `timings` parameter.
+ */
+inline std::string & g_timings()
+{
+    static std::string timings = std::string();
+
+    return timings;
+}
+
+
+/** \brief The journal where the completed test cases get saved.
+ *
+ * This parameter is set by the `--checkpoint <journal>` command line
+ * option. When not empty, a line is appended to the journal each time
+ * a test case completes along the seeds used by the run. If the process
+ * dies (OOM killer, machine preemption...), the `--resume <journal>`
+ * option starts a new process which skips the test cases found in the
+ * journal.
+ *
+ * \return A read-write reference to the `checkpoint` parameter.
+ */
+inline std::string & g_checkpoint()
+{
+    static std::string checkpoint = std::string();
+
+    return checkpoint;
+}
+
+
+/** \brief The journal of the run to resume.
+ *
+ * This parameter is set by the `--resume <journal>` command line option.
+ * The seeds saved in the journal are used again, the test cases which
+ * completed are skipped and the new results get appended to the same
+ * journal. Once done, the report merges all the results found in the
+ * journal. That report is text only so this option can only be used
+ * with the console and compact reporters writing to stdout.
+ *
+ * \return A read-write reference to the `resume` parameter.
+ */
+inline std::string & g_resume()
+{
+    static std::string resume = std::string();
+
+    return resume;
+}
+
+
+/** \brief The CPUs the benchmarks run on.
+ *
+ * This parameter is set by the `--benchmark-cpus <list>` command line
+ * option. The list is a comma separated list of CPU numbers and ranges
+ * such as `2,4-7`. The whole process is pinned to those CPUs before the
+ * tests start, not just the benchmarks: every thread already running and
+ * all the threads created later (by the tests, the watchdog, the
+ * profiler...) run on those CPUs for the entire run.
+ *
+ * \return A read-write reference to the `benchmark_cpus` parameter.
+ */
+inline std::string & g_benchmark_cpus()
+{
+    static std::string benchmark_cpus = std::string();
+
+    return benchmark_cpus;
+}
+
+
+/** \brief Whether the memory of the process gets locked.
+ *
+ * This flag is set by the `--benchmark-lock-memory` command line option.
+ * When set, mlockall() is called so page faults and swapping do not add
+ * noise to the benchmarks.
+ *
+ * \return A read-write reference to the `benchmark_lock_memory` flag.
+ */
+inline bool & g_benchmark_lock_memory()
+{
+    static bool benchmark_lock_memory = false;
+
+    return benchmark_lock_memory;
+}
+
+
+/** \brief The maximum number of seconds spent warming up the CPU.
+ *
+ * This parameter is set by the `--benchmark-stabilize <seconds>` command
+ * line option. When not zero, a busy loop runs before the tests until
+ * its speed stops changing (i.e. the CPU frequency is stable) or the
+ * number of seconds elapsed.
+ *
+ * \return A read-write reference to the `benchmark_stabilize` parameter.
+ */
+inline double & g_benchmark_stabilize()
+{
+    static double benchmark_stabilize = 0.0;
+
+    return benchmark_stabilize;
+}
+
+
+/** \brief The noise level above which a benchmark is flagged.
+ *
+ * This parameter is set by the `--benchmark-noise <percent>` command line
+ * option. A benchmark which standard deviation is larger than this
+ * percentage of its mean is reported as unreliable. The default is 0
+ * which turns the check off.
+ *
+ * \return A read-write reference to the `benchmark_noise` parameter.
+ */
+inline double & g_benchmark_noise()
+{
+    static double benchmark_noise = 0.0;
+
+    return benchmark_noise;
+}
+
+
+/** \brief The file where the profiler saves its folded stacks.
+ *
+ * This parameter is set by the `--profile <file>` command line option.
+ * When not empty, a sampling profiler runs while the test cases run and
+ * the samples are saved in \p file in the folded stack format used by
+ * flame graph tools (one line per stack, the frames separated by
+ * semicolons, followed by the number of samples).
+ *
+ * The first frames are the name of the test case and of its sections
+ * so each test case gets its own tower in the flame graph.
+ *
+ * \return A read-write reference to the `profile` parameter.
+ */
+inline std::string & g_profile()
+{
+    static std::string profile = std::string();
+
+    return profile;
+}
+
+
+/** \brief The number of profiler samples per second.
+ *
+ * This parameter is set by the `--profile-frequency <hz>` command line
+ * option. It defaults to 997 (a prime number so the sampling does not
+ * align with periodic work in the tests).
+ *
+ * \return A read-write reference to the `profile_frequency` parameter.
+ */
+inline int & g_profile_frequency()
+{
+    static int profile_frequency = 997;
+
+    return profile_frequency;
+}
+
+
+/** \brief Select which test cases get profiled.
+ *
+ * This parameter is set by the `--profile-filter <pattern>` command line
+ * option. It is a shell pattern (see fnmatch(3)) matched against the
+ * name of the test cases. When empty, all the test cases are profiled.
+ *
+ * \return A read-write reference to the `profile_filter` parameter.
+ */
+inline std::string & g_profile_filter()
+{
+    static std::string profile_filter = std::string();
+
+    return profile_filter;
+}
+
+
+/** \brief Whether the latency measurements get saved.
+ *
+ * This flag is set by the `--save-latency` command line option. When
+ * true, measure_latency() saves the percentile table of each measurement
+ * in `latency-<name>.csv` in the binary directory.
+ *
+ * \return A read-write reference to the `save_latency` flag.
+ */
+inline bool & g_save_latency()
+{
+    static bool save_latency = false;
+
+    return save_latency;
+}
+
+
+namespace detail
+{
+
+
+/** \brief The state of the virtual time.
+ *
+ * While a virtual_time object exists, the virtual clock is frozen at the
+ * time the object was created and only moves forward when advance() or
+ * a sleep function is called.
+ *
+ * Threads which must see the real time (i.e. the watchdog) set the
+ * bypass() flag.
+ *
+ * In automatic mode, only the thread which started the virtual time
+ * (the owner()) moves the clock when it sleeps. Other threads wait for
+ * the clock to reach their deadline as in manual mode, otherwise a
+ * background thread sleeping in a loop would make the clock run away.
+ */
+class virtual_time_state
+{
+public:
+    static virtual_time_state & instance()
+    {
+        static virtual_time_state state;
+
+        return state;
+    }
+
+    virtual_time_state(virtual_time_state const &) = delete;
+    virtual_time_state & operator = (virtual_time_state const &) = delete;
+
+    static bool & bypass()
+    {
+        static thread_local bool bypass = false;
+
+        return bypass;
+    }
+
+    static bool & owner()
+    {
+        static thread_local bool owner = false;
+
+        return owner;
+    }
+
+    bool active() const
+    {
+        return m_active.load(std::memory_order_acquire) && !bypass();
+    }
+
+    void start(bool manual)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_active.load(std::memory_order_relaxed))
+        {
+            throw std::logic_error("virtual time is already active.");
+        }
+        m_monotonic_base = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        m_realtime_base = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+        m_offset.store(0, std::memory_order_relaxed);
+        m_manual = manual;
+        owner() = true;
+        m_active.store(true, std::memory_order_release);
+    }
+
+    void stop()
+    {
+        owner() = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active.store(false, std::memory_order_release);
+        }
+        m_changed.notify_all();
+    }
+
+    std::int64_t offset() const
+    {
+        return m_offset.load(std::memory_order_acquire);
+    }
+
+    std::int64_t monotonic() const
+    {
+        return m_monotonic_base + offset();
+    }
+
+    std::int64_t realtime() const
+    {
+        return m_realtime_base + offset();
+    }
+
+    void advance(std::int64_t ns)
+    {
+        if(ns <= 0)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_offset.fetch_add(ns, std::memory_order_acq_rel);
+        }
+        m_changed.notify_all();
+    }
+
+    /** \brief Sleep until the virtual monotonic clock reaches \p deadline.
+     *
+     * In automatic mode, when called by the owner() thread, the clock
+     * jumps to the deadline and the function returns immediately.
+     * Otherwise the function waits until another thread advances the
+     * clock far enough.
+     *
+     * \param[in] deadline  The monotonic time to wait for in nanoseconds.
+     */
+    void sleep_until(std::int64_t deadline)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(!m_manual
+        && owner())
+        {
+            std::int64_t const ns(deadline - monotonic());
+            if(ns > 0)
+            {
+                m_offset.fetch_add(ns, std::memory_order_acq_rel);
+                lock.unlock();
+                m_changed.notify_all();
+            }
+            return;
+        }
+        ++m_sleepers;
+        m_changed.notify_all();
+        m_changed.wait(lock, [this, deadline]()
+            {
+                return !m_active.load(std::memory_order_acquire)
+                    || monotonic() >= deadline;
+            });
+        --m_sleepers;
+    }
+
+    void wait_for_sleepers(std::size_t count)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this, count]()
+            {
+                return m_sleepers >= count;
+            });
+    }
+
+private:
+    virtual_time_state()
+    {
+    }
+
+    std::mutex                  m_mutex = std::mutex();
+    std::condition_variable     m_changed = std::condition_variable();
+    std::atomic<bool>           m_active = false;
+    std::atomic<std::int64_t>   m_offset = 0;
+    bool                        m_manual = false;
+    std::size_t                 m_sleepers = 0;
+    std::int64_t                m_monotonic_base = 0;
+    std::int64_t                m_realtime_base = 0;
+};
+
+
+} // detail namespace
+
+
+/** \brief Run a test with a virtual clock.
+ *
+ * Create this object at the start of a test which depends on time
+ * (timeouts, retries, expirations, etc.) From then on, the virtual_clock
+ * is frozen and only moves forward when advance() is called or when the
+ * code sleeps.
+ *
+ * In the MODE_AUTO_ADVANCE mode (the default), a sleep in the thread
+ * which created this object moves the clock forward by the sleep
+ * duration and returns immediately. A sleep in any other thread waits
+ * until the clock reaches its deadline, as in MODE_MANUAL. In MODE_MANUAL
+ * mode, a sleeping thread waits until the test calls advance() far
+ * enough, which is useful to drive timer threads step by step.
+ *
+ * \code
+ *     SNAP_CATCH2_NAMESPACE::virtual_time vt;
+ *     cache c;
+ *     c.set("key", "value", 60s);
+ *     vt.advance(61s);
+ *     CATCH_REQUIRE_FALSE(c.has("key"));
+ * \endcode
+ *
+ * The code under test sees the virtual time if it uses the
+ * virtual_clock and virtual_time::sleep_for() or, when the test binary
+ * is compiled with SNAP_CATCH2_VIRTUAL_TIME, if it uses std::chrono
+ * clocks, time(), clock_gettime(), sleep(), usleep(), nanosleep(), or
+ * std::this_thread::sleep_for().
+ */
+class virtual_time
+{
+public:
+    enum class mode_t
+    {
+        MODE_AUTO_ADVANCE,
+        MODE_MANUAL,
+    };
+
+    virtual_time(mode_t mode = mode_t::MODE_AUTO_ADVANCE)
+    {
+        detail::virtual_time_state::instance().start(mode == mode_t::MODE_MANUAL);
+    }
+
+    virtual_time(virtual_time const &) = delete;
+    virtual_time & operator = (virtual_time const &) = delete;
+
+    ~virtual_time()
+    {
+        detail::virtual_time_state::instance().stop();
+    }
+
+    void advance(std::chrono::nanoseconds duration)
+    {
+        detail::virtual_time_state::instance().advance(duration.count());
+    }
+
+    std::chrono::nanoseconds elapsed() const
+    {
+        return std::chrono::nanoseconds(detail::virtual_time_state::instance().offset());
+    }
+
+    /** \brief Wait until threads are sleeping.
+     *
+     * In MODE_MANUAL, this function blocks until at least \p count
+     * threads are sleeping, waiting for the test to advance the clock.
+     *
+     * \param[in] count  The number of sleeping threads to wait for.
+     */
+    void wait_for_sleepers(std::size_t count)
+    {
+        detail::virtual_time_state::instance().wait_for_sleepers(count);
+    }
+
+    static bool active()
+    {
+        return detail::virtual_time_state::instance().active();
+    }
+
+    static void sleep_for(std::chrono::nanoseconds duration)
+    {
+        detail::virtual_time_state & state(detail::virtual_time_state::instance());
+        if(state.active())
+        {
+            state.sleep_until(state.monotonic() + duration.count());
+        }
+        else
+        {
+            std::this_thread::sleep_for(duration);
+        }
+    }
+};
+
+
+/** \brief A steady clock which follows the virtual time.
+ *
+ * This clock can be used as a template parameter of the code under test
+ * instead of std::chrono::steady_clock. When no virtual_time object
+ * exists, it returns the steady clock time.
+ */
+struct virtual_clock
+{
+    typedef std::chrono::nanoseconds                duration;
+    typedef duration::rep                           rep;
+    typedef duration::period                        period;
+    typedef std::chrono::time_point<virtual_clock>  time_point;
+
+    static constexpr bool const is_steady = true;
+
+    static time_point now()
+    {
+        detail::virtual_time_state & state(detail::virtual_time_state::instance());
+        if(state.active())
+        {
+            return time_point(duration(state.monotonic()));
+        }
+        return time_point(std::chrono::duration_cast<duration>(
+                    std::chrono::steady_clock::now().time_since_epoch()));
+    }
+};
+
+
+namespace detail
+{
+
+
+/** \brief The exit code used when a test case times out.
+ *
+ * This is the same exit code as the one used by the `timeout` tool.
+ */
+constexpr int const TEST_TIMEOUT_EXIT_CODE = 124;
+
+
+/** \brief The exit code used when no test case ran.
+ *
+ * This is the same exit code as the one used by Catch2.
+ */
+constexpr int const TEST_NO_TESTS_RUN_EXIT_CODE = 2;
+
+
+/** \brief The exit code used when a test case failed.
+ *
+ * This is the same exit code as the one used by Catch2.
+ */
+constexpr int const TEST_FAILURE_EXIT_CODE = 42;
+
+
+/** \brief Retrieve the timeout of a test case.
+ *
+ * This function searches the tags of the specified test case for a
+ * `[timeout=<seconds>]` tag. If present, its value is returned.
+ * Otherwise the g_test_timeout() value is returned.
+ *
+ * \param[in] info  The test case information.
+ *
+ * \return The number of seconds the test is given to run, 0 for no limit.
+ */
+inline int test_case_timeout(Catch::TestCaseInfo const & info)
+{
+    for(auto const & tag : info.tags)
+    {
+        std::string const name(tag.original);
+        if(name.compare(0, 8, "timeout=") == 0)
+        {
+            return std::atoi(name.c_str() + 8);
+        }
+    }
+
+    return g_test_timeout();
+}
+
+
+/** \brief Track the test case and sections being run.
+ *
+ * The snapcatch2 listener updates this object as Catch enters and leaves
+ * test cases and sections. Other threads (such as the watchdog) can
+ * then query where the tests currently are.
+ */
+class run_state
+{
+public:
+    typedef std::chrono::steady_clock       clock_t;
+
+    static run_state & instance()
+    {
+        static run_state state;
+
+        return state;
+    }
+
+    void test_case_starting(Catch::TestCaseInfo const & info)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_test_case = info.name;
+            m_sections.clear();
+            m_start = clock_t::now();
+            m_timeout = test_case_timeout(info);
+            ++m_counter;
+        }
+        m_changed.notify_all();
+    }
+
+    double test_case_ended(bool passed)
+    {
+        double const duration(std::chrono::duration<double>(clock_t::now() - m_start).count());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results.push_back({ m_test_case, passed, duration });
+            m_test_case.clear();
+            m_sections.clear();
+            m_timeout = 0;
+            ++m_counter;
+        }
+        m_changed.notify_all();
+        return duration;
+    }
+
+    void section_starting(std::string const & name)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sections.push_back(name);
+    }
+
+    void section_ended()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(!m_sections.empty())
+        {
+            m_sections.pop_back();
+        }
+    }
+
+    void test_run_ended(Catch::Totals const & totals)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_totals = totals;
+    }
+
+    std::string test_case() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_test_case;
+    }
+
+    Catch::Totals totals() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_totals;
+    }
+
+    struct result_t
+    {
+        std::string     f_name = std::string();
+        bool            f_passed = false;
+        double          f_duration = 0.0;
+    };
+
+    void add_result(result_t const & result)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back(result);
+    }
+
+    /** \brief The results of the test cases that ran so far.
+     *
+     * \return A copy of the list of results.
+     */
+    std::vector<result_t> results() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_results;
+    }
+
+    /** \brief Forget the results of the previous run.
+     */
+    void clear_results()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.clear();
+    }
+
+    /** \brief Get the path to the current section.
+     *
+     * The first section is the test case itself so it is skipped. The
+     * other section names are separated by " / ".
+     *
+     * \return The current section path or an empty string.
+     */
+    std::string section() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string result;
+        for(std::size_t idx(1); idx < m_sections.size(); ++idx)
+        {
+            if(!result.empty())
+            {
+                result += " / ";
+            }
+            result += m_sections[idx];
+        }
+        return result;
+    }
+
+private:
+    friend class watchdog;
+
+    run_state()
+    {
+    }
+
+    mutable std::mutex          m_mutex = std::mutex();
+    std::condition_variable     m_changed = std::condition_variable();
+    std::string                 m_test_case = std::string();
+    std::vector<std::string>    m_sections = std::vector<std::string>();
+    clock_t::time_point         m_start = clock_t::time_point();
+    int                         m_timeout = 0;
+    std::uint64_t               m_counter = 0;
+    Catch::Totals               m_totals = Catch::Totals();
+    std::vector<result_t>       m_results = std::vector<result_t>();
+};
+
+
+/** \brief Capture the output of each test case in memory.
+ *
+ * When the `--capture` command line option is used, the stdout and
+ * stderr file descriptors are redirected to a memory file (memfd) while
+ * a test case runs. This captures everything: `std::cout`, `printf()`,
+ * direct `write()` calls and the output of child processes.
+ *
+ * Once the test case is done, the file descriptors are restored. The
+ * captured output is written to stderr only if the test case failed.
+ * Otherwise it is discarded without ever hitting the terminal. Writing
+ * to stderr keeps it out of a report written to stdout.
+ *
+ * Since the console reporter writes to stdout while the test case runs,
+ * its report of the failed assertions appears in the captured output
+ * along the test's own output, in order. Reporters which write a
+ * document (XML, JUnit...) would get cut by the capture so they must
+ * write to a file (`-o`) and the captured output is not part of their
+ * report.
+ */
+class output_capture
+{
+public:
+    static output_capture & instance()
+    {
+        static output_capture capture;
+
+        return capture;
+    }
+
+    output_capture(output_capture const &) = delete;
+    output_capture & operator = (output_capture const &) = delete;
+
+    ~output_capture()
+    {
+        if(m_fd != -1)
+        {
+            close(m_fd);
+        }
+    }
+
+    void enable()
+    {
+        if(m_fd != -1)
+        {
+            return;
+        }
+        m_fd = memfd_create("snapcatch2-capture", MFD_CLOEXEC);
+        if(m_fd == -1)
+        {
+            throw std::runtime_error(
+                      std::string("could not create the memory file used to capture the output: ")
+                    + strerror(errno));
+        }
+    }
+
+    void test_case_starting()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if(m_fd == -1
+        || m_stdout != -1)
+        {
+            return;
+        }
+
+        flush();
+        if(ftruncate(m_fd, 0) != 0
+        || lseek(m_fd, 0, SEEK_SET) != 0)
+        {
+            return;
+        }
+        m_stdout = dup(STDOUT_FILENO);
+        m_stderr = dup(STDERR_FILENO);
+        if(m_stdout == -1
+        || m_stderr == -1)
+        {
+            restore();
+            return;
+        }
+        dup2(m_fd, STDOUT_FILENO);
+        dup2(m_fd, STDERR_FILENO);
+    }
+
+    /** \brief Stop capturing.
+     *
+     * \param[in] failed  Whether the captured output gets written to stderr.
+     */
+    void test_case_ended(bool failed)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if(m_stdout == -1)
+        {
+            return;
+        }
+
+        flush();
+        restore();
+
+        if(failed)
+        {
+            char buf[64 * 1024];
+            off_t offset(0);
+            for(;;)
+            {
+                ssize_t const r(pread(m_fd, buf, sizeof(buf), offset));
+                if(r <= 0)
+                {
+                    break;
+                }
+                offset += r;
+                for(ssize_t pos(0); pos < r; )
+                {
+                    ssize_t const w(write(STDERR_FILENO, buf + pos, static_cast<std::size_t>(r - pos)));
+                    if(w <= 0)
+                    {
+                        if(w == -1 && errno == EINTR)
+                        {
+                            continue;
+                        }
+                        return;
+                    }
+                    pos += w;
+                }
+            }
+        }
+    }
+
+private:
+    output_capture()
+    {
+    }
+
+    static void flush()
+    {
+        std::cout << std::flush;
+        std::cerr << std::flush;
+        fflush(nullptr);
+    }
+
+    void restore()
+    {
+        if(m_stdout != -1)
+        {
+            dup2(m_stdout, STDOUT_FILENO);
+            close(m_stdout);
+            m_stdout = -1;
+        }
+        if(m_stderr != -1)
+        {
+            dup2(m_stderr, STDERR_FILENO);
+            close(m_stderr);
+            m_stderr = -1;
+        }
+    }
+
+    std::mutex          m_lock = std::mutex();
+    int                 m_fd = -1;
+    int                 m_stdout = -1;
+    int                 m_stderr = -1;
+};
+
+
+/** \brief An in-process sampling profiler.
+ *
+ * The profiler uses the ITIMER_PROF timer so the SIGPROF signal is sent
+ * each time the process used 1/frequency second of CPU. The signal
+ * handler saves the backtrace of the interrupted thread along with the
+ * current test case and section in a preallocated ring buffer.
+ *
+ * A drain thread folds the samples of the ring buffer every
+ * PROFILE_DRAIN_MS milliseconds so a test case can run for any amount
+ * of time. The ring buffer holds one second of samples for each CPU.
+ *
+ * The section context is the one of the thread running the test case.
+ * The samples taken while another thread (i.e. a worker started by the
+ * test) was running are saved under a `[worker threads]` frame below
+ * the test case name instead of being charged to the current section.
+ *
+ * At the end of each test case, the folded stacks are appended to the
+ * output file in one write() so the children of `--isolate` can share
+ * the same file.
+ *
+ * \note
+ * Link your tests with `-rdynamic` so the functions of the test binary
+ * get a name.
+ */
+class profiler
+{
+public:
+    static constexpr std::size_t const  MAX_FRAMES = 48;
+    static constexpr std::size_t const  SKIP_FRAMES = 2;    // signal handler and trampoline
+    static constexpr int const          PROFILE_DRAIN_MS = 100;
+
+    static profiler & instance()
+    {
+        static profiler p;
+
+        return p;
+    }
+
+    profiler(profiler const &) = delete;
+    profiler & operator = (profiler const &) = delete;
+
+    void enable(std::string const & filename, int frequency, std::string const & filter)
+    {
+        m_filename = filename;
+        m_frequency = std::max(frequency, 1);
+        m_filter = filter;
+        m_capacity = std::max<std::size_t>(
+                  static_cast<std::size_t>(m_frequency)
+                      * std::max<std::size_t>(std::thread::hardware_concurrency(), 1)
+                , 1024);
+        m_samples = std::make_unique<sample_t[]>(m_capacity);
+
+        // the first call to backtrace() loads libgcc_s which is not
+        // safe in a signal handler
+        //
+        void * frames[4];
+        backtrace(frames, 4);
+
+        struct sigaction action = {};
+        action.sa_handler = &profiler::sample_handler;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+
+        std::ofstream truncate(m_filename, std::ios::trunc);
+        if(!truncate)
+        {
+            throw std::runtime_error("could not create profile file \"" + m_filename + "\".");
+        }
+        m_enabled = true;
+    }
+
+    void test_case_starting(std::string const & name)
+    {
+        m_running = m_enabled
+                 && (m_filter.empty() || fnmatch(m_filter.c_str(), name.c_str(), 0) == 0);
+        if(!m_running)
+        {
+            return;
+        }
+        m_test_case = name;
+        m_stack.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_contexts.clear();
+            m_context_ids.clear();
+            m_folded.clear();
+            m_count = 0;
+            m_stop = false;
+        }
+        m_next.store(0, std::memory_order_relaxed);
+        m_read.store(0, std::memory_order_relaxed);
+        m_dropped.store(0, std::memory_order_relaxed);
+        m_test_thread.store(gettid(), std::memory_order_relaxed);
+        set_context();
+        m_drain = std::thread(&profiler::drain_thread, this);
+        set_timer(true);
+    }
+
+    void section_starting(std::string const & name)
+    {
+        if(m_running)
+        {
+            m_stack.push_back(name);
+            set_context();
+        }
+    }
+
+    void section_ended()
+    {
+        if(m_running && !m_stack.empty())
+        {
+            m_stack.pop_back();
+            set_context();
+        }
+    }
+
+    void test_case_ended()
+    {
+        if(!m_running)
+        {
+            return;
+        }
+        m_running = false;
+        set_timer(false);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeup.notify_all();
+        m_drain.join();
+
+        std::string out;
+        for(auto const & f : m_folded)
+        {
+            out += f.first + ' ' + std::to_string(f.second) + '\n';
+        }
+        int const fd(open(m_filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644));
+        if(fd == -1
+        || write(fd, out.data(), out.length()) != static_cast<ssize_t>(out.length()))
+        {
+            std::cerr << "warning: could not save the profile of \"" << m_test_case << "\".\n";
+        }
+        if(fd != -1)
+        {
+            close(fd);
+        }
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(3)
+           << "profile: \""
+           << m_test_case
+           << "\" -- "
+           << m_count
+           << " samples ("
+           << static_cast<double>(m_count) / static_cast<double>(m_frequency)
+           << "s of CPU)";
+        std::size_t const dropped(m_dropped.load(std::memory_order_relaxed));
+        if(dropped != 0)
+        {
+            ss << ", " << dropped << " samples dropped";
+        }
+
+        // the test case is over so there is no assertion to attach this
+        // summary to; stderr keeps it out of the reporter output
+        //
+        std::cerr << ss.str() << std::endl;
+    }
+
+private:
+    struct sample_t
+    {
+        std::atomic<bool>       f_ready = false;
+        bool                    f_test_thread = false;
+        std::uint32_t           f_context = 0;
+        std::size_t             f_depth = 0;
+        void *                  f_frames[MAX_FRAMES] = {};
+    };
+
+    profiler()
+    {
+    }
+
+    static pid_t gettid()
+    {
+        return static_cast<pid_t>(syscall(SYS_gettid));
+    }
+
+    static void sample_handler(int sig)
+    {
+        static_cast<void>(sig);
+
+        int const saved_errno(errno);
+        profiler & p(instance());
+
+        // reserve a slot unless the drain thread is too far behind
+        //
+        std::size_t idx(p.m_next.load(std::memory_order_relaxed));
+        do
+        {
+            if(idx - p.m_read.load(std::memory_order_acquire) >= p.m_capacity)
+            {
+                p.m_dropped.fetch_add(1, std::memory_order_relaxed);
+                errno = saved_errno;
+                return;
+            }
+        }
+        while(!p.m_next.compare_exchange_weak(idx, idx + 1, std::memory_order_relaxed));
+
+        sample_t & s(p.m_samples[idx % p.m_capacity]);
+        s.f_test_thread = gettid() == p.m_test_thread.load(std::memory_order_relaxed);
+        s.f_context = p.m_context.load(std::memory_order_relaxed);
+        int const depth(backtrace(s.f_frames, static_cast<int>(MAX_FRAMES)));
+        s.f_depth = depth < 0 ? 0 : static_cast<std::size_t>(depth);
+        s.f_ready.store(true, std::memory_order_release);
+        errno = saved_errno;
+    }
+
+    /** \brief Fold the samples found in the ring buffer.
+     *
+     * The samples are folded in order and the function stops on the
+     * first one which a signal handler is still writing.
+     *
+     * The function is called with m_mutex locked.
+     */
+    void fold()
+    {
+        std::size_t const next(m_next.load(std::memory_order_acquire));
+        std::size_t read(m_read.load(std::memory_order_relaxed));
+        for(; read < next; ++read)
+        {
+            sample_t & s(m_samples[read % m_capacity]);
+            if(!s.f_ready.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            std::string key(s.f_test_thread
+                    ? m_contexts[s.f_context]
+                    : m_contexts[0] + ";[worker threads]");
+            for(std::size_t f(s.f_depth); f > SKIP_FRAMES; --f)
+            {
+                key += ';';
+                key += symbol(s.f_frames[f - 1]);
+            }
+            ++m_folded[key];
+            ++m_count;
+            s.f_ready.store(false, std::memory_order_relaxed);
+            m_read.store(read + 1, std::memory_order_release);
+        }
+    }
+
+    void drain_thread()
+    {
+        // the samples are about the test, not this thread
+        //
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGPROF);
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for(;;)
+        {
+            m_wakeup.wait_for(lock, std::chrono::milliseconds(PROFILE_DRAIN_MS), [this]() { return m_stop; });
+            fold();
+            if(m_stop)
+            {
+                return;
+            }
+        }
+    }
+
+    void set_timer(bool on)
+    {
+        itimerval timer = {};
+        if(on)
+        {
+            timer.it_interval.tv_sec = 0;
+            timer.it_interval.tv_usec = std::max(1'000'000 / m_frequency, 1);
+            timer.it_value = timer.it_interval;
+        }
+        setitimer(ITIMER_PROF, &timer, nullptr);
+    }
+
+    void set_context()
+    {
+        // the first section is the test case itself
+        //
+        std::string context(m_test_case);
+        for(std::size_t idx(1); idx < m_stack.size(); ++idx)
+        {
+            context += ';';
+            context += m_stack[idx];
+        }
+        std::replace(context.begin(), context.end(), '\n', ' ');
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto const it(m_context_ids.find(context));
+        if(it != m_context_ids.end())
+        {
+            m_context.store(it->second, std::memory_order_relaxed);
+            return;
+        }
+        std::uint32_t const id(static_cast<std::uint32_t>(m_contexts.size()));
+        m_contexts.push_back(context);
+        m_context_ids[context] = id;
+        m_context.store(id, std::memory_order_relaxed);
+    }
+
+    std::string const & symbol(void * address)
+    {
+        auto const it(m_symbols.find(address));
+        if(it != m_symbols.end())
+        {
+            return it->second;
+        }
+
+        // the return address points after the call
+        //
+        void const * const call(reinterpret_cast<char const *>(address) - 1);
+
+        std::string name;
+        Dl_info info = {};
+        if(dladdr(call, &info) != 0
+        && info.dli_sname != nullptr)
+        {
+            int status(0);
+            char * demangled(abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status));
+            name = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+            free(demangled);
+        }
+        else
+        {
+            std::stringstream ss;
+            if(info.dli_fname != nullptr)
+            {
+                char const * slash(strrchr(info.dli_fname, '/'));
+                ss << (slash == nullptr ? info.dli_fname : slash + 1)
+                   << "+0x"
+                   << std::hex
+                   << reinterpret_cast<std::uintptr_t>(call) - reinterpret_cast<std::uintptr_t>(info.dli_fbase);
+            }
+            else
+            {
+                ss << call;
+            }
+            name = ss.str();
+        }
+        std::replace(name.begin(), name.end(), ';', ':');
+        return m_symbols[address] = name;
+    }
+
+    bool                                    m_enabled = false;
+    bool                                    m_running = false;
+    std::string                             m_filename = std::string();
+    int                                     m_frequency = 997;
+    std::string                             m_filter = std::string();
+    std::string                             m_test_case = std::string();
+    std::vector<std::string>                m_stack = std::vector<std::string>();
+    std::mutex                              m_mutex = std::mutex();
+    std::condition_variable                 m_wakeup = std::condition_variable();
+    std::thread                             m_drain = std::thread();
+    bool                                    m_stop = false;
+    std::vector<std::string>                m_contexts = std::vector<std::string>();
+    std::map<std::string, std::uint32_t>    m_context_ids = std::map<std::string, std::uint32_t>();
+    std::map<void *, std::string>           m_symbols = std::map<void *, std::string>();
+    std::map<std::string, std::uint64_t>    m_folded = std::map<std::string, std::uint64_t>();
+    std::uint64_t                           m_count = 0;
+    std::size_t                             m_capacity = 0;
+    std::unique_ptr<sample_t[]>             m_samples = std::unique_ptr<sample_t[]>();
+    std::atomic<std::size_t>                m_next = 0;
+    std::atomic<std::size_t>                m_read = 0;
+    std::atomic<std::size_t>                m_dropped = 0;
+    std::atomic<std::uint32_t>              m_context = 0;
+    std::atomic<pid_t>                      m_test_thread = 0;
+};
+
+
+/** \brief Get the list of CPUs this process can run on.
+ *
+ * \return The CPU numbers found in the affinity mask of the process.
+ */
+inline std::vector<int> available_cpus()
+{
+    std::vector<int> result;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for(int cpu(0); cpu < CPU_SETSIZE; ++cpu)
+        {
+            if(CPU_ISSET(cpu, &set))
+            {
+                result.push_back(cpu);
+            }
+        }
+    }
+    return result;
+}
+
+
+/** \brief Control and check the environment the benchmarks run in.
+ *
+ * The setup() function applies the `--benchmark-...` command line
+ * options: it pins the process to a set of CPUs, locks its memory and
+ * warms up the CPU until its speed is stable. Then it prints the state
+ * of the machine (CPUs, frequency governors, load average) so it appears
+ * at the top of the report.
+ *
+ * The listener calls benchmark_starting() and benchmark_ended() for each
+ * Catch2 benchmark. A benchmark which standard deviation is above the
+ * `--benchmark-noise` percentage of its mean is flagged as unreliable,
+ * along the number of CPU migrations and involuntary context switches
+ * which happened while it ran. The warnings are reported with a
+ * CATCH_WARN() at the end of the enclosing section (or test case) so
+ * they do not break the table of results.
+ */
+class benchmark_environment
+{
+public:
+    static benchmark_environment & instance()
+    {
+        static benchmark_environment env;
+
+        return env;
+    }
+
+    void setup()
+    {
+        bool const show(!g_benchmark_cpus().empty()
+                    || g_benchmark_lock_memory()
+                    || g_benchmark_stabilize() > 0.0);
+        if(!g_benchmark_cpus().empty())
+        {
+            // sched_setaffinity() applies to one thread, the new threads
+            // inherit the mask of their creator
+            //
+            cpu_set_t set(parse_cpus(g_benchmark_cpus()));
+            if(sched_setaffinity(0, sizeof(set), &set) != 0)
+            {
+                throw std::runtime_error(
+                          "could not pin the process to CPUs \""
+                        + g_benchmark_cpus()
+                        + "\": "
+                        + strerror(errno));
+            }
+            DIR * dir(opendir("/proc/self/task"));
+            if(dir != nullptr)
+            {
+                for(struct dirent * ent(readdir(dir)); ent != nullptr; ent = readdir(dir))
+                {
+                    pid_t const tid(static_cast<pid_t>(std::atoi(ent->d_name)));
+                    if(tid > 0)
+                    {
+                        sched_setaffinity(tid, sizeof(set), &set);
+                    }
+                }
+                closedir(dir);
+            }
+        }
+
+        std::string memory("no");
+        if(g_benchmark_lock_memory())
+        {
+            if(mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+            {
+                memory = "yes";
+            }
+            else
+            {
+                memory = std::string("failed (") + strerror(errno) + ")";
+            }
+        }
+
+        std::string warm_up("off");
+        if(g_benchmark_stabilize() > 0.0)
+        {
+            warm_up = stabilize(g_benchmark_stabilize());
+        }
+
+        if(!show)
+        {
+            return;
+        }
+
+        std::vector<int> const cpus(available_cpus());
+        std::string cpu_list;
+        std::map<std::string, int> governors;
+        for(auto const cpu : cpus)
+        {
+            if(!cpu_list.empty())
+            {
+                cpu_list += ',';
+            }
+            cpu_list += std::to_string(cpu);
+
+            std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/scaling_governor");
+            std::string governor;
+            if(!std::getline(in, governor))
+            {
+                governor = "unknown";
+            }
+            ++governors[governor];
+        }
+        std::string governor_list;
+        for(auto const & g : governors)
+        {
+            if(!governor_list.empty())
+            {
+                governor_list += ", ";
+            }
+            governor_list += g.first + " (" + std::to_string(g.second) + ")";
+        }
+
+        double load[3] = { 0.0, 0.0, 0.0 };
+        if(getloadavg(load, 3) != 3)
+        {
+            load[0] = load[1] = load[2] = -1.0;
+        }
+
+        std::cout << "benchmark environment:\n"
+                  << "  cpus: " << cpu_list << '\n'
+                  << "  governors: " << governor_list << '\n'
+                  << "  load average: " << std::fixed << std::setprecision(2)
+                        << load[0] << ' ' << load[1] << ' ' << load[2]
+                        << std::defaultfloat << std::setprecision(6) << '\n'
+                  << "  memory locked: " << memory << '\n'
+                  << "  warm-up: " << warm_up << '\n'
+                  << std::flush;
+    }
+
+    void benchmark_starting()
+    {
+        m_migrations = migrations();
+        m_switches = involuntary_switches();
+    }
+
+    void benchmark_ended(Catch::BenchmarkStats<> const & stats)
+    {
+        ++m_benchmarks;
+
+        double const mean(stats.mean.point.count());
+        double const noise(mean > 0.0 ? stats.standardDeviation.point.count() / mean * 100.0 : 0.0);
+        if(g_benchmark_noise() <= 0.0
+        || noise <= g_benchmark_noise())
+        {
+            return;
+        }
+
+        ++m_unreliable;
+        std::stringstream ss;
+        ss << "benchmark \""
+           << stats.info.name
+           << "\" is unreliable: noise "
+           << std::fixed << std::setprecision(1) << noise
+           << std::defaultfloat << std::setprecision(6)
+           << "% > "
+           << g_benchmark_noise()
+           << "% ("
+           << stats.outliers.total()
+           << " outliers, ";
+        std::int64_t const m(migrations());
+        if(m >= 0 && m_migrations >= 0)
+        {
+            ss << m - m_migrations;
+        }
+        else
+        {
+            ss << "unknown";
+        }
+        ss << " CPU migrations, "
+           << involuntary_switches() - m_switches
+           << " involuntary context switches).";
+        m_warnings.push_back(ss.str());
+    }
+
+    /** \brief Report the warnings of the benchmarks which just ended.
+     *
+     * The listener calls this function at the end of each section,
+     * including the one of the test case itself, which is still within
+     * the test case so the reporters get the warnings as warning messages
+     * of the test case. Catch2 benchmarks have no location of their own
+     * so the warnings use the location of the section which includes the
+     * benchmarks.
+     *
+     * \param[in] line_info  The location of the section which ended.
+     */
+    void section_ended(Catch::SourceLineInfo const & line_info)
+    {
+        std::vector<std::string> warnings;
+        warnings.swap(m_warnings);
+        for(auto & w : warnings)
+        {
+            Catch::AssertionHandler handler(
+                      "WARN"_catch_sr
+                    , line_info
+                    , Catch::StringRef()
+                    , Catch::ResultDisposition::ContinueOnFailure);
+            handler.handleMessage(Catch::ResultWas::Warning, std::move(w));
+            handler.complete();
+        }
+    }
+
+    void test_run_ended()
+    {
+        if(m_unreliable > 0)
+        {
+            std::cerr << "warning: "
+                      << m_unreliable
+                      << " of "
+                      << m_benchmarks
+                      << " benchmarks are unreliable (noise above "
+                      << g_benchmark_noise()
+                      << "%).\n"
+                      << std::flush;
+        }
+    }
+
+private:
+    benchmark_environment()
+    {
+    }
+
+    static cpu_set_t parse_cpus(std::string const & list)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        std::istringstream in(list);
+        std::string range;
+        while(std::getline(in, range, ','))
+        {
+            char * end(nullptr);
+            long const first(strtol(range.c_str(), &end, 10));
+            long last(first);
+            if(*end == '-')
+            {
+                last = strtol(end + 1, &end, 10);
+            }
+            if(range.empty()
+            || *end != '\0'
+            || first < 0
+            || last < first
+            || last >= CPU_SETSIZE)
+            {
+                throw std::runtime_error("invalid CPU list \"" + list + "\".");
+            }
+            for(long cpu(first); cpu <= last; ++cpu)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        return set;
+    }
+
+    /** \brief Run a busy loop until the CPU speed is stable.
+     *
+     * The same amount of work is timed repeatedly. Once the last 5 timings
+     * are within 1% of each other, the CPU is considered stable.
+     *
+     * \param[in] max_seconds  The maximum amount of time to spend.
+     *
+     * \return A description of the result.
+     */
+    static std::string stabilize(double max_seconds)
+    {
+        typedef std::chrono::steady_clock clock_t;
+
+        auto const start(clock_t::now());
+        std::vector<double> timings;
+        std::uint64_t volatile sink(0);
+        for(;;)
+        {
+            auto const chunk_start(clock_t::now());
+            std::uint64_t x(0x9E3779B97F4A7C15ULL);
+            for(int i(0); i < 1'000'000; ++i)
+            {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+            }
+            sink = sink + x;
+            auto const now(clock_t::now());
+            timings.push_back(std::chrono::duration<double>(now - chunk_start).count());
+
+            double const elapsed(std::chrono::duration<double>(now - start).count());
+            std::stringstream ss;
+            ss << std::fixed << std::setprecision(2) << elapsed << 's';
+            if(timings.size() >= 5)
+            {
+                auto const last(timings.end() - 5);
+                auto const [min, max] = std::minmax_element(last, timings.end());
+                if((*max - *min) / *min < 0.01)
+                {
+                    return "stable after " + ss.str();
+                }
+            }
+            if(elapsed >= max_seconds)
+            {
+                return "NOT stable after " + ss.str();
+            }
+        }
+    }
+
+    /** \brief Number of times the current thread moved to another CPU.
+     *
+     * \return The number of migrations or -1 if not available.
+     */
+    static std::int64_t migrations()
+    {
+        std::ifstream in("/proc/thread-self/sched");
+        std::string line;
+        while(std::getline(in, line))
+        {
+            if(line.compare(0, 16, "se.nr_migrations") == 0)
+            {
+                std::string::size_type const pos(line.find(':'));
+                if(pos != std::string::npos)
+                {
+                    return std::stoll(line.substr(pos + 1));
+                }
+            }
+        }
+        return -1;
+    }
+
+    static std::int64_t involuntary_switches()
+    {
+        rusage usage = {};
+        getrusage(RUSAGE_THREAD, &usage);
+        return usage.ru_nivcsw;
+    }
+
+    std::int64_t                m_migrations = 0;
+    std::int64_t                m_switches = 0;
+    std::size_t                 m_benchmarks = 0;
+    std::size_t                 m_unreliable = 0;
+    std::vector<std::string>    m_warnings = std::vector<std::string>();
+};
+
+
+/** \brief A simple 64 bit FNV-1a hash.
+ *
+ * This is used to compute keys of cached data. It is not a cryptographic
+ * hash, it just needs to change whenever the input changes.
+ */
+class fnv1a
+{
+public:
+    void update(void const * data, std::size_t size)
+    {
+        std::uint8_t const * s(reinterpret_cast<std::uint8_t const *>(data));
+        for(std::size_t idx(0); idx < size; ++idx)
+        {
+            m_hash ^= s[idx];
+            m_hash *= 0x100000001B3ULL;
+        }
+    }
+
+    void update(std::string_view data)
+    {
+        // include the size so "ab" + "c" differs from "a" + "bc"
+        //
+        std::uint64_t const size(data.length());
+        update(&size, sizeof(size));
+        update(data.data(), data.length());
+    }
+
+    std::uint64_t hash() const
+    {
+        return m_hash;
+    }
+
+    std::string hex() const
+    {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0') << std::setw(16) << m_hash;
+        return ss.str();
+    }
+
+private:
+    std::uint64_t       m_hash = 0xCBF29CE484222325ULL;
+};
+
+
+/** \brief Derive a sub-seed.
+ *
+ * This is the splitmix64 finalizer. It gives well distributed seeds
+ * even when the inputs only differ by one bit.
+ *
+ * \param[in] seed  The main seed.
+ * \param[in] index  The index of the sub-seed.
+ *
+ * \return The sub-seed.
+ */
+inline std::uint64_t sub_seed(std::uint64_t seed, std::uint64_t index)
+{
+    std::uint64_t z(seed + (index + 1) * 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+/** \brief The journal of the test cases which completed.
+ *
+ * The journal is a text file. The first line has the seed of the run
+ * and the Catch2 random number generator seed:
+ *
+ * \code
+ *     seed <seed> <rng-seed>
+ * \endcode
+ *
+ * Then each completed test case appends one line with a single write()
+ * in append mode: whether it passed, its duration in seconds, the number
+ * of assertions which passed and failed, and its name:
+ *
+ * \code
+ *     test <passed> <seconds> <assertions passed> <assertions failed> <name>
+ * \endcode
+ *
+ * The data is flushed to disk at most once per second so the journal
+ * survives the loss of the machine without slowing down suites of many
+ * short test cases too much. When a test case appears more than once,
+ * the last line wins.
+ */
+class checkpoint_journal
+{
+public:
+    struct entry_t
+    {
+        bool            f_passed = false;
+        double          f_duration = 0.0;
+        std::uint64_t   f_assertions_passed = 0;
+        std::uint64_t   f_assertions_failed = 0;
+    };
+
+    typedef std::map<std::string, entry_t>      entries_t;
+
+    static checkpoint_journal & instance()
+    {
+        static checkpoint_journal journal;
+
+        return journal;
+    }
+
+    checkpoint_journal(checkpoint_journal const &) = delete;
+    checkpoint_journal & operator = (checkpoint_journal const &) = delete;
+
+    ~checkpoint_journal()
+    {
+        close();
+    }
+
+    /** \brief Read an existing journal.
+     *
+     * \exception std::runtime_error
+     * The journal cannot be read or it does not start with the seeds.
+     *
+     * \param[in] filename  The name of the journal.
+     * \param[out] seed  The seed of the run.
+     * \param[out] rng_seed  The Catch2 random number generator seed.
+     *
+     * \return The test cases found in the journal.
+     */
+    static entries_t load(std::string const & filename, unsigned int & seed, std::uint32_t & rng_seed)
+    {
+        std::ifstream in(filename);
+        std::string line;
+        if(!in.is_open()
+        || !std::getline(in, line))
+        {
+            throw std::runtime_error("could not read the checkpoint journal \"" + filename + "\".");
+        }
+        {
+            std::istringstream header(line);
+            std::string tag;
+            if(!(header >> tag >> seed >> rng_seed)
+            || tag != "seed")
+            {
+                throw std::runtime_error("\"" + filename + "\" is not a checkpoint journal.");
+            }
+        }
+
+        entries_t result;
+        while(std::getline(in, line))
+        {
+            std::istringstream ss(line);
+            std::string tag;
+            entry_t e;
+            if(!(ss >> tag >> e.f_passed >> e.f_duration >> e.f_assertions_passed >> e.f_assertions_failed)
+            || tag != "test"
+            || ss.get() != ' ')
+            {
+                // the last line may be incomplete if the process died
+                // while writing it
+                //
+                continue;
+            }
+            std::string name;
+            std::getline(ss, name);
+            if(!name.empty())
+            {
+                result[name] = e;
+            }
+        }
+        return result;
+    }
+
+    /** \brief Start appending to a journal.
+     *
+     * If \p append is false, the journal is truncated and the seeds are
+     * saved on its first line.
+     *
+     * \exception std::runtime_error
+     * The journal cannot be opened.
+     *
+     * \param[in] filename  The name of the journal.
+     * \param[in] append  Whether the journal of the run to resume is used.
+     * \param[in] seed  The seed of the run.
+     * \param[in] rng_seed  The Catch2 random number generator seed.
+     */
+    void open(std::string const & filename, bool append, unsigned int seed, std::uint32_t rng_seed)
+    {
+        close();
+        m_fd = ::open(
+                  filename.c_str()
+                , O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC)
+                , 0644);
+        if(m_fd == -1)
+        {
+            throw std::runtime_error(
+                      "could not open the checkpoint journal \""
+                    + filename
+                    + "\": "
+                    + strerror(errno));
+        }
+        if(!append)
+        {
+            write_line("seed " + std::to_string(seed) + ' ' + std::to_string(rng_seed) + '\n');
+            fdatasync(m_fd);
+        }
+        m_last_sync = std::chrono::steady_clock::now();
+    }
+
+    /** \brief Stop writing to the journal.
+     *
+     * The children created by `--isolate` call this function since the
+     * parent process records their results.
+     */
+    void close()
+    {
+        if(m_fd != -1)
+        {
+            fdatasync(m_fd);
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    void record(std::string const & name, bool passed, double duration, Catch::Counts const & assertions)
+    {
+        if(m_fd == -1)
+        {
+            return;
+        }
+
+        std::stringstream ss;
+        ss << "test "
+           << (passed ? 1 : 0)
+           << ' '
+           << std::fixed << std::setprecision(6) << duration
+           << ' '
+           << assertions.passed
+           << ' '
+           << assertions.failed
+           << ' '
+           << name
+           << '\n';
+        write_line(ss.str());
+
+        auto const now(std::chrono::steady_clock::now());
+        if(now - m_last_sync >= std::chrono::seconds(1))
+        {
+            fdatasync(m_fd);
+            m_last_sync = now;
+        }
+    }
+
+private:
+    checkpoint_journal()
+    {
+    }
+
+    void write_line(std::string const & line)
+    {
+        if(write(m_fd, line.data(), line.length()) != static_cast<ssize_t>(line.length()))
+        {
+            std::cerr << "warning: could not write to the checkpoint journal: "
+                      << strerror(errno)
+                      << ".\n";
+        }
+    }
+
+    int                                     m_fd = -1;
+    std::chrono::steady_clock::time_point   m_last_sync = std::chrono::steady_clock::time_point();
+};
+
+
+/** \brief Reseed rand() for a test case of a checkpointed run.
+ *
+ * A resumed run skips the test cases found in the journal so the rand()
+ * sequence would otherwise not be where it was in the interrupted run.
+ * With `--checkpoint` or `--resume`, each test case instead starts from
+ * `sub_seed(g_seed(), hash(name))` so the random_string(),
+ * random_buffer(), etc. helpers return the same data whether or not the
+ * run was resumed. The seed saved in the journal is all that is needed
+ * to do so.
+ *
+ * \param[in] name  The name of the test case about to run.
+ */
+inline void reseed_test_case(std::string const & name)
+{
+    if(g_checkpoint().empty())
+    {
+        return;
+    }
+
+    fnv1a h;
+    h.update(name);
+    unsigned int const seed(static_cast<unsigned int>(sub_seed(g_seed(), h.hash())));
+    srand(seed);
+    srand48(seed);
+}
+
+
+/** \brief The listener used by snapcatch2.
+ *
+ * This listener gets registered by snap_catch2_main() and keeps the
+ * run_state up to date.
+ */
+class snapcatch2_listener
+    : public Catch::EventListenerBase
+{
+public:
+    using Catch::EventListenerBase::EventListenerBase;
+
+    static std::string getDescription()
+    {
+        return "snapcatch2 test case tracker";
+    }
+
+    void testCaseStarting(Catch::TestCaseInfo const & info) override
+    {
+        reseed_test_case(info.name);
+        output_capture::instance().test_case_starting();
+        run_state::instance().test_case_starting(info);
+        profiler::instance().test_case_starting(info.name);
+    }
+
+    void testCaseEnded(Catch::TestCaseStats const & stats) override
+    {
+        output_capture::instance().test_case_ended(stats.totals.testCases.failed != 0);
+        profiler::instance().test_case_ended();
+        section_arena::instance().clear();
+        bool const passed(stats.totals.testCases.failed == 0);
+        double const duration(run_state::instance().test_case_ended(passed));
+        checkpoint_journal::instance().record(stats.testInfo->name, passed, duration, stats.totals.assertions);
+    }
+
+    void sectionStarting(Catch::SectionInfo const & info) override
+    {
+        run_state::instance().section_starting(info.name);
+        profiler::instance().section_starting(info.name);
+        section_arena::instance().push();
+    }
+
+    void sectionEnded(Catch::SectionStats const & stats) override
+    {
+        benchmark_environment::instance().section_ended(stats.sectionInfo.lineInfo);
+        section_arena::instance().pop();
+        profiler::instance().section_ended();
+        run_state::instance().section_ended();
+    }
+
+    void benchmarkStarting(Catch::BenchmarkInfo const & info) override
+    {
+        static_cast<void>(info);
+        benchmark_environment::instance().benchmark_starting();
+    }
+
+    void benchmarkEnded(Catch::BenchmarkStats<> const & stats) override
+    {
+        benchmark_environment::instance().benchmark_ended(stats);
+    }
+
+    void testRunEnded(Catch::TestRunStats const & stats) override
+    {
+        benchmark_environment::instance().test_run_ended();
+        run_state::instance().test_run_ended(stats.totals);
+    }
+};
+
+
+/** \brief Signal used to ask each thread to dump its stack.
+ *
+ * \return The signal number.
+ */
+inline int stack_dump_signal()
+{
+    return SIGRTMIN + 2;
+}
+
+
+inline std::atomic<bool> & stack_dumped()
+{
+    static std::atomic<bool> dumped(false);
+
+    return dumped;
+}
+
+
+/** \brief Write the stack of the current thread to stderr.
+ *
+ * This function is the signal handler used by the watchdog to dump the
+ * stack of each thread. It only uses functions that write directly to
+ * the file descriptor.
+ *
+ * \param[in] sig  The signal that triggered this call.
+ */
+inline void dump_stack_handler(int sig)
+{
+    static_cast<void>(sig);
+
+    void * frames[64];
+    int const count(backtrace(frames, 64));
+    backtrace_symbols_fd(frames, count, STDERR_FILENO);
+    stack_dumped() = true;
+}
+
+
+/** \brief Thread verifying that test cases do not hang.
+ *
+ * The watchdog wakes up each time a test case starts or ends and
+ * whenever the current test case reaches its time limit. At that
+ * point, it prints out the name of the test case and current
+ * section, dumps the stack of each thread, tells the reporters that
+ * the test case failed and the run ended and exits the process with
+ * the TEST_TIMEOUT_EXIT_CODE.
+ *
+ * A hung thread cannot safely be interrupted so the process has to
+ * end. Use the `--isolate` command line option to run each test case in
+ * its own process so the other test cases still run.
+ */
+class watchdog
+{
+public:
+    watchdog()
+    {
+        // make sure the backtrace() function is loaded before we need it
+        // in a signal handler
+        //
+        void * frames[1];
+        backtrace(frames, 1);
+
+        m_thread = std::thread(&watchdog::run, this);
+    }
+
+    watchdog(watchdog const &) = delete;
+    watchdog & operator = (watchdog const &) = delete;
+
+    ~watchdog()
+    {
+        run_state & state(run_state::instance());
+        {
+            std::lock_guard<std::mutex> lock(state.m_mutex);
+            m_stop = true;
+        }
+        state.m_changed.notify_all();
+        m_thread.join();
+    }
+
+private:
+    void run()
+    {
+        // the watchdog measures the real time
+        //
+        virtual_time_state::bypass() = true;
+
+        run_state & state(run_state::instance());
+        std::unique_lock<std::mutex> lock(state.m_mutex);
+        while(!m_stop)
+        {
+            if(state.m_test_case.empty()
+            || state.m_timeout <= 0)
+            {
+                state.m_changed.wait(lock);
+                continue;
+            }
+
+            std::uint64_t const counter(state.m_counter);
+            run_state::clock_t::time_point const deadline(
+                          state.m_start
+                        + std::chrono::seconds(state.m_timeout));
+            state.m_changed.wait_until(
+                      lock
+                    , deadline
+                    , [this, &state, counter]()
+                      {
+                          return m_stop || state.m_counter != counter;
+                      });
+            if(!m_stop
+            && state.m_counter == counter
+            && run_state::clock_t::now() >= deadline)
+            {
+                int const timeout(state.m_timeout);
+                lock.unlock();
+                timed_out(timeout);
+            }
+        }
+    }
+
+    void timed_out(int timeout)
+    {
+        run_state & state(run_state::instance());
+        std::string const section(state.section());
+
+        // show what the test printed before it got stuck
+        //
+        output_capture::instance().test_case_ended(true);
+
+        std::cout << std::flush;
+        std::cerr << "\nerror: test case \""
+                  << state.test_case()
+                  << "\" timed out after "
+                  << timeout
+                  << " seconds";
+        if(!section.empty())
+        {
+            std::cerr << " in section \""
+                      << section
+                      << "\"";
+        }
+        std::cerr << ".\n" << std::flush;
+
+        dump_all_stacks();
+
+        std::cerr << "error: test case \""
+                  << state.test_case()
+                  << "\" FAILED (timeout).\n"
+                  << std::flush;
+
+        // end the test case and the run the same way Catch2 does on a
+        // fatal signal so the reports (-o, JUnit...) get written; this is
+        // done from this thread while the test thread is stuck which is
+        // a best effort just like Catch2's own signal handling
+        //
+        Catch::IResultCapture * capture(Catch::getCurrentContext().getResultCapture());
+        if(capture != nullptr)
+        {
+            capture->handleFatalErrorCondition(
+                    "timed out after " + std::to_string(timeout) + " seconds");
+            std::cout << std::flush;
+            std::cerr << std::flush;
+        }
+
+        // the test thread is hung, there is no clean way out
+        //
+        _exit(TEST_TIMEOUT_EXIT_CODE);
+    }
+
+    /** \brief Install the handler used to dump the stack of a thread.
+     *
+     * This is only done once a test case timed out. If the signal already
+     * has a handler (i.e. the code under test uses that real-time signal)
+     * it is left alone and the stacks do not get dumped.
+     *
+     * \return true if the handler is installed.
+     */
+    static bool install_stack_dump_handler()
+    {
+        struct sigaction current = {};
+        if(sigaction(stack_dump_signal(), nullptr, &current) != 0)
+        {
+            return false;
+        }
+        if((current.sa_flags & SA_SIGINFO) != 0
+        || (current.sa_handler != SIG_DFL
+            && current.sa_handler != SIG_IGN
+            && current.sa_handler != &dump_stack_handler))
+        {
+            std::cerr << "warning: signal SIGRTMIN+2 already has a handler, stacks are not dumped.\n";
+            return false;
+        }
+
+        struct sigaction action = {};
+        action.sa_handler = &dump_stack_handler;
+        action.sa_flags = SA_RESTART;
+        return sigaction(stack_dump_signal(), &action, nullptr) == 0;
+    }
+
+    void dump_all_stacks()
+    {
+        if(!install_stack_dump_handler())
+        {
+            return;
+        }
+
+        pid_t const pid(getpid());
+        pid_t const self(static_cast<pid_t>(syscall(SYS_gettid)));
+
+        DIR * dir(opendir("/proc/self/task"));
+        if(dir == nullptr)
+        {
+            return;
+        }
+        for(struct dirent * ent(readdir(dir)); ent != nullptr; ent = readdir(dir))
+        {
+            pid_t const tid(static_cast<pid_t>(std::atoi(ent->d_name)));
+            if(tid <= 0 || tid == self)
+            {
+                continue;
+            }
+            std::cerr << "--- stack of thread " << tid << ":\n" << std::flush;
+
+            // one thread at a time so the stacks do not get mixed up
+            //
+            stack_dumped() = false;
+            if(syscall(SYS_tgkill, pid, tid, stack_dump_signal()) != 0)
+            {
+                continue;
+            }
+            for(int wait(0); wait < 100 && !stack_dumped(); ++wait)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        closedir(dir);
+    }
+
+    std::thread                 m_thread = std::thread();
+    bool                        m_stop = false;
+};
+
+
+/** \brief Check whether the watchdog is necessary.
+ *
+ * The watchdog is necessary if the `--test-timeout` command line option
+ * was used or if at least one test case has a `[timeout=<seconds>]` tag.
+ *
+ * \return true if the watchdog thread has to be started.
+ */
+inline bool need_watchdog()
+{
+    if(g_test_timeout() > 0)
+    {
+        return true;
+    }
+
+    for(auto const * info : Catch::getRegistryHub().getTestCaseRegistry().getAllInfos())
+    {
+        if(test_case_timeout(*info) > 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/** \brief Transform a test case name in a Catch2 test specification.
+ *
+ * Catch2 parses the names found on its command line. Characters such as
+ * the comma and square brackets have a special meaning. This function
+ * escapes those so the resulting specification only matches the named
+ * test case.
+ *
+ * \param[in] name  The name of the test case.
+ *
+ * \return The name with special characters escaped.
+ */
+inline std::string test_name_to_spec(std::string const & name)
+{
+    std::string result;
+    result.reserve(name.length() + 8);
+    for(auto const c : name)
+    {
+        switch(c)
+        {
+        case '\\':
+        case ',':
+        case '[':
+        case ']':
+        case '"':
+        case '~':
+            result += '\\';
+            break;
+
+        }
+        result += c;
+    }
+    return result;
+}
+
+
+/** \brief Restrict a session to the specified test cases.
+ *
+ * This function replaces the test specification of the \p session with
+ * the list of test case names found in \p names. The names are viewed
+ * as a list of "OR"s.
+ *
+ * \warning
+ * If \p names is empty, Catch2 runs all the test cases. The caller is
+ * expected to handle that special case.
+ *
+ * \param[in,out] session  The session to update.
+ * \param[in] names  The names of the test cases to run.
+ */
+inline void select_test_cases(Catch::Session & session, std::vector<std::string> const & names)
+{
+    Catch::ConfigData data(session.configData());
+    data.testsOrTags.clear();
+    for(auto const & n : names)
+    {
+        if(!data.testsOrTags.empty())
+        {
+            data.testsOrTags.emplace_back(",");
+        }
+        data.testsOrTags.push_back(test_name_to_spec(n));
+    }
+    session.useConfigData(data);
+}
+
+
+/** \brief Get the list of test cases selected by the command line.
+ *
+ * This function applies the test specification found on the command
+ * line to the list of all the test cases and returns the ones that
+ * would run.
+ *
+ * \param[in] session  The session with the command line applied.
+ *
+ * \return The list of selected test cases, in the order they would run.
+ */
+inline std::vector<Catch::TestCaseHandle> selected_test_cases(Catch::Session & session)
+{
+    Catch::Config const & config(session.config());
+    return Catch::filterTests(
+                  Catch::getAllTestCasesSorted(config)
+                , config.testSpec()
+                , config);
+}
+
+
+/** \brief Get a printable name for a signal.
+ *
+ * \param[in] sig  The signal number.
+ *
+ * \return A string such as "SIGSEGV (Segmentation fault)".
+ */
+inline std::string signal_name(int sig)
+{
+    char const * name(nullptr);
+    switch(sig)
+    {
+    case SIGABRT: name = "SIGABRT"; break;
+    case SIGALRM: name = "SIGALRM"; break;
+    case SIGBUS:  name = "SIGBUS";  break;
+    case SIGFPE:  name = "SIGFPE";  break;
+    case SIGHUP:  name = "SIGHUP";  break;
+    case SIGILL:  name = "SIGILL";  break;
+    case SIGINT:  name = "SIGINT";  break;
+    case SIGKILL: name = "SIGKILL"; break;
+    case SIGPIPE: name = "SIGPIPE"; break;
+    case SIGQUIT: name = "SIGQUIT"; break;
+    case SIGSEGV: name = "SIGSEGV"; break;
+    case SIGSYS:  name = "SIGSYS";  break;
+    case SIGTERM: name = "SIGTERM"; break;
+    case SIGTRAP: name = "SIGTRAP"; break;
+    case SIGXCPU: name = "SIGXCPU"; break;
+    case SIGXFSZ: name = "SIGXFSZ"; break;
+    }
+
+    std::string result(name == nullptr ? "signal #" + std::to_string(sig) : name);
+    result += " (";
+    result += strsignal(sig);
+    result += ')';
+    return result;
+}
+
+
+/** \brief The history of the previous runs of the test cases.
+ *
+ * The history is saved in `<project-name>-test-history` under the
+ * g_binary_dir() folder. It is a small text file with one line per test
+ * case:
+ *
+ * \code
+ *     <failures> <duration> <last run> <name>
+ * \endcode
+ *
+ * where `<failures>` is a bit field of the results of the last 8 runs
+ * (bit 0 is set if the last run failed), `<duration>` is the number of
+ * seconds the last run took and `<last run>` the Unix time of the last
+ * run.
+ *
+ * Several test binaries may run at the same time. The update() function
+ * locks the file, reloads it, merges the new results and saves it under
+ * a temporary name which is then renamed. So readers always see a
+ * complete file and no results get lost.
+ */
+class run_history
+{
+public:
+    /** \brief Number of days after which an entry which did not run gets removed. */
+    static constexpr std::int64_t const EXPIRE_DAYS = 30;
+
+    struct entry_t
+    {
+        std::uint8_t    f_failures = 0;
+        double          f_duration = 0.0;
+        std::int64_t    f_last_run = 0;
+    };
+
+    run_history(std::string const & project_name)
+        : m_filename((g_binary_dir().empty() ? std::string(".") : g_binary_dir())
+                   + "/" + project_name + "-test-history")
+    {
+        load(m_entries);
+    }
+
+    /** \brief Sort the test cases so the ones most likely to fail run first.
+     *
+     * The test cases are sorted in these groups:
+     *
+     * \li the test cases which failed on their last run,
+     * \li the test cases which failed in one of their previous 8 runs,
+     * \li the new test cases and the test cases which source file was
+     *     modified since they last ran,
+     * \li all the other test cases.
+     *
+     * Within a group, the fastest test cases run first.
+     *
+     * \param[in,out] tests  The test cases to sort.
+     */
+    void order(std::vector<Catch::TestCaseHandle> & tests) const
+    {
+        struct key_t
+        {
+            int     f_group = 0;
+            double  f_duration = 0.0;
+        };
+        std::map<std::string, key_t> keys;
+        for(auto const & test : tests)
+        {
+            Catch::TestCaseInfo const & info(test.getTestCaseInfo());
+            key_t key;
+            auto const it(m_entries.find(info.name));
+            if(it == m_entries.end())
+            {
+                key.f_group = 2;
+            }
+            else
+            {
+                key.f_duration = it->second.f_duration;
+                if((it->second.f_failures & 1) != 0)
+                {
+                    key.f_group = 0;
+                }
+                else if(it->second.f_failures != 0)
+                {
+                    key.f_group = 1;
+                }
+                else if(source_modified_time(info) > it->second.f_last_run)
+                {
+                    key.f_group = 2;
+                }
+                else
+                {
+                    key.f_group = 3;
+                }
+            }
+            keys[info.name] = key;
+        }
+
+        std::stable_sort(
+              tests.begin()
+            , tests.end()
+            , [&keys](Catch::TestCaseHandle const & lhs, Catch::TestCaseHandle const & rhs)
+            {
+                key_t const & l(keys[lhs.getTestCaseInfo().name]);
+                key_t const & r(keys[rhs.getTestCaseInfo().name]);
+                if(l.f_group != r.f_group)
+                {
+                    return l.f_group < r.f_group;
+                }
+                return l.f_duration < r.f_duration;
+            });
+    }
+
+    /** \brief Save the results of this run in the history.
+     *
+     * \param[in] results  The results of the test cases that ran.
+     */
+    void update(std::vector<run_state::result_t> const & results)
+    {
+        if(results.empty())
+        {
+            return;
+        }
+
+        std::string const lock_filename(m_filename + ".lock");
+        int const lock(open(lock_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+        if(lock == -1
+        || flock(lock, LOCK_EX) != 0)
+        {
+            std::cerr << "warning: could not lock the test history \""
+                      << m_filename
+                      << "\".\n";
+            if(lock != -1)
+            {
+                close(lock);
+            }
+            return;
+        }
+
+        // another process may have updated the file since we loaded it
+        //
+        std::map<std::string, entry_t> entries;
+        load(entries);
+
+        std::int64_t const now(time(nullptr));
+        for(auto const & r : results)
+        {
+            entry_t & e(entries[r.f_name]);
+            e.f_failures = static_cast<std::uint8_t>((e.f_failures << 1) | (r.f_passed ? 0 : 1));
+            e.f_duration = r.f_duration;
+            e.f_last_run = now;
+        }
+
+        std::string const tmp(m_filename + ".tmp" + std::to_string(getpid()));
+        {
+            std::ofstream out(tmp);
+            out << std::fixed << std::setprecision(6);
+            for(auto const & e : entries)
+            {
+                if(now - e.second.f_last_run > EXPIRE_DAYS * 86400)
+                {
+                    continue;
+                }
+                out << static_cast<int>(e.second.f_failures)
+                    << ' ' << e.second.f_duration
+                    << ' ' << e.second.f_last_run
+                    << ' ' << e.first
+                    << '\n';
+            }
+            if(!out)
+            {
+                std::cerr << "warning: could not save the test history \""
+                          << m_filename
+                          << "\".\n";
+                unlink(tmp.c_str());
+                close(lock);
+                return;
+            }
+        }
+        rename(tmp.c_str(), m_filename.c_str());
+
+        m_entries.swap(entries);
+        close(lock);
+    }
+
+private:
+    void load(std::map<std::string, entry_t> & entries) const
+    {
+        std::ifstream in(m_filename);
+        std::string line;
+        while(std::getline(in, line))
+        {
+            std::istringstream is(line);
+            int failures(0);
+            entry_t e;
+            if(is >> failures >> e.f_duration >> e.f_last_run)
+            {
+                is.get();   // the space before the name
+                std::string name;
+                std::getline(is, name);
+                if(!name.empty())
+                {
+                    e.f_failures = static_cast<std::uint8_t>(failures);
+                    entries[name] = e;
+                }
+            }
+        }
+    }
+
+    /** \brief Get the time when the source of a test case was last modified.
+     *
+     * \param[in] info  The test case information.
+     *
+     * \return The modification time or 0 if the file is not found.
+     */
+    static std::int64_t source_modified_time(Catch::TestCaseInfo const & info)
+    {
+        std::string filename(info.lineInfo.file);
+        struct stat st = {};
+        if(stat(filename.c_str(), &st) != 0)
+        {
+            filename = g_source_dir() + '/' + filename;
+            if(g_source_dir().empty()
+            || stat(filename.c_str(), &st) != 0)
+            {
+                return 0;
+            }
+        }
+        return st.st_mtim.tv_sec;
+    }
+
+    std::string                         m_filename = std::string();
+    std::map<std::string, entry_t>      m_entries = std::map<std::string, entry_t>();
+};
+
+
+/** \brief Report the isolated test cases through the configured reporters.
+ *
+ * The children created by `--isolate` use a private console reporter
+ * writing to their output pipe. The parent creates the reporters of the
+ * command line (`-r`, `-o`) once and sends them the results of each
+ * child as if the test cases had run in the parent. This way a file such
+ * as a JUnit report gets written once with all the test cases.
+ *
+ * The details of a failure are not available in the parent so a failed
+ * test case gets reported with one failed assertion which message is the
+ * output of the child.
+ *
+ * `--skip-unchanged` also uses it to report an empty run when all the
+ * test cases were found in the cache.
+ */
+class isolated_reporter
+{
+public:
+    isolated_reporter(Catch::ConfigData const & data)
+        : m_config(data)
+    {
+        Catch::getCurrentMutableContext().setConfig(&m_config);
+        for(auto const & spec : m_config.getProcessedReporterSpecs())
+        {
+            Catch::IEventListenerPtr reporter(Catch::getRegistryHub().getReporterRegistry().create(
+                      spec.name
+                    , Catch::ReporterConfig(
+                              &m_config
+                            , Catch::makeStream(spec.outputFilename)
+                            , spec.colourMode
+                            , spec.customOptions)));
+            if(!reporter)
+            {
+                throw std::runtime_error("unknown reporter \"" + spec.name + "\".");
+            }
+            m_reporters.push_back(std::move(reporter));
+        }
+
+        Catch::TestRunInfo const run_info(m_config.name());
+        for(auto & r : m_reporters)
+        {
+            r->testRunStarting(run_info);
+        }
+    }
+
+    isolated_reporter(isolated_reporter const &) = delete;
+    isolated_reporter & operator = (isolated_reporter const &) = delete;
+
+    void test_case(
+              Catch::TestCaseInfo const & info
+            , Catch::Totals const & totals
+            , std::string const & error
+            , std::string const & output
+            , double duration)
+    {
+        Catch::SectionInfo const section(info.lineInfo, info.name);
+        Catch::AssertionInfo const assertion_info{
+                  "isolated test case"_catch_sr
+                , info.lineInfo
+                , Catch::StringRef()
+                , Catch::ResultDisposition::ContinueOnFailure };
+        bool const failed(!error.empty() || totals.testCases.failed != 0);
+
+        for(auto & r : m_reporters)
+        {
+            r->testCaseStarting(info);
+            r->testCasePartialStarting(info, 0);
+            r->sectionStarting(section);
+            if(failed)
+            {
+                Catch::AssertionResultData data(Catch::ResultWas::ExplicitFailure, Catch::LazyExpression(false));
+                data.message = error.empty() ? output : error + '\n' + output;
+                r->assertionStarting(assertion_info);
+                r->assertionEnded(Catch::AssertionStats(
+                          Catch::AssertionResult(assertion_info, std::move(data))
+                        , {}
+                        , totals));
+            }
+            r->sectionEnded(Catch::SectionStats(
+                      Catch::SectionInfo(section)
+                    , totals.assertions
+                    , duration
+                    , false));
+            r->testCasePartialEnded(Catch::TestCaseStats(info, totals, std::string(output), std::string(), false), 0);
+            r->testCaseEnded(Catch::TestCaseStats(info, totals, std::string(output), std::string(), false));
+        }
+    }
+
+    void test_run_ended(Catch::Totals const & totals)
+    {
+        Catch::TestRunInfo const run_info(m_config.name());
+        for(auto & r : m_reporters)
+        {
+            r->testRunEnded(Catch::TestRunStats(run_info, totals, false));
+        }
+    }
+
+private:
+    Catch::Config                           m_config;
+    std::vector<Catch::IEventListenerPtr>   m_reporters = std::vector<Catch::IEventListenerPtr>();
+};
+
+
+/** \brief Run each test case in its own process.
+ *
+ * This function is used when the `--isolate` command line option is used.
+ * The current process acts as a zygote: it already ran the expensive
+ * initialization and it forks one child per test case from that warm
+ * state. The children send their totals through a pipe and their output
+ * is buffered so that running several children concurrently (`--jobs`)
+ * does not mix up their output. The parent then reports the results
+ * through the configured reporters (see isolated_reporter).
+ *
+ * A child which crashes or times out is reported as a failure.
+ *
+ * When \p history is not null, the test cases most likely to fail run
+ * first (see run_history::order()).
+ *
+ * \param[in,out] session  The session with the command line applied.
+ * \param[in] history  The history used to order the test cases or nullptr.
+ *
+ * \return The exit code, 0 on success.
+ */
+inline int run_isolated(Catch::Session & session, run_history const * history = nullptr)
+{
+    static_assert(std::is_trivially_copyable<Catch::Totals>::value
+                , "Catch::Totals are sent through a pipe as is");
+
+    struct child_t
+    {
+        pid_t                           f_pid = -1;
+        Catch::TestCaseInfo const *     f_info = nullptr;
+        int                             f_result_fd = -1;
+        int                             f_output_fd = -1;
+        std::string                     f_result = std::string();
+        std::string                     f_output = std::string();
+        run_state::clock_t::time_point  f_start = run_state::clock_t::time_point();
+    };
+
+    Catch::ConfigData const original_data(session.configData());
+    Catch::ConfigData child_data(original_data);
+    child_data.reporterSpecifications = { Catch::ReporterSpec("compact", {}, {}, {}) };
+    child_data.defaultOutputFilename.clear();
+    std::vector<Catch::TestCaseHandle> tests(selected_test_cases(session));
+    if(history != nullptr)
+    {
+        history->order(tests);
+    }
+    std::size_t const jobs(static_cast<std::size_t>(std::max(1, g_jobs())));
+
+    isolated_reporter reporter(original_data);
+    Catch::Totals totals;
+    std::vector<child_t> running;
+    std::size_t next(0);
+
+    auto start_child = [&](Catch::TestCaseInfo const & info)
+    {
+        int result_pipe[2];
+        int output_pipe[2];
+        if(pipe2(result_pipe, O_CLOEXEC) != 0
+        || pipe2(output_pipe, O_CLOEXEC) != 0)
+        {
+            throw std::runtime_error("could not create pipes to run an isolated test case.");
+        }
+
+        // anything buffered would otherwise be output by the child too
+        //
+        std::cout << std::flush;
+        std::cerr << std::flush;
+        fflush(nullptr);
+
+        pid_t const pid(fork());
+        if(pid == -1)
+        {
+            throw std::runtime_error("could not fork() to run an isolated test case.");
+        }
+
+        if(pid == 0)
+        {
+            // child
+            //
+            close(result_pipe[0]);
+            close(output_pipe[0]);
+            checkpoint_journal::instance().close();
+            dup2(output_pipe[1], STDOUT_FILENO);
+            dup2(output_pipe[1], STDERR_FILENO);
+            close(output_pipe[1]);
+
+            int r(1);
+            try
+            {
+                // the child reports to its output pipe, the parent
+                // sends the results to the actual reporters
+                //
+                session.useConfigData(child_data);
+                select_test_cases(session, { info.name });
+
+                std::unique_ptr<watchdog> dog;
+                if(test_case_timeout(info) > 0)
+                {
+                    dog = std::make_unique<watchdog>();
+                }
+
+                r = session.run();
+            }
+            catch(std::exception const & e)
+            {
+                std::cerr << "fatal error: caught an exception running an isolated test case: "
+                          << e.what()
+                          << std::endl;
+            }
+
+            Catch::Totals const child_totals(run_state::instance().totals());
+            if(write(result_pipe[1], &child_totals, sizeof(child_totals)) != sizeof(child_totals))
+            {
+                r = 1;
+            }
+            std::cout << std::flush;
+            std::cerr << std::flush;
+            fflush(nullptr);
+            _exit(r);
+        }
+
+        // parent
+        //
+        close(result_pipe[1]);
+        close(output_pipe[1]);
+
+        child_t child;
+        child.f_pid = pid;
+        child.f_info = &info;
+        child.f_result_fd = result_pipe[0];
+        child.f_output_fd = output_pipe[0];
+        child.f_start = run_state::clock_t::now();
+        running.push_back(child);
+    };
+
+    auto child_done = [&](child_t & child)
+    {
+        int status(0);
+        while(waitpid(child.f_pid, &status, 0) == -1 && errno == EINTR);
+
+        double const duration(std::chrono::duration<double>(run_state::clock_t::now() - child.f_start).count());
+
+        std::string error;
+        Catch::Totals child_totals;
+        if(WIFSIGNALED(status))
+        {
+            error = "CRASHED with " + signal_name(WTERMSIG(status));
+        }
+        else if(WIFEXITED(status)
+             && WEXITSTATUS(status) == TEST_TIMEOUT_EXIT_CODE)
+        {
+            error = "TIMED OUT";
+        }
+        else if(child.f_result.length() != sizeof(child_totals))
+        {
+            error = "did not report any results";
+        }
+        else
+        {
+            memcpy(&child_totals, child.f_result.data(), sizeof(child_totals));
+            totals += child_totals;
+        }
+
+        bool const failed(!error.empty() || child_totals.testCases.failed != 0);
+        if(!error.empty())
+        {
+            ++totals.testCases.failed;
+            ++totals.assertions.failed;
+            ++child_totals.testCases.failed;
+            ++child_totals.assertions.failed;
+        }
+
+        reporter.test_case(*child.f_info, child_totals, error, child.f_output, duration);
+
+        std::string const & name(child.f_info->name);
+        run_state::instance().add_result({ name, !failed, duration });
+        checkpoint_journal::instance().record(name, !failed, duration, child_totals.assertions);
+    };
+
+    auto read_fd = [](int & fd, short revents, std::string & buffer)
+    {
+        if(fd == -1
+        || (revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+        {
+            return;
+        }
+        char buf[4096];
+        ssize_t const r(read(fd, buf, sizeof(buf)));
+        if(r > 0)
+        {
+            buffer.append(buf, static_cast<std::size_t>(r));
+        }
+        else if(r == 0 || errno != EINTR)
+        {
+            close(fd);
+            fd = -1;
+        }
+    };
+
+    int const abort_after(session.configData().abortAfter);
+    while(next < tests.size() || !running.empty())
+    {
+        while(running.size() < jobs && next < tests.size())
+        {
+            if(abort_after > 0
+            && totals.assertions.failed >= static_cast<std::uint64_t>(abort_after))
+            {
+                // --abort or --abortx <count> reached
+                //
+                next = tests.size();
+                break;
+            }
+            start_child(tests[next].getTestCaseInfo());
+            ++next;
+        }
+        if(running.empty())
+        {
+            break;
+        }
+
+        // a closed file descriptor is set to -1 which poll() ignores
+        //
+        std::vector<pollfd> fds;
+        for(auto const & child : running)
+        {
+            fds.push_back({ child.f_result_fd, POLLIN, 0 });
+            fds.push_back({ child.f_output_fd, POLLIN, 0 });
+        }
+        if(poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            throw std::runtime_error("poll() failed while running isolated test cases.");
+        }
+
+        for(std::size_t idx(0); idx < running.size(); ++idx)
+        {
+            read_fd(running[idx].f_result_fd, fds[idx * 2 + 0].revents, running[idx].f_result);
+            read_fd(running[idx].f_output_fd, fds[idx * 2 + 1].revents, running[idx].f_output);
+        }
+
+        for(auto it(running.begin()); it != running.end(); )
+        {
+            if(it->f_result_fd == -1
+            && it->f_output_fd == -1)
+            {
+                child_done(*it);
+                it = running.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    session.useConfigData(original_data);
+    reporter.test_run_ended(totals);
+
+    if(tests.empty())
+    {
+        return TEST_NO_TESTS_RUN_EXIT_CODE;
+    }
+    if(totals.assertions.failed != 0
+    || totals.testCases.failed != 0)
+    {
+        return TEST_FAILURE_EXIT_CODE;
+    }
+    return 0;
+}
+
+
+/** \brief Hash the build-id of all the binaries loaded in memory.
+ *
+ * The build-id changes each time a binary gets rebuilt. By hashing the
+ * build-id of the test itself and of all the libraries it loaded, we
+ * know whether any code changed since the last time we ran.
+ *
+ * A binary without a build-id is ignored.
+ *
+ * \return The hash of all the build-ids.
+ */
+inline std::string const & build_id_hash()
+{
+    static std::string const hash([]()
+        {
+            fnv1a h;
+            dl_iterate_phdr(
+                  [](struct dl_phdr_info * info, std::size_t size, void * data) -> int
+                  {
+                      static_cast<void>(size);
+                      fnv1a & result(*reinterpret_cast<fnv1a *>(data));
+                      for(ElfW(Half) idx(0); idx < info->dlpi_phnum; ++idx)
+                      {
+                          ElfW(Phdr) const & phdr(info->dlpi_phdr[idx]);
+                          if(phdr.p_type != PT_NOTE)
+                          {
+                              continue;
+                          }
+                          char const * ptr(reinterpret_cast<char const *>(info->dlpi_addr + phdr.p_vaddr));
+                          char const * end(ptr + phdr.p_memsz);
+                          while(ptr + sizeof(ElfW(Nhdr)) <= end)
+                          {
+                              ElfW(Nhdr) const * note(reinterpret_cast<ElfW(Nhdr) const *>(ptr));
+                              char const * name(ptr + sizeof(ElfW(Nhdr)));
+                              char const * desc(name + ((note->n_namesz + 3) & ~3U));
+                              if(note->n_type == NT_GNU_BUILD_ID
+                              && note->n_namesz == 4
+                              && memcmp(name, "GNU", 4) == 0)
+                              {
+                                  result.update(desc, note->n_descsz);
+                              }
+                              ptr = desc + ((note->n_descsz + 3) & ~3U);
+                          }
+                      }
+                      return 0;
+                  }
+                , &h);
+            return h.hex();
+        }());
+
+    return hash;
+}
+
+
+/** \brief Hash the contents of a file or directory.
+ *
+ * Directories are hashed recursively in a sorted order so the result
+ * does not depend on the order in which the file system returns the
+ * files. The name of each file is included in the hash.
+ *
+ * A file which does not exist is hashed as such so the key changes
+ * when the file gets created.
+ *
+ * \param[in,out] h  The hash to update.
+ * \param[in] path  The path to the file or directory.
+ */
+inline void hash_input(fnv1a & h, std::filesystem::path const & path)
+{
+    std::error_code ec;
+    if(std::filesystem::is_directory(path, ec))
+    {
+        std::vector<std::filesystem::path> files;
+        for(auto const & entry : std::filesystem::recursive_directory_iterator(path, ec))
+        {
+            if(entry.is_regular_file(ec))
+            {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        for(auto const & f : files)
+        {
+            hash_input(h, f);
+        }
+        return;
+    }
+
+    h.update(path.string());
+    int const fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if(fd == -1)
+    {
+        h.update("<missing>");
+        return;
+    }
+    char buf[64 * 1024];
+    for(;;)
+    {
+        ssize_t const r(read(fd, buf, sizeof(buf)));
+        if(r <= 0)
+        {
+            break;
+        }
+        h.update(buf, static_cast<std::size_t>(r));
+    }
+    close(fd);
+}
+
+
+/** \brief Get the list of input files a test case declared.
+ *
+ * The input files are declared with tags such as `[input=data/test.txt]`.
+ *
+ * \param[in] info  The test case information.
+ *
+ * \return The list of paths found in the tags.
+ */
+inline std::vector<std::string> test_case_inputs(Catch::TestCaseInfo const & info)
+{
+    std::vector<std::string> result;
+    for(auto const & tag : info.tags)
+    {
+        std::string const name(tag.original);
+        if(name.compare(0, 6, "input=") == 0)
+        {
+            result.push_back(name.substr(6));
+        }
+    }
+    return result;
+}
+
+
+/** \brief Compute the key of a test case for the result cache.
+ *
+ * \param[in] info  The test case information.
+ *
+ * \return The key of this test case.
+ */
+inline std::string test_case_key(Catch::TestCaseInfo const & info)
+{
+    fnv1a h;
+    h.update(build_id_hash());
+    h.update(info.name);
+    unsigned int const seed(g_seed());
+    h.update(&seed, sizeof(seed));
+    for(auto const & input : test_case_inputs(info))
+    {
+        hash_input(h, std::filesystem::path(g_source_dir()) / input);
+    }
+    return h.hex();
+}
+
+
+/** \brief Cache of the test cases which passed.
+ *
+ * The file is a text file with one line per test case which passed.
+ * Each line has the key of the test case followed by a space and the
+ * name of the test case.
+ *
+ * The file gets saved in a temporary file first and then renamed so
+ * a crash does not leave a broken cache behind. Several processes (i.e.
+ * `ctest -j` running one test case per process) share the same cache
+ * so the update happens under a lock and only the test cases which ran
+ * in this process change.
+ */
+class result_cache
+{
+public:
+    result_cache(std::string const & project_name)
+        : m_filename((g_binary_dir().empty() ? std::string(".") : g_binary_dir())
+                   + "/" + project_name + "-test-results.cache")
+    {
+        load(m_entries);
+    }
+
+    bool passed(std::string const & name, std::string const & key) const
+    {
+        auto const it(m_entries.find(name));
+        return it != m_entries.end() && it->second == key;
+    }
+
+    void set(std::string const & name, std::string const & key, bool passed)
+    {
+        // an empty key means the test case has to be removed
+        //
+        m_updates[name] = passed ? key : std::string();
+    }
+
+    void save()
+    {
+        if(m_updates.empty())
+        {
+            return;
+        }
+
+        std::string const lock_filename(m_filename + ".lock");
+        int const lock(open(lock_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+        if(lock == -1
+        || flock(lock, LOCK_EX) != 0)
+        {
+            std::cerr << "warning: could not lock test result cache \""
+                      << m_filename
+                      << "\".\n";
+            if(lock != -1)
+            {
+                close(lock);
+            }
+            return;
+        }
+
+        // another process may have updated the file since we loaded it
+        //
+        std::map<std::string, std::string> entries;
+        load(entries);
+        for(auto const & u : m_updates)
+        {
+            if(u.second.empty())
+            {
+                entries.erase(u.first);
+            }
+            else
+            {
+                entries[u.first] = u.second;
+            }
+        }
+
+        std::string const tmp(m_filename + ".tmp" + std::to_string(getpid()));
+        {
+            std::ofstream out(tmp);
+            for(auto const & e : entries)
+            {
+                out << e.second << ' ' << e.first << '\n';
+            }
+            if(!out)
+            {
+                std::cerr << "warning: could not save test result cache \""
+                          << m_filename
+                          << "\".\n";
+                unlink(tmp.c_str());
+                close(lock);
+                return;
+            }
+        }
+        rename(tmp.c_str(), m_filename.c_str());
+
+        m_entries.swap(entries);
+        m_updates.clear();
+        close(lock);
+    }
+
+private:
+    void load(std::map<std::string, std::string> & entries) const
+    {
+        std::ifstream in(m_filename);
+        std::string line;
+        while(std::getline(in, line))
+        {
+            std::string::size_type const pos(line.find(' '));
+            if(pos != std::string::npos)
+            {
+                entries[line.substr(pos + 1)] = line.substr(0, pos);
+            }
+        }
+    }
+
+    std::string                         m_filename = std::string();
+    std::map<std::string, std::string>  m_entries = std::map<std::string, std::string>();
+    std::map<std::string, std::string>  m_updates = std::map<std::string, std::string>();
+};
+
+
+/** \brief Remove the unchanged test cases from the session.
+ *
+ * This function computes the key of each selected test case and
+ * removes the ones found in the cache from the session. The keys
+ * are returned so the cache can be updated once the tests ran.
+ *
+ * \param[in,out] session  The session to update.
+ * \param[in] cache  The cache of test cases which passed before.
+ * \param[out] keys  The key of each test case that is going to run.
+ *
+ * \return The number of test cases that are going to run.
+ */
+inline std::size_t skip_unchanged_test_cases(
+      Catch::Session & session
+    , result_cache const & cache
+    , std::map<std::string, std::string> & keys)
+{
+    std::vector<std::string> run;
+    std::size_t cached(0);
+    for(auto const & test : selected_test_cases(session))
+    {
+        Catch::TestCaseInfo const & info(test.getTestCaseInfo());
+        std::string const key(test_case_key(info));
+        if(cache.passed(info.name, key))
+        {
+            std::cout << "[cached] " << info.name << '\n';
+            ++cached;
+        }
+        else
+        {
+            run.push_back(info.name);
+            keys[info.name] = key;
+        }
+    }
+    std::cout << cached
+              << " unchanged test case"
+              << (cached == 1 ? "" : "s")
+              << " skipped, "
+              << run.size()
+              << " to run."
+              << std::endl;
+
+    if(!run.empty())
+    {
+        select_test_cases(session, run);
+    }
+
+    return run.size();
+}
+
+
+/** \brief Remove the test cases found in a checkpoint journal.
+ *
+ * This function is used by `--resume` to only run the test cases which
+ * did not complete before the previous process died.
+ *
+ * \param[in,out] session  The session to update.
+ * \param[in] completed  The test cases found in the journal.
+ *
+ * \return The number of test cases that are going to run.
+ */
+inline std::size_t skip_completed_test_cases(
+      Catch::Session & session
+    , checkpoint_journal::entries_t const & completed)
+{
+    std::vector<std::string> run;
+    std::size_t skipped(0);
+    for(auto const & test : selected_test_cases(session))
+    {
+        Catch::TestCaseInfo const & info(test.getTestCaseInfo());
+        if(completed.find(info.name) != completed.end())
+        {
+            ++skipped;
+        }
+        else
+        {
+            run.push_back(info.name);
+        }
+    }
+    std::cout << skipped
+              << " completed test case"
+              << (skipped == 1 ? "" : "s")
+              << " skipped, "
+              << run.size()
+              << " to run."
+              << std::endl;
+
+    if(!run.empty())
+    {
+        select_test_cases(session, run);
+    }
+
+    return run.size();
+}
+
+
+/** \brief Print the results of all the test cases of a checkpoint journal.
+ *
+ * Once a resumed run is done, the journal includes the results of the
+ * previous processes and the current one. This function prints them as
+ * one run on stdout, which is why `--resume` refuses the other reporters.
+ *
+ * \param[in] filename  The name of the journal.
+ *
+ * \return true if all the test cases passed.
+ */
+inline bool report_checkpoint(std::string const & filename)
+{
+    unsigned int seed(0);
+    std::uint32_t rng_seed(0);
+    checkpoint_journal::entries_t const entries(checkpoint_journal::load(filename, seed, rng_seed));
+
+    Catch::Totals totals;
+    double duration(0.0);
+    std::vector<std::string> failures;
+    for(auto const & e : entries)
+    {
+        if(e.second.f_passed)
+        {
+            ++totals.testCases.passed;
+        }
+        else
+        {
+            ++totals.testCases.failed;
+            failures.push_back(e.first);
+        }
+        totals.assertions.passed += e.second.f_assertions_passed;
+        totals.assertions.failed += e.second.f_assertions_failed;
+        duration += e.second.f_duration;
+    }
+
+    std::cout << "===============================================================================\n"
+                 "merged results of \""
+              << filename
+              << "\" (seed "
+              << seed
+              << ", "
+              << std::fixed << std::setprecision(3) << duration
+              << "s):\n"
+                 "test cases: "
+              << totals.testCases.total()
+              << " | "
+              << totals.testCases.passed
+              << " passed | "
+              << totals.testCases.failed
+              << " failed\n"
+                 "assertions: "
+              << totals.assertions.total()
+              << " | "
+              << totals.assertions.passed
+              << " passed | "
+              << totals.assertions.failed
+              << " failed\n";
+    for(auto const & f : failures)
+    {
+        std::cout << "failed: " << f << '\n';
+    }
+    std::cout << std::flush;
+
+    return failures.empty() && totals.assertions.failed == 0;
+}
+
+
+/** \brief Append the duration of the test cases to the timings file.
+ *
+ * The lines are written with a single write() in append mode so several
+ * processes (i.e. ctest running many tests in parallel) can share the
+ * same file.
+ *
+ * \param[in] filename  The name of the file to append to.
+ * \param[in] results  The results of the test cases that ran.
+ */
+inline void save_timings(
+      std::string const & filename
+    , std::vector<run_state::result_t> const & results)
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(6);
+    for(auto const & r : results)
+    {
+        ss << r.f_duration << ' ' << r.f_name << '\n';
+    }
+    std::string const lines(ss.str());
+    if(lines.empty())
+    {
+        return;
+    }
+
+    int const fd(open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644));
+    if(fd == -1
+    || write(fd, lines.data(), lines.length()) != static_cast<ssize_t>(lines.length()))
+    {
+        std::cerr << "warning: could not save the test case timings to \""
+                  << filename
+                  << "\".\n";
+    }
+    if(fd != -1)
+    {
+        close(fd);
+    }
+}
+
+
+/** \brief The time the watcher waits for more changes before reacting.
+ *
+ * Editors and linkers often change a file in several steps (truncate,
+ * write, rename, chmod...). Waiting until no events were received for
+ * that long avoids running the tests against a half written file.
+ */
+constexpr int const WATCH_SETTLE_MS = 100;
+
+
+/** \brief Wait for the input files of the test cases to change.
+ *
+ * The `--watch` command line option creates one of these objects with
+ * the selected test cases. Each input declared with an `[input=<path>]`
+ * tag gets watched with inotify. A file is watched through its parent
+ * directory so files replaced with a rename() are also noticed. A
+ * directory is watched along all of its sub-directories.
+ *
+ * The directory of the test binary is also watched so a rebuild can be
+ * detected and the binary executed again.
+ */
+class file_watcher
+{
+public:
+    static constexpr std::uint32_t const WATCH_MASK =
+              IN_CLOSE_WRITE
+            | IN_MOVED_TO
+            | IN_MOVED_FROM
+            | IN_CREATE
+            | IN_DELETE
+            | IN_ATTRIB;
+
+    file_watcher(std::vector<Catch::TestCaseHandle> const & tests)
+    {
+        m_fd = inotify_init1(IN_CLOEXEC);
+        if(m_fd == -1)
+        {
+            throw std::runtime_error(
+                      std::string("could not initialize inotify: ")
+                    + strerror(errno));
+        }
+
+        std::error_code ec;
+        m_executable = std::filesystem::read_symlink("/proc/self/exe", ec);
+        if(!ec)
+        {
+            struct stat st = {};
+            if(stat(m_executable.c_str(), &st) == 0)
+            {
+                m_executable_mtime = st.st_mtim;
+                m_executable_inode = st.st_ino;
+            }
+            add_watch(m_executable.parent_path());
+        }
+
+        for(auto const & t : tests)
+        {
+            Catch::TestCaseInfo const & info(t.getTestCaseInfo());
+            for(auto const & input : test_case_inputs(info))
+            {
+                std::filesystem::path path(std::filesystem::absolute(
+                        std::filesystem::path(g_source_dir()) / input, ec).lexically_normal());
+                if(!path.has_filename())
+                {
+                    path = path.parent_path();
+                }
+                auto & entry(m_inputs[path.string()]);
+                entry.f_tests.push_back(info.name);
+                if(std::filesystem::is_directory(path, ec))
+                {
+                    entry.f_directory = true;
+                    add_directory(path);
+                }
+                else
+                {
+                    add_watch(path.parent_path());
+                }
+            }
+        }
+    }
+
+    file_watcher(file_watcher const &) = delete;
+    file_watcher & operator = (file_watcher const &) = delete;
+
+    ~file_watcher()
+    {
+        close(m_fd);
+    }
+
+    std::size_t size() const
+    {
+        return m_inputs.size();
+    }
+
+    std::string executable() const
+    {
+        return m_executable.string();
+    }
+
+    /** \brief Wait until an input or the test binary changes.
+     *
+     * \param[out] tests  The names of the test cases to run again.
+     *
+     * \return false if the test binary was rebuilt.
+     */
+    bool wait(std::vector<std::string> & tests)
+    {
+        for(;;)
+        {
+            std::set<std::string> changed;
+            read_events(changed, -1);
+            while(read_events(changed, WATCH_SETTLE_MS))
+            {
+            }
+
+            if(changed.count(m_executable.string()) != 0
+            && executable_changed())
+            {
+                return false;
+            }
+
+            std::set<std::string> names;
+            for(auto const & c : changed)
+            {
+                for(auto const & in : m_inputs)
+                {
+                    if(c == in.first
+                    || (in.second.f_directory
+                        && c.length() > in.first.length()
+                        && c.compare(0, in.first.length(), in.first) == 0
+                        && c[in.first.length()] == '/'))
+                    {
+                        names.insert(in.second.f_tests.begin(), in.second.f_tests.end());
+                    }
+                }
+            }
+            if(!names.empty())
+            {
+                tests.assign(names.begin(), names.end());
+                return true;
+            }
+        }
+    }
+
+private:
+    struct input_t
+    {
+        bool                        f_directory = false;
+        std::vector<std::string>    f_tests = std::vector<std::string>();
+    };
+
+    void add_watch(std::filesystem::path const & directory)
+    {
+        int const wd(inotify_add_watch(m_fd, directory.c_str(), WATCH_MASK));
+        if(wd == -1)
+        {
+            std::cerr << "warning: cannot watch \""
+                      << directory.string()
+                      << "\": "
+                      << strerror(errno)
+                      << ".\n";
+            return;
+        }
+        m_directories[wd] = directory.string();
+    }
+
+    void add_directory(std::filesystem::path const & directory)
+    {
+        add_watch(directory);
+        std::error_code ec;
+        for(std::filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if(it->is_directory(ec))
+            {
+                add_watch(it->path());
+            }
+        }
+    }
+
+    bool executable_changed() const
+    {
+        struct stat st = {};
+        if(stat(m_executable.c_str(), &st) != 0
+        || access(m_executable.c_str(), X_OK) != 0)
+        {
+            return false;
+        }
+        return st.st_ino != m_executable_inode
+            || st.st_mtim.tv_sec != m_executable_mtime.tv_sec
+            || st.st_mtim.tv_nsec != m_executable_mtime.tv_nsec;
+    }
+
+    /** \brief Read the pending inotify events.
+     *
+     * \param[in,out] changed  The set of paths which changed.
+     * \param[in] timeout  How long to wait for an event in milliseconds,
+     * -1 to wait forever.
+     *
+     * \return true if at least one event was read.
+     */
+    bool read_events(std::set<std::string> & changed, int timeout)
+    {
+        pollfd fd = { m_fd, POLLIN, 0 };
+        int const r(poll(&fd, 1, timeout));
+        if(r <= 0)
+        {
+            if(r == -1 && errno != EINTR)
+            {
+                throw std::runtime_error(
+                          std::string("could not wait for inotify events: ")
+                        + strerror(errno));
+            }
+            return false;
+        }
+
+        alignas(inotify_event) char buf[64 * 1024];
+        ssize_t const size(read(m_fd, buf, sizeof(buf)));
+        for(ssize_t pos(0); pos < size; )
+        {
+            inotify_event const * e(reinterpret_cast<inotify_event const *>(buf + pos));
+            pos += sizeof(inotify_event) + e->len;
+
+            auto const it(m_directories.find(e->wd));
+            if(it == m_directories.end()
+            || e->len == 0)
+            {
+                continue;
+            }
+            std::string const path(it->second + '/' + e->name);
+            changed.insert(path);
+
+            // a new sub-directory of a watched directory gets watched too
+            //
+            if((e->mask & IN_ISDIR) != 0
+            && (e->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+            {
+                add_directory(path);
+            }
+        }
+        return true;
+    }
+
+    int                                 m_fd = -1;
+    std::filesystem::path               m_executable = std::filesystem::path();
+    timespec                            m_executable_mtime = timespec();
+    ino_t                               m_executable_inode = 0;
+    std::map<int, std::string>          m_directories = std::map<int, std::string>();
+    std::map<std::string, input_t>      m_inputs = std::map<std::string, input_t>();
+};
+
+
+/** \brief Binary event log record types.
+ *
+ * The binary event log is a header followed by fixed size records. The
+ * STRING records are followed by the string bytes padded to a multiple
+ * of the record size.
+ */
+enum class binlog_record_t : std::uint8_t
+{
+    BINLOG_RECORD_STRING,
+    BINLOG_RECORD_RUN_START,
+    BINLOG_RECORD_RUN_END,
+    BINLOG_RECORD_TEST_CASE_START,
+    BINLOG_RECORD_TEST_CASE_END,
+    BINLOG_RECORD_SECTION_START,
+    BINLOG_RECORD_SECTION_END,
+    BINLOG_RECORD_ASSERTION,
+    BINLOG_RECORD_BENCHMARK,
+};
+
+
+struct binlog_header
+{
+    char            f_magic[8] = { 'S', 'N', 'A', 'P', 'B', 'L', 'O', 'G' };
+    std::uint32_t   f_version = 2;
+    std::uint32_t   f_record_size = 32;
+    std::uint64_t   f_start_time = 0;       // Unix time in nanoseconds
+    std::uint64_t   f_reserved = 0;
+};
+
+
+/** \brief One record of the binary event log.
+ *
+ * The meaning of the fields depends on the type of record:
+ *
+ * \li f_string -- the identifier of the main string (i.e. name, filename)
+ * \li f_extra -- the identifier of a second string (i.e. the expanded
+ * expression of a failed assertion) or the file of a test case or section;
+ * for the end of a test case, the number of assertions which failed
+ * \li f_flags -- BINLOG_FLAG_OK when an assertion is not a failure
+ * (Catch::AssertionResult::isOk(), so a `CHECK_NOFAIL()` is not a failure)
+ * \li f_result -- the Catch::ResultWas::OfType of an assertion or 1 when
+ * a test case passed
+ * \li f_time -- the number of nanoseconds since the log was started
+ * \li f_value -- a count, duration, string length, etc.; for the end of
+ * a test case, the number of assertions which passed
+ *
+ * Passing assertions are only saved when `-s` is used. The assertion
+ * counts of a test case come from its end record.
+ */
+struct binlog_record
+{
+    binlog_record_t f_type = binlog_record_t::BINLOG_RECORD_STRING;
+    std::uint8_t    f_flags = 0;
+    std::uint16_t   f_result = 0;
+    std::uint32_t   f_line = 0;
+    std::uint32_t   f_string = 0;
+    std::uint32_t   f_extra = 0;
+    std::uint64_t   f_time = 0;
+    std::uint64_t   f_value = 0;
+};
+
+/** \brief The binlog_record::f_flags bit set when an assertion is not a failure. */
+constexpr std::uint8_t const BINLOG_FLAG_OK = 0x01;
+
+
+static_assert(sizeof(binlog_header) == 32, "the binlog header must be 32 bytes");
+static_assert(sizeof(binlog_record) == 32, "the binlog records must be 32 bytes");
+
+
+/** \brief Append records to an mmap()'ed binary event log.
+ *
+ * Adding a record is a copy to memory. The file is grown in large steps
+ * so the kernel only gets involved once in a while.
+ */
+class binlog_writer
+{
+public:
+    typedef std::chrono::steady_clock   clock_t;
+
+    binlog_writer(std::string const & filename)
+        : m_fd(open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+    {
+        if(m_fd == -1)
+        {
+            throw std::runtime_error("could not create binary event log \"" + filename + "\".");
+        }
+        grow(0);
+
+        binlog_header header;
+        header.f_start_time = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
+        memcpy(m_data, &header, sizeof(header));
+        m_pos = sizeof(header);
+    }
+
+    binlog_writer(binlog_writer const &) = delete;
+    binlog_writer & operator = (binlog_writer const &) = delete;
+
+    ~binlog_writer()
+    {
+        munmap(m_data, m_size);
+        if(ftruncate(m_fd, static_cast<off_t>(m_pos)) != 0)
+        {
+            std::cerr << "warning: could not truncate the binary event log.\n";
+        }
+        close(m_fd);
+    }
+
+    std::uint64_t now() const
+    {
+        return static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock_t::now() - m_start).count());
+    }
+
+    void add(binlog_record const & record)
+    {
+        if(m_pos + sizeof(record) > m_size)
+        {
+            grow(sizeof(record));
+        }
+        memcpy(m_data + m_pos, &record, sizeof(record));
+        m_pos += sizeof(record);
+    }
+
+    /** \brief Add a string and return its identifier.
+     *
+     * The string is written as is. Use intern() to avoid saving the
+     * same string multiple times.
+     *
+     * \param[in] s  The string to add to the log.
+     *
+     * \return The new identifier of this string.
+     */
+    std::uint32_t add_string(std::string_view s)
+    {
+        ++m_next_string;
+
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_STRING;
+        record.f_string = m_next_string;
+        record.f_value = s.length();
+        add(record);
+
+        std::size_t const padded((s.length() + sizeof(record) - 1) & ~(sizeof(record) - 1));
+        if(m_pos + padded > m_size)
+        {
+            grow(padded);
+        }
+        memcpy(m_data + m_pos, s.data(), s.length());
+        memset(m_data + m_pos + s.length(), 0, padded - s.length());
+        m_pos += padded;
+
+        return m_next_string;
+    }
+
+    std::uint32_t intern(std::string const & s)
+    {
+        auto const it(m_strings.find(s));
+        if(it != m_strings.end())
+        {
+            return it->second;
+        }
+        std::uint32_t const id(add_string(s));
+        m_strings[s] = id;
+        return id;
+    }
+
+    /** \brief Intern a filename.
+     *
+     * The filenames found in the source line information of Catch2 are
+     * string literals so we can use their pointer as the key.
+     *
+     * \param[in] filename  The filename to intern.
+     *
+     * \return The identifier of the filename.
+     */
+    std::uint32_t intern_file(char const * filename)
+    {
+        if(filename == m_last_file)
+        {
+            return m_last_file_id;
+        }
+        auto const it(m_files.find(filename));
+        if(it != m_files.end())
+        {
+            m_last_file = filename;
+            m_last_file_id = it->second;
+            return it->second;
+        }
+        std::uint32_t const id(add_string(filename));
+        m_files[filename] = id;
+        m_last_file = filename;
+        m_last_file_id = id;
+        return id;
+    }
+
+private:
+    void grow(std::size_t min)
+    {
+        constexpr std::size_t const GROW_SIZE = 16 * 1024 * 1024;
+
+        std::size_t const size(std::max(m_size * 2, m_size + std::max(min, GROW_SIZE)));
+        if(ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+        {
+            throw std::runtime_error("could not grow the binary event log.");
+        }
+        void * data(m_data == nullptr
+                    ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0)
+                    : mremap(m_data, m_size, size, MREMAP_MAYMOVE));
+        if(data == MAP_FAILED)
+        {
+            throw std::runtime_error("could not map the binary event log.");
+        }
+        m_data = reinterpret_cast<char *>(data);
+        m_size = size;
+    }
+
+    int                                             m_fd = -1;
+    char *                                          m_data = nullptr;
+    std::size_t                                     m_size = 0;
+    std::size_t                                     m_pos = 0;
+    clock_t::time_point                             m_start = clock_t::now();
+    std::uint32_t                                   m_next_string = 0;
+    std::map<std::string, std::uint32_t>            m_strings = std::map<std::string, std::uint32_t>();
+    std::map<void const *, std::uint32_t>           m_files = std::map<void const *, std::uint32_t>();
+    void const *                                    m_last_file = nullptr;
+    std::uint32_t                                   m_last_file_id = 0;
+};
+
+
+/** \brief A reporter saving the events in a binary log.
+ *
+ * This reporter is selected with `-r snapcatch2-binlog`. It saves all
+ * the events (test cases, sections, assertions, benchmarks) in a compact
+ * binary log. The text of an assertion is only saved when it fails.
+ *
+ * The filename is specified with the standard `out` option (or `-o`),
+ * or the `Xfile` option:
+ *
+ * \code
+ *     my-tests -r snapcatch2-binlog::out=run.binlog
+ *     my-tests -r snapcatch2-binlog::Xfile=run.binlog
+ * \endcode
+ *
+ * The default filename is `snapcatch2.binlog`. See
+ * redirect_binlog_output() for the `out` option.
+ *
+ * Use `--binlog-convert <file>` to transform the log to a console,
+ * JUnit or JSON report.
+ */
+class binlog_reporter
+    : public Catch::StreamingReporterBase
+{
+public:
+    binlog_reporter(Catch::ReporterConfig && config)
+        : StreamingReporterBase(std::move(config))
+    {
+        auto const it(m_customOptions.find("Xfile"));
+        m_writer = std::make_unique<binlog_writer>(
+                it == m_customOptions.end() ? std::string("snapcatch2.binlog") : it->second);
+    }
+
+    static std::string getDescription()
+    {
+        return "snapcatch2 compact binary event log (use ::out=<path> to name the output file)";
+    }
+
+    void testRunStarting(Catch::TestRunInfo const & info) override
+    {
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_RUN_START;
+        record.f_string = m_writer->add_string(std::string_view(info.name.data(), info.name.size()));
+        record.f_time = m_writer->now();
+        m_writer->add(record);
+    }
+
+    void testCaseStarting(Catch::TestCaseInfo const & info) override
+    {
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_TEST_CASE_START;
+        record.f_string = m_writer->intern(info.name);
+        record.f_extra = m_writer->intern_file(info.lineInfo.file);
+        record.f_line = static_cast<std::uint32_t>(info.lineInfo.line);
+        record.f_time = m_writer->now();
+        m_writer->add(record);
+    }
+
+    void sectionStarting(Catch::SectionInfo const & info) override
+    {
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_SECTION_START;
+        record.f_string = m_writer->intern(info.name);
+        record.f_extra = m_writer->intern_file(info.lineInfo.file);
+        record.f_line = static_cast<std::uint32_t>(info.lineInfo.line);
+        record.f_time = m_writer->now();
+        m_writer->add(record);
+    }
+
+    void sectionEnded(Catch::SectionStats const & stats) override
+    {
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_SECTION_END;
+        record.f_time = m_writer->now();
+        record.f_value = stats.assertions.failed;
+        m_writer->add(record);
+    }
+
+    void assertionEnded(Catch::AssertionStats const & stats) override
+    {
+        Catch::AssertionResult const & result(stats.assertionResult);
+        Catch::SourceLineInfo const & line_info(result.getSourceInfo());
+
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_ASSERTION;
+        record.f_result = static_cast<std::uint16_t>(result.getResultType());
+        record.f_string = m_writer->intern_file(line_info.file);
+        record.f_line = static_cast<std::uint32_t>(line_info.line);
+        record.f_time = m_writer->now();
+        if(result.isOk())
+        {
+            record.f_flags |= BINLOG_FLAG_OK;
+        }
+        else
+        {
+            // only failures pay for the text
+            //
+            std::string text;
+            if(result.hasExpression())
+            {
+                text = result.getExpressionInMacro();
+                if(result.hasExpandedExpression())
+                {
+                    text += "\nwith expansion:\n  ";
+                    text += result.getExpandedExpression();
+                }
+            }
+            if(result.hasMessage())
+            {
+                if(!text.empty())
+                {
+                    text += '\n';
+                }
+                text += result.getMessage();
+            }
+            for(auto const & info : stats.infoMessages)
+            {
+                text += "\nwith message:\n  ";
+                text += info.message;
+            }
+            record.f_extra = m_writer->add_string(text);
+        }
+        m_writer->add(record);
+    }
+
+    void testCaseEnded(Catch::TestCaseStats const & stats) override
+    {
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_TEST_CASE_END;
+        record.f_result = stats.totals.testCases.failed == 0 ? 1 : 0;
+        record.f_time = m_writer->now();
+        record.f_extra = static_cast<std::uint32_t>(std::min<std::uint64_t>(
+                  stats.totals.assertions.failed
+                , std::numeric_limits<std::uint32_t>::max()));
+        record.f_value = stats.totals.assertions.passed;
+        m_writer->add(record);
+        StreamingReporterBase::testCaseEnded(stats);
+    }
+
+    void benchmarkEnded(Catch::BenchmarkStats<> const & stats) override
+    {
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_BENCHMARK;
+        record.f_string = m_writer->intern(stats.info.name);
+        record.f_time = m_writer->now();
+        record.f_value = static_cast<std::uint64_t>(stats.mean.point.count());
+        m_writer->add(record);
+    }
+
+    void testRunEnded(Catch::TestRunStats const & stats) override
+    {
+        binlog_record record;
+        record.f_type = binlog_record_t::BINLOG_RECORD_RUN_END;
+        record.f_time = m_writer->now();
+        record.f_value = stats.totals.assertions.total();
+        m_writer->add(record);
+        m_writer.reset();
+
+        m_stream << "binary event log: "
+                 << stats.totals.testCases.total()
+                 << " test cases ("
+                 << stats.totals.testCases.failed
+                 << " failed), "
+                 << stats.totals.assertions.total()
+                 << " assertions ("
+                 << stats.totals.assertions.failed
+                 << " failed)"
+                 << std::endl;
+        StreamingReporterBase::testRunEnded(stats);
+    }
+
+private:
+    std::unique_ptr<binlog_writer>      m_writer = std::unique_ptr<binlog_writer>();
+};
+
+
+/** \brief Send the output file of the binlog reporters to their writer.
+ *
+ * Catch2 opens the output of a reporter (`::out=<file>` or `-o <file>`)
+ * as a stream, which the binlog reporter cannot memory map. This function
+ * moves that filename to the reporter `Xfile` option and sends the one
+ * line summary written to the stream to stderr instead.
+ *
+ * \exception std::runtime_error
+ * Raised if a binlog reporter has an output file and a different `Xfile`.
+ *
+ * \param[in,out] session  The session with the parsed command line.
+ */
+inline void redirect_binlog_output(Catch::Session & session)
+{
+    Catch::ConfigData data(session.configData());
+    bool changed(false);
+    for(auto & spec : data.reporterSpecifications)
+    {
+        if(spec.name() != "snapcatch2-binlog")
+        {
+            continue;
+        }
+        std::string const filename(spec.outputFile()
+                ? *spec.outputFile()
+                : data.defaultOutputFilename);
+        if(filename.empty()
+        || filename == "-"
+        || filename[0] == '%')
+        {
+            continue;
+        }
+
+        std::map<std::string, std::string> options(spec.customOptions());
+        auto const it(options.find("Xfile"));
+        if(it != options.end()
+        && it->second != filename)
+        {
+            throw std::runtime_error(
+                      "the snapcatch2-binlog reporter output \""
+                    + filename
+                    + "\" does not match its Xfile option \""
+                    + it->second
+                    + "\".");
+        }
+        options["Xfile"] = filename;
+        spec = Catch::ReporterSpec(
+                  spec.name()
+                , std::string("%stderr")
+                , spec.colourMode()
+                , options);
+        changed = true;
+    }
+    if(changed)
+    {
+        session.useConfigData(data);
+    }
+}
+
+
+/** \brief Escape a string for XML or JSON output.
+ *
+ * \param[in] s  The string to escape.
+ * \param[in] json  Whether to escape for JSON (true) or XML (false).
+ *
+ * \return The escaped string.
+ */
+inline std::string binlog_escape(std::string_view s, bool json)
+{
+    std::string result;
+    result.reserve(s.length());
+    for(auto const c : s)
+    {
+        switch(c)
+        {
+        case '"':  result += json ? "\\\"" : "&quot;"; break;
+        case '&':  result += json ? "&" : "&amp;"; break;
+        case '<':  result += json ? "<" : "&lt;"; break;
+        case '>':  result += json ? ">" : "&gt;"; break;
+        case '\\': result += json ? "\\\\" : "\\"; break;
+        case '\n': result += json ? "\\n" : "&#10;"; break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20)
+            {
+                std::stringstream ss;
+                ss << (json ? "\\u" : "&#x")
+                   << std::hex << std::setfill('0') << std::setw(4)
+                   << static_cast<int>(c)
+                   << (json ? "" : ";");
+                result += ss.str();
+            }
+            else
+            {
+                result += c;
+            }
+            break;
+
+        }
+    }
+    return result;
+}
+
+
+/** \brief Convert a binary event log to a text report.
+ *
+ * This function reads a log created by the `snapcatch2-binlog` reporter
+ * and writes a report in the specified \p format:
+ *
+ * \li "console" -- one line per test case and the failures
+ * \li "junit" -- a JUnit XML report
+ * \li "json" -- a JSON document
+ *
+ * \param[in] filename  The name of the binary event log.
+ * \param[in] format  The output format.
+ * \param[in] out  The stream where the report is written.
+ *
+ * A test case which started but has no end record was running when the
+ * process died. It is reported as crashed and counts as a failure.
+ *
+ * \return 0 if all the test cases passed, 1 otherwise.
+ */
+inline int convert_binlog(std::string const & filename, std::string const & format, std::ostream & out)
+{
+    struct failure_t
+    {
+        std::string_view    f_file = std::string_view();
+        std::uint32_t       f_line = 0;
+        std::string_view    f_text = std::string_view();
+    };
+
+    struct test_case_t
+    {
+        std::string_view        f_name = std::string_view();
+        std::string_view        f_file = std::string_view();
+        std::uint32_t           f_line = 0;
+        bool                    f_passed = true;
+        bool                    f_crashed = true;
+        double                  f_duration = 0.0;
+        std::uint64_t           f_assertions = 0;
+        std::uint64_t           f_failed = 0;
+        std::uint64_t           f_start = 0;
+        std::vector<failure_t>  f_failures = std::vector<failure_t>();
+    };
+
+    if(format != "console" && format != "junit" && format != "json")
+    {
+        throw std::runtime_error("unknown binary event log format \"" + format + "\".");
+    }
+
+    int const fd(open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+    if(fd == -1)
+    {
+        throw std::runtime_error("could not open binary event log \"" + filename + "\".");
+    }
+    struct stat st = {};
+    fstat(fd, &st);
+    std::size_t const size(static_cast<std::size_t>(st.st_size));
+    void * map(size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        throw std::runtime_error("could not read binary event log \"" + filename + "\".");
+    }
+    std::shared_ptr<void> auto_unmap(map, [size](void * p) { munmap(p, size); });
+    char const * data(reinterpret_cast<char const *>(map));
+
+    binlog_header header;
+    binlog_header const expected;
+    if(size < sizeof(header)
+    || memcmp(data, expected.f_magic, sizeof(expected.f_magic)) != 0)
+    {
+        throw std::runtime_error("\"" + filename + "\" is not a snapcatch2 binary event log.");
+    }
+    memcpy(&header, data, sizeof(header));
+    if(header.f_version != 2
+    || header.f_record_size != sizeof(binlog_record))
+    {
+        throw std::runtime_error("unsupported binary event log version in \"" + filename + "\".");
+    }
+
+    std::vector<std::string_view> strings(1);
+    std::vector<test_case_t> test_cases;
+    std::uint64_t end_time(0);
+    for(std::size_t pos(sizeof(header)); pos + sizeof(binlog_record) <= size; )
+    {
+        binlog_record record;
+        memcpy(&record, data + pos, sizeof(record));
+        pos += sizeof(record);
+
+        auto str = [&strings](std::uint32_t id)
+        {
+            return id < strings.size() ? strings[id] : std::string_view();
+        };
+
+        switch(record.f_type)
+        {
+        case binlog_record_t::BINLOG_RECORD_STRING:
+            {
+                std::size_t const length(std::min<std::size_t>(record.f_value, size - pos));
+                if(strings.size() <= record.f_string)
+                {
+                    strings.resize(record.f_string + 1);
+                }
+                strings[record.f_string] = std::string_view(data + pos, length);
+                pos += (length + sizeof(record) - 1) & ~(sizeof(record) - 1);
+            }
+            break;
+
+        case binlog_record_t::BINLOG_RECORD_TEST_CASE_START:
+            test_cases.emplace_back();
+            test_cases.back().f_name = str(record.f_string);
+            test_cases.back().f_file = str(record.f_extra);
+            test_cases.back().f_line = record.f_line;
+            test_cases.back().f_start = record.f_time;
+            break;
+
+        case binlog_record_t::BINLOG_RECORD_TEST_CASE_END:
+            if(!test_cases.empty())
+            {
+                test_cases.back().f_passed = record.f_result != 0;
+                test_cases.back().f_crashed = false;
+                test_cases.back().f_assertions = record.f_value + record.f_extra;
+                test_cases.back().f_failed = record.f_extra;
+                test_cases.back().f_duration = static_cast<double>(record.f_time - test_cases.back().f_start) / 1e9;
+            }
+            break;
+
+        case binlog_record_t::BINLOG_RECORD_ASSERTION:
+            if(!test_cases.empty()
+            && (record.f_flags & BINLOG_FLAG_OK) == 0)
+            {
+                test_cases.back().f_failures.push_back({ str(record.f_string), record.f_line, str(record.f_extra) });
+            }
+            break;
+
+        case binlog_record_t::BINLOG_RECORD_RUN_END:
+            end_time = record.f_time;
+            break;
+
+        default:
+            // sections and benchmarks are not reported yet
+            break;
+
+        }
+    }
+
+    // a test case without an end record was running when the process
+    // died; that is a failure even if none of its assertions failed
+    //
+    std::uint64_t failed(0);
+    std::uint64_t crashed(0);
+    std::uint64_t assertions(0);
+    std::uint64_t assertions_failed(0);
+    for(auto & tc : test_cases)
+    {
+        if(tc.f_crashed)
+        {
+            tc.f_passed = false;
+            ++crashed;
+        }
+        failed += tc.f_passed ? 0 : 1;
+        assertions += tc.f_assertions;
+        assertions_failed += tc.f_failed;
+    }
+
+    if(format == "console")
+    {
+        for(auto const & tc : test_cases)
+        {
+            out << (tc.f_crashed ? "[CRASHED] " : tc.f_passed ? "[ok] " : "[FAILED] ")
+                << tc.f_name
+                << " ("
+                << tc.f_duration
+                << "s)\n";
+            for(auto const & f : tc.f_failures)
+            {
+                out << f.f_file << ':' << f.f_line << ": FAILED:\n  " << f.f_text << '\n';
+            }
+        }
+        out << "===============================================================================\n"
+               "test cases: "
+            << test_cases.size()
+            << " | "
+            << failed
+            << " failed | "
+            << crashed
+            << " crashed\nassertions: "
+            << assertions
+            << " | "
+            << assertions_failed
+            << " failed\n";
+    }
+    else if(format == "junit")
+    {
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<testsuites>\n"
+               "  <testsuite name=\""
+            << binlog_escape(strings.size() > 1 ? strings[1] : std::string_view(), false)
+            << "\" errors=\""
+            << crashed
+            << "\" failures=\""
+            << failed - crashed
+            << "\" tests=\""
+            << test_cases.size()
+            << "\" time=\""
+            << static_cast<double>(end_time) / 1e9
+            << "\">\n";
+        for(auto const & tc : test_cases)
+        {
+            out << "    <testcase classname=\"global\" name=\""
+                << binlog_escape(tc.f_name, false)
+                << "\" time=\""
+                << tc.f_duration
+                << "\"";
+            if(tc.f_failures.empty()
+            && !tc.f_crashed)
+            {
+                out << "/>\n";
+                continue;
+            }
+            out << ">\n";
+            if(tc.f_crashed)
+            {
+                out << "      <error message=\"crashed\">the process died while this test case was running</error>\n";
+            }
+            for(auto const & f : tc.f_failures)
+            {
+                out << "      <failure message=\""
+                    << binlog_escape(f.f_text.substr(0, f.f_text.find('\n')), false)
+                    << "\">"
+                    << binlog_escape(f.f_file, false)
+                    << ':'
+                    << f.f_line
+                    << "&#10;"
+                    << binlog_escape(f.f_text, false)
+                    << "</failure>\n";
+            }
+            out << "    </testcase>\n";
+        }
+        out << "  </testsuite>\n"
+               "</testsuites>\n";
+    }
+    else
+    {
+        out << "{\n  \"test-cases\": [";
+        char const * sep("\n");
+        for(auto const & tc : test_cases)
+        {
+            out << sep
+                << "    {\"name\": \"" << binlog_escape(tc.f_name, true)
+                << "\", \"file\": \"" << binlog_escape(tc.f_file, true)
+                << "\", \"line\": " << tc.f_line
+                << ", \"passed\": " << (tc.f_passed ? "true" : "false")
+                << ", \"crashed\": " << (tc.f_crashed ? "true" : "false")
+                << ", \"duration\": " << tc.f_duration
+                << ", \"assertions\": " << tc.f_assertions
+                << ", \"failed\": " << tc.f_failed
+                << ", \"failures\": [";
+            char const * fsep("");
+            for(auto const & f : tc.f_failures)
+            {
+                out << fsep
+                    << "{\"file\": \"" << binlog_escape(f.f_file, true)
+                    << "\", \"line\": " << f.f_line
+                    << ", \"message\": \"" << binlog_escape(f.f_text, true)
+                    << "\"}";
+                fsep = ", ";
+            }
+            out << "]}";
+            sep = ",\n";
+        }
+        out << "\n  ],\n"
+               "  \"totals\": {\"test-cases\": " << test_cases.size()
+            << ", \"failed\": " << failed
+            << ", \"crashed\": " << crashed
+            << ", \"assertions\": " << assertions
+            << ", \"assertions-failed\": " << assertions_failed
+            << "}\n}\n";
+    }
+
+    return failed == 0 ? 0 : 1;
+}
+
+
+} // detail namespace
+
+
+#ifdef CATCH_CONFIG_RUNNER
+/** \brief The main function to initialize and run the unit tests.
+ *
+ * This inline function initializes and runs the snapcatch2 tests.
+ *
+ * The \p init_callback parameter is used to initialize your test before
+ * we parse the command line. Use the \p callback function to do further
+ * initialization after the command line is parsed and basic functions
+ * run (i.e. the `--version` command line option will run and the
+ * function exit before \p callback gets called. So when the user uses
+ * that command line option, you do not get \p callback called, however,
+ * \p init_callback will always be called).
+ *
+ * We do it this way because the function will try/catch std::exception
+ * so if an exception occurs in your \p init_callback, it will always
+ * be captured and a message printed out before the application
+ * exits cleanly with an error code (i.e. `exit(1)`).
+ *
+ * The \p init_callback can be set to a nullptr if you do not need to
+ * initialize anything futher early on.
+ *
+ * One thing we use the \p init_callback for is to prevent our
+ * libexcept exceptions from generating a stack trace because that's
+ * very slow and in a test which generate thousands if not million
+ * of exception cases, it makes it really very slow.
+ *
+ * \code
+ *     snap_catch2_main(
+ *           "libutf8"
+ *         , "1.2.3"
+ *         , argc
+ *         , argv
+ *         , []() { libexcept::set_collect_stack(libexcept::collect_stack_t::COLLECT_STACK_NO); }
+ *     );
+ * \endcode
+ *
+ * The \p add_user_options parameter is a pointer to a function which
+ * adds command line options supported by your test. This pointer can
+ * be set to nullptr, For example, if you wanted to support a path to
+ * a temporary directory, you would write:
+ *
+ * \code
+ *     namespace SNAP_CATCH2_NAMESPACE
+ *     {
+ *
+ *     std::string g_conf_dir = std::string("/etc/config");
+ *
+ *     Catch::Clara::Parser add_command_line_options(Catch::Clara::Parser const & cli)
+ *     {
+ *         return cli
+ *              | Catch::Clara::Opt(g_conf_dir, "conf-dir")
+ *                   ["--conf-dir"]
+ *                   ("a path to a configuration directory used by the test.");
+ *     }
+ *
+ *     }
+ *
+ *     ...snip...
+ *
+ *     snap_catch2_main(
+ *           "libutf8"
+ *         , "1.2.3"
+ *         , argc
+ *         , argv
+ *         , nullptr
+ *         , &add_command_line_options
+ *     );
+ * \endcode
+ *
+ * \warning
+ * It is possible to add a one letter command line option such as ["-t"],
+ * however, catch2 already uses most of these options. The `-t` is used
+ * to list tags, for example.
+ *
+ * The \p callback function gets called just before the tests run.
+ * In other words, we give you one more chance to verify command line
+ * parameters or do additional initilalizations, now that you have access
+ * to the user defined command line parameters. We pass the session to
+ * the function, although in many cases you will not use it because your
+ * parameters are already set as expected.
+ *
+ * \code
+ *     namespace SNAP_CATCH2_NAMESPACE
+ *     {
+ *
+ *     int finish_init(Catch::Session & session)
+ *     {
+ *         std::string cmd("rm -rf ");
+ *         cmd += g_conf_dir;
+ *         cmd += "/my-project";
+ *         if(system(cmd.c_str()) != 0)
+ *         {
+ *             perror(cmd.c_str());
+ *             return 1;
+ *         }
+ *
+ *         return 0;
+ *     }
+ *
+ *     }
+ *
+ *     ...snip...
+ *
+ *     snap_catch2_main(
+ *           "libutf8"
+ *         , "1.2.3"
+ *         , argc
+ *         , argv
+ *         , nullptr
+ *         , nullptr
+ *         , &finish_init
+ *     );
+ * \endcode
+ *
+ * Once the tests ran, we call the \p finished_callback as well. This gives
+ * you the ability to test futher things such as making sure that everything
+ * was cleaned up, resources released, etc. For example, in our advgetopt
+ * we use a FIFO to handle error messages. If an error never occurs that
+ * FIFO will not be empty on exit. This is actually an error in the test.
+ * Only errors that do occur have to be added to the FIFO. So on exit we
+ * want to verify that the FIFO is indeed empty.
+ *
+ * \param[in] project_name  The name of the project (i.e. "libutf8").
+ * \param[in] project_version  The version string of the project
+ *                     (i.e. "LIBUTF8_VERSION_STRING").
+ * \param[in] argc  The number of arguments on the command line.
+ * \param[in] argv  An array of strings with the command line arguments.
+ * \param[in] init_callback  Callback called before anything else.
+ * \param[in] add_user_options  A callback giving you the opportunity to add
+ *                              command line options before argv gets parsed.
+ * \param[in] callback  A callback called just before we run the tests.
+ * \param[in] finished_callback  The callback called just after all the tests
+ *                               ran.
+ *
+ * \return The exit code, usually 0 on success and 1 on an error.
+ */
+inline int snap_catch2_main(
+          char const * project_name
+        , char const * project_version
+        , int argc
+        , char * argv[]
+        , void (*init_callback)() = nullptr
+        , void (*add_user_options)(Catch::Clara::Parser & cli) = nullptr
+        , int (*callback)(Catch::Session & session) = nullptr
+        , void (*finished_callback)() = nullptr)
+{
+    typedef unsigned int seed_t; // see `man srand(3)` for type
+
+    try
+    {
+        if(init_callback != nullptr)
+        {
+            init_callback();
+        }
+
+        // reporters must be registered before the command line is parsed
+        //
+        Catch::ReporterRegistrar<detail::binlog_reporter> const binlog_registrar("snapcatch2-binlog");
+
+        Catch::Session session;
+
+        bool version(false);
+        seed_t seed(static_cast<seed_t>(time(NULL)));
+        std::string binlog_convert;
+        std::string binlog_format("console");
+
+        auto cli = session.cli();
+        cli |= Catch::Clara::Opt(seed, "seed")
+                    ["-S"]["--seed"]
+                    ("value to seed the randomizer, if not specified, use time()")
+                 | Catch::Clara::Opt(g_progress())
+                    ["-p"]["--progress"]
+                    ("print name of test section being run")
+                 | Catch::Clara::Opt(g_source_dir(), "source_dir")
+                    ["--source-dir"]
+                    ("specify the full path to the source directory")
+                 | Catch::Clara::Opt(g_binary_dir(), "binary_dir")
+                    ["--binary-dir"]
+                    ("specify the full path to the binary directory")
+                 | Catch::Clara::Opt(g_dist_dir(), "dist_dir")
+                    ["--dist-dir"]
+                    ("specify the full path to the dist directory")
+                 | Catch::Clara::Opt(g_tmp_dir(), "tmp_dir")
+                    ["-T"]["--tmp-dir"]
+                    ("specify a temporary directory")
+                 | Catch::Clara::Opt(g_test_timeout(), "seconds")
+                    ["--test-timeout"]
+                    ("maximum number of seconds each test case can run, a [timeout=<seconds>] tag overrides this value")
+                 | Catch::Clara::Opt(g_isolate())
+                    ["--isolate"]
+                    ("run each test case in its own process")
+                 | Catch::Clara::Opt(g_jobs(), "count")
+                    ["--jobs"]
+                    ("number of isolated test cases to run concurrently")
+                 | Catch::Clara::Opt(g_skip_unchanged())
+                    ["--skip-unchanged"]
+                    ("skip test cases which passed before and did not change since")
+                 | Catch::Clara::Opt(g_capture())
+                    ["--capture"]
+                    ("capture stdout and stderr of each test case and only print them if it fails")
+                 | Catch::Clara::Opt(g_failed_first())
+                    ["--failed-first"]
+                    ("run the test cases which failed recently or changed first, then the fastest ones (requires --isolate)")
+                 | Catch::Clara::Opt(g_watch())
+                    ["--watch"]
+                    ("run the test cases again each time one of their input files changes")
+                 | Catch::Clara::Opt(g_checkpoint(), "journal")
+                    ["--checkpoint"]
+                    ("append the results of the completed test cases to <journal>")
+                 | Catch::Clara::Opt(g_resume(), "journal")
+                    ["--resume"]
+                    ("skip the test cases found in <journal> and append the new results to it")
+                 | Catch::Clara::Opt(g_timings(), "file")
+                    ["--timings"]
+                    ("append the duration of each test case to <file>")
+                 | Catch::Clara::Opt(g_benchmark_cpus(), "list")
+                    ["--benchmark-cpus"]
+                    ("pin the process to these CPUs (i.e. \"2,4-7\")")
+                 | Catch::Clara::Opt(g_benchmark_lock_memory())
+                    ["--benchmark-lock-memory"]
+                    ("lock the memory of the process with mlockall()")
+                 | Catch::Clara::Opt(g_benchmark_stabilize(), "seconds")
+                    ["--benchmark-stabilize"]
+                    ("warm up the CPU until its speed is stable, for at most <seconds>")
+                 | Catch::Clara::Opt(g_benchmark_noise(), "percent")
+                    ["--benchmark-noise"]
+                    ("flag the benchmarks which standard deviation is above <percent> of the mean (default: 0, off)")
+                 | Catch::Clara::Opt(g_profile(), "file")
+                    ["--profile"]
+                    ("sample the test cases and save folded stacks (flame graph input) in <file>")
+                 | Catch::Clara::Opt(g_profile_frequency(), "hz")
+                    ["--profile-frequency"]
+                    ("number of profiler samples per second of CPU (default: 997)")
+                 | Catch::Clara::Opt(g_profile_filter(), "pattern")
+                    ["--profile-filter"]
+                    ("only profile the test cases matching this shell pattern")
+                 | Catch::Clara::Opt(g_save_latency())
+                    ["--save-latency"]
+                    ("save the percentile table of each latency measurement in latency-<name>.csv in the binary directory")
+                 | Catch::Clara::Opt(binlog_convert, "file")
+                    ["--binlog-convert"]
+                    ("convert a binary event log to a report and exit")
+                 | Catch::Clara::Opt(binlog_format, "console|junit|json")
+                    ["--binlog-format"]
+                    ("format used by --binlog-convert (default: console)")
+                 | Catch::Clara::Opt(g_verbose())
+                    ["--verbose"]
+                    ("print additional information from within our own tests")
+                 | Catch::Clara::Opt(version)
+                    ["-V"]["--version"]
+                    ("print out the libutf8 library version these unit tests pertain to");
+
+        if(add_user_options != nullptr)
+        {
+            add_user_options(cli);
+        }
+
+        session.cli(cli);
+
+        if(session.applyCommandLine(argc, argv) != 0)
+        {
+            std::cerr << "fatal error: invalid command line." << std::endl;
+            return 1;
+        }
+
+        if(version)
+        {
+            std::cout << project_version << std::endl;
+            return 0;
+        }
+
+        if(!binlog_convert.empty())
+        {
+            return detail::convert_binlog(binlog_convert, binlog_format, std::cout);
+        }
+
+        // also turn on verbosity if the VERBOSE environment variable
+        // is set to a value other than 0, false, off
+        //
+        char const * verbose(getenv("VERBOSE"));
+        if(verbose != nullptr)
+        {
+            if(strcmp(verbose, "0") != 0
+            && strcmp(verbose, "false") != 0
+            && strcmp(verbose, "off") != 0)
+            {
+                g_verbose() = true;
+            }
+        }
+        if(g_verbose())
+        {
+            std::cout << "info: verbosity activated." << std::endl;
+        }
+
+        detail::redirect_binlog_output(session);
+
+        // Catch2 runs the test cases of one process in its own order
+        //
+        if(g_failed_first()
+        && !g_isolate())
+        {
+            throw std::runtime_error("--failed-first requires --isolate.");
+        }
+
+        // the output of a reporter writing to stdout or stderr while a
+        // test case runs gets captured too which breaks a document
+        //
+        if(g_capture()
+        && !g_isolate())
+        {
+            for(auto const & spec : session.config().getProcessedReporterSpecs())
+            {
+                if((spec.outputFilename.empty()
+                    || spec.outputFilename == "-"
+                    || spec.outputFilename == "%stdout"
+                    || spec.outputFilename == "%stderr")
+                && spec.name != "console"
+                && spec.name != "compact")
+                {
+                    throw std::runtime_error(
+                              "--capture cannot be used with the \""
+                            + spec.name
+                            + "\" reporter writing to the console, use -o <file>.");
+                }
+            }
+        }
+
+        // the merged results of a resumed run are printed as text, a
+        // report file would only include the test cases run last
+        //
+        if(!g_resume().empty())
+        {
+            for(auto const & spec : session.config().getProcessedReporterSpecs())
+            {
+                if((spec.name != "console"
+                    && spec.name != "compact")
+                || !(spec.outputFilename.empty()
+                    || spec.outputFilename == "-"
+                    || spec.outputFilename == "%stdout"))
+                {
+                    throw std::runtime_error(
+                              "--resume only supports the console and compact reporters writing to stdout, not \""
+                            + spec.name
+                            + "\".");
+                }
+            }
+        }
+
+        detail::init_tmp_dir(project_name);
+
+        if(!g_profile().empty())
+        {
+            detail::profiler::instance().enable(g_profile(), g_profile_frequency(), g_profile_filter());
+        }
+
+        // a resumed run uses the seeds of the run it continues
+        //
+        detail::checkpoint_journal::entries_t completed;
+        if(!g_resume().empty())
+        {
+            if(!g_checkpoint().empty()
+            && g_checkpoint() != g_resume())
+            {
+                throw std::runtime_error("--checkpoint and --resume must name the same journal.");
+            }
+            g_checkpoint() = g_resume();
+
+            std::uint32_t rng_seed(0);
+            completed = detail::checkpoint_journal::load(g_resume(), seed, rng_seed);
+            Catch::ConfigData data(session.configData());
+            data.rngSeed = rng_seed;
+            session.useConfigData(data);
+        }
+        if(!g_checkpoint().empty())
+        {
+            detail::checkpoint_journal::instance().open(
+                      g_checkpoint()
+                    , !g_resume().empty()
+                    , seed
+                    , session.configData().rngSeed);
+        }
+
+        // by default we get a different seed each time; that really helps
+        // in detecting errors! At least it helped me many times.
+        //
+        g_seed() = seed;
+        srand(seed);
+        srand48(seed);
+
+        // save the seed, it can be practical opposed to searching your
+        // test output
+        //
+        {
+            std::ofstream seed_file;
+            seed_file.open("seed.txt");
+            if(seed_file.is_open())
+            {
+                seed_file << seed << std::endl;
+            }
+        }
+
+        if(callback != nullptr)
+        {
+            int const e(callback(session));
+            if(e != 0)
+            {
+                return e;
+            }
+        }
+
+        std::cout << project_name
+                  << " v"
+                  << project_version
+                  << " ["
+                  << getpid()
+                  << "]:unittest: seed is "
+                  << seed
+                  << "\n"
+                     "source directory: \""
+                  << g_source_dir()
+                  << "\"\n"
+                     "binary directory: \""
+                  << g_binary_dir()
+                  << "\"\n"
+                     "dist directory: \""
+                  << g_dist_dir()
+                  << "\"\n"
+                     "temporary directory: \""
+                  << g_tmp_dir()
+                  << "\""
+                  << std::endl;
+
+        detail::benchmark_environment::instance().setup();
+
+        Catch::ListenerRegistrar<detail::snapcatch2_listener> const listener("snapcatch2");
+
+        // the test cases to watch are the ones selected on the command
+        // line, before --skip-unchanged removes some of them
+        //
+        std::unique_ptr<detail::file_watcher> watcher;
+        if(g_watch())
+        {
+            watcher = std::make_unique<detail::file_watcher>(detail::selected_test_cases(session));
+        }
+        Catch::ConfigData const config_data(session.configData());
+
+        auto run_tests = [&session, project_name]()
+        {
+            std::unique_ptr<detail::result_cache> cache;
+            std::map<std::string, std::string> keys;
+            if(g_skip_unchanged())
+            {
+                cache = std::make_unique<detail::result_cache>(project_name);
+                if(detail::skip_unchanged_test_cases(session, *cache, keys) == 0)
+                {
+                    // still start and end a run so the reporters write
+                    // their report (i.e. `-r junit -o report.xml`)
+                    //
+                    detail::isolated_reporter(session.configData()).test_run_ended(Catch::Totals());
+                    return 0;
+                }
+            }
+
+            // the history is kept whenever we know where to save it
+            //
+            std::unique_ptr<detail::run_history> history;
+            if(g_failed_first()
+            || !g_binary_dir().empty())
+            {
+                history = std::make_unique<detail::run_history>(project_name);
+            }
+
+            // the list options (--list-tests, --list-tags...) do not run
+            // anything, Catch2 handles them directly
+            //
+            Catch::ConfigData const & data(session.configData());
+            bool const list(data.listTests
+                         || data.listTags
+                         || data.listReporters
+                         || data.listListeners);
+
+            int r(0);
+            if(g_isolate()
+            && !list)
+            {
+                // the children start their own watchdog as required
+                //
+                r = detail::run_isolated(session, g_failed_first() ? history.get() : nullptr);
+            }
+            else
+            {
+                std::unique_ptr<detail::watchdog> watchdog;
+                if(detail::need_watchdog())
+                {
+                    watchdog = std::make_unique<detail::watchdog>();
+                }
+
+                if(g_capture())
+                {
+                    detail::output_capture::instance().enable();
+                }
+
+                r = session.run();
+            }
+
+            if(cache != nullptr)
+            {
+                for(auto const & result : detail::run_state::instance().results())
+                {
+                    auto const it(keys.find(result.f_name));
+                    if(it != keys.end())
+                    {
+                        cache->set(result.f_name, it->second, result.f_passed);
+                    }
+                }
+                cache->save();
+            }
+
+            if(history != nullptr)
+            {
+                history->update(detail::run_state::instance().results());
+            }
+
+            if(!g_timings().empty())
+            {
+                detail::save_timings(g_timings(), detail::run_state::instance().results());
+            }
+
+            return r;
+        };
+
+        int r(0);
+        if(g_resume().empty()
+        || detail::skip_completed_test_cases(session, completed) > 0)
+        {
+            r = run_tests();
+        }
+        if(!g_resume().empty()
+        && !detail::report_checkpoint(g_resume())
+        && r == 0)
+        {
+            r = detail::TEST_FAILURE_EXIT_CODE;
+        }
+
+        while(watcher != nullptr)
+        {
+            std::cout << "watch: waiting for changes to "
+                      << watcher->size()
+                      << " input files or directories (Ctrl-C to stop)."
+                      << std::endl;
+
+            std::vector<std::string> tests;
+            if(!watcher->wait(tests))
+            {
+                std::cout << "watch: \""
+                          << watcher->executable()
+                          << "\" was rebuilt, restarting."
+                          << std::endl;
+                if(finished_callback != nullptr)
+                {
+                    finished_callback();
+                }
+                std::cerr.flush();
+                execv(watcher->executable().c_str(), argv);
+                throw std::runtime_error(
+                          "could not execute \""
+                        + watcher->executable()
+                        + "\" again: "
+                        + strerror(errno));
+            }
+
+            std::cout << "watch: running "
+                      << tests.size()
+                      << " test case"
+                      << (tests.size() == 1 ? "" : "s")
+                      << " again."
+                      << std::endl;
+            session.useConfigData(config_data);
+            detail::select_test_cases(session, tests);
+            detail::run_state::instance().clear_results();
+            r = run_tests();
+        }
+
+        if(finished_callback != nullptr)
+        {
+            finished_callback();
+        }
+
+        return r;
+    }
+    catch(std::logic_error const & e)
+    {
+        std::cerr << "fatal error: caught a logic error in "
+                  << project_name
+                  << " unit tests: "
+                  << e.what()
+                  << "\n";
+        return 1;
+    }
+    catch(std::runtime_error const & e)
+    {
+        std::cerr << "fatal error: caught a run-time error in "
+                  << project_name
+                  << " unit tests: "
+                  << e.what()
+                  << "\n";
+        return 1;
+    }
+    catch(std::exception const & e)
+    {
+        std::cerr << "fatal error: caught a standard exception in "
+                  << project_name
+                  << " unit tests: "
+                  << e.what()
+                  << "\n";
+        return 1;
+    }
+}
+#endif
+
+
+
+inline void catch_compare_long_strings(std::string const & a, std::string const & b)
+{
+    auto print_char = [](char c)
+    {
+        if(c == 0x20)
+        {
+            // Possible characters to make spaces visible are:
+            //      U+23B5      BOTTOM SQUARE BRACKET
+            //      U+2420      SYMBOL FOR SPACE
+            //      U+2423      OPEN BOX
+            //
+            std::cout << "\xE2\x90\xA3";
+        }
+        else if(static_cast<unsigned char>(c) < 0x20)
+        {
+            // control character
+            //
+            std::cout << '^' << static_cast<char>(c + 0x40);
+        }
+        else if(static_cast<unsigned char>(c) < 0x80)
+        {
+            // standard character
+            //
+            std::cout << c;
+        }
+        else if(static_cast<unsigned char>(c) < 0xA0)
+        {
+            // graphical control
+            //
+            std::cout << '@' << static_cast<char>(c - 0x40);
+        }
+        else
+        {
+            // UTF-8 characters cannot be written as is since we are breaking
+            // up the string into bytes instead of characters; so instead show
+            // the corresponding \xXX value
+            //
+            std::cout << "\\x" << std::hex << static_cast<int>(static_cast<std::uint8_t>(c));
+        }
+    };
+
+    if(a != b)
+    {
+        std::cout << "error: long strings do not match.\n"
+                  << "---------------------------------------------------\n";
+
+        // TODO: we may want to look into supporting UTF-8 properly
+        //
+        std::size_t const max(std::min(a.length(), b.length()));
+        bool err(false);
+        for(std::size_t idx(0); idx < max; ++idx)
+        {
+            if(a[idx] == b[idx])
+            {
+                if(err)
+                {
+                    err = false;
+                    std::cout << "\033[0m";
+                }
+                std::cout << a[idx];
+            }
+            else
+            {
+                if(!err)
+                {
+                    err = true;
+                    std::cout << "\033[7m";
+                }
+                std::cout << '[';
+                print_char(a[idx]);
+                std::cout << '/';
+                print_char(b[idx]);
+                std::cout << ']';
+            }
+        }
+        if(err)
+        {
+            err = false;
+            std::cout << "\033[0m";
+        }
+
+        std::cout << std::endl
+                  << "---------------------------------------------------" << std::endl;
+
+        if(a.length() > b.length())
+        {
+            std::cout << "Left hand side string is longer ("
+                      << a.length()
+                      << " versus "
+                      << b.length()
+                      << ")."
+                      << std::endl;
+        }
+        else if(b.length() > a.length())
+        {
+            std::cout << "Right hand side string is longer ("
+                      << a.length()
+                      << " versus "
+                      << b.length()
+                      << ")."
+                      << std::endl;
+        }
+    }
+
+    // to generate the standard error too
+    //
+    CATCH_REQUIRE(a == b);
+}
+
+
+namespace detail
+{
+
+/** \brief Render a short diff of two messages.
+ *
+ * This function is used by the exception message matchers to show where
+ * the expected and actual messages differ. Contrary to the
+ * catch_compare_long_strings() function, it does not print anything. It
+ * instead returns a few lines which include a small window around the
+ * first difference and a caret pointing at that difference.
+ *
+ * The function is only expected to be called on failures so it does not
+ * attempt to avoid allocations.
+ *
+ * \param[in] expected  The expected message.
+ * \param[in] actual  The actual message.
+ *
+ * \return A string with the rendered diff.
+ */
+inline std::string render_message_diff(std::string_view expected, std::string_view actual)
+{
+    constexpr std::size_t const CONTEXT_SIZE = 20;
+
+    std::size_t const max(std::min(expected.length(), actual.length()));
+    std::size_t pos(0);
+    while(pos < max && expected[pos] == actual[pos])
+    {
+        ++pos;
+    }
+
+    std::size_t const start(pos > CONTEXT_SIZE ? pos - CONTEXT_SIZE : 0);
+    auto window = [start](std::string_view s)
+    {
+        std::string result(start > 0 ? "..." : "");
+        if(start < s.length())
+        {
+            result += s.substr(start, CONTEXT_SIZE * 2);
+            if(start + CONTEXT_SIZE * 2 < s.length())
+            {
+                result += "...";
+            }
+        }
+        return result;
+    };
+
+    std::string result("first difference at offset ");
+    result += std::to_string(pos);
+    result += ":\n  expected: ";
+    result += window(expected);
+    result += "\n  actual:   ";
+    result += window(actual);
+    result += "\n            ";
+    result += std::string(pos - start + (start > 0 ? 3 : 0), ' ');
+    result += '^';
+
+    return result;
+}
+
+} // detail namespace
+
+
+inline void catch_compare_large_buffers(void const * a, std::size_t a_size, void const * b, std::size_t b_size)
+{
+    if(a_size == b_size
+    && memcmp(a, b, a_size) == 0)
+    {
+        return;
+    }
+
+    std::cout << "error: large buffers do not match.\n"
+              << "---------------------------------------------------\n";
+
+    std::uint8_t const * a_ptr(reinterpret_cast<std::uint8_t const *>(a));
+    std::uint8_t const * b_ptr(reinterpret_cast<std::uint8_t const *>(b));
+    std::size_t const max(std::min(a_size, b_size));
+
+    // skip start as long as equal
+    //
+    std::size_t idx(0);
+    for(; idx < max; ++idx)
+    {
+        if(a_ptr[idx] != b_ptr[idx])
+        {
+            break;
+        }
+    }
+    if(idx > 10)
+    {
+        // adjust pointer to include some equal data and then a multiple of 16
+        //
+        idx -= 10;
+        idx &= -16;
+    }
+    else
+    {
+        idx = 0;
+    }
+
+    // limit the output to 4 lines of data
+    //
+    std::size_t const limit(std::min(idx + 64, max));
+
+    bool err(false);
+    bool first(true);
+    std::cout << std::hex << std::setfill('0');
+    for(; idx < limit; ++idx)
+    {
+        if((idx & 15) == 0)
+        {
+            if(first)
+            {
+                first = false;
+            }
+            else
+            {
+                std::cout << '\n';
+            }
+            std::cout << "\033[0m" << std::setw(8) << idx << "- ";
+            err = false;
+        }
+        if(a_ptr[idx] == b_ptr[idx])
+        {
+            if(err)
+            {
+                err = false;
+                std::cout << "\033[0m";
+            }
+            std::cout << std::setw(2) << a_ptr[idx] << ' ';
+        }
+        else
+        {
+            if(!err)
+            {
+                err = true;
+                std::cout << "\033[7m";
+            }
+            std::cout << '[';
+            std::cout << std::setw(2) << a_ptr[idx];
+            std::cout << '/';
+            std::cout << std::setw(2) << b_ptr[idx];
+            std::cout << "] ";
+        }
+    }
+    if(err)
+    {
+        err = false;
+        std::cout << "\033[0m";
+    }
+
+    std::cout << (limit != max ? "..." : "") << '\n'
+              << "---------------------------------------------------" << std::endl;
+
+    if(a_size > b_size)
+    {
+        std::cout << "Left hand side buffer is longer ("
+                  << a_size
+                  << " versus "
+                  << b_size
+                  << ")."
+                  << std::endl;
+    }
+    else if(b_size > a_size)
+    {
+        std::cout << "Right hand side buffer is longer ("
+                  << a_size
+                  << " versus "
+                  << b_size
+                  << ")."
+                  << std::endl;
+    }
+
+    // to generate the standard error too
+    //
+    CATCH_REQUIRE(!"large buffers a and b differ");
+}
+
+
+template<typename F>
+F default_epsilon()
+{
+    return static_cast<F>(0.00001);
+}
+
+
+template<typename F>
+bool nearly_equal(
+      F const lhs
+    , F const rhs
+    , F epsilon = default_epsilon<F>())
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+    // already equal?
+    if(lhs == rhs)
+    {
+        return true;
+    }
+
+    F const diff(std::abs(lhs - rhs));
+    if(lhs == 0.0
+    || rhs == 0.0
+    || diff < std::numeric_limits<F>::min())
+    {
+        return diff < (epsilon * std::numeric_limits<F>::min());
+    }
+#pragma GCC diagnostic pop
+
+    return diff / (std::abs(lhs) + std::abs(rhs)) < epsilon;
+}
+
+
+namespace detail
+{
+
+
+/** \brief Run a function over a range of indices using several threads.
+ *
+ * The range `[0, size)` is cut in one chunk per hardware thread and
+ * \p f is called with the `begin` and `end` of each chunk. Small ranges
+ * (less than \p grain items per thread) are processed by the calling
+ * thread only.
+ *
+ * If \p f throws, the first exception is re-thrown once all the threads
+ * are done.
+ *
+ * \param[in] size  The number of items to process.
+ * \param[in] f  The function called with each chunk.
+ * \param[in] grain  The minimum number of items handled by one thread.
+ */
+template<typename F>
+void parallel_for(std::size_t size, F const & f, std::size_t grain = 64 * 1024)
+{
+    std::size_t const count(std::min<std::size_t>(
+              std::max(std::thread::hardware_concurrency(), 1U)
+            , size / std::max<std::size_t>(grain, 1)));
+    if(count <= 1)
+    {
+        f(static_cast<std::size_t>(0), size);
+        return;
+    }
+
+    std::size_t const chunk((size + count - 1) / count);
+    std::mutex lock;
+    std::exception_ptr error;
+    auto run = [&f, &lock, &error, chunk, size](std::size_t idx)
+    {
+        try
+        {
+            f(idx * chunk, std::min(size, (idx + 1) * chunk));
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if(error == nullptr)
+            {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(count - 1);
+    for(std::size_t idx(1); idx < count; ++idx)
+    {
+        threads.emplace_back(run, idx);
+    }
+    run(0);
+    for(auto & t : threads)
+    {
+        t.join();
+    }
+    if(error != nullptr)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+
+/** \brief The maximum number of failing elements shown by range assertions.
+ */
+constexpr std::size_t const RANGE_REPORTED_FAILURES = 5;
+
+
+/** \brief The failures found while scanning a range.
+ *
+ * Only the indices of the first few failures are kept. The failures are
+ * only rendered to a string once the scan is complete.
+ */
+struct range_failures
+{
+    void add(std::size_t idx)
+    {
+        ++f_failed;
+        if(f_indices.size() < RANGE_REPORTED_FAILURES)
+        {
+            f_indices.push_back(idx);
+        }
+    }
+
+    std::size_t                 f_failed = 0;
+    std::vector<std::size_t>    f_indices = std::vector<std::size_t>();
+};
+
+
+/** \brief Scan a range by chunks, possibly in parallel.
+ *
+ * When \p parallel is true, the \p check function gets called from
+ * several threads at once with separate chunks.
+ *
+ * \param[in] size  The number of elements in the range.
+ * \param[in] parallel  Whether the range can be scanned in parallel.
+ * \param[in] check  The function checking the elements of one chunk.
+ *
+ * \return The failures found in the entire range.
+ */
+template<typename Check>
+range_failures scan_range(std::size_t size, bool parallel, Check const & check)
+{
+    range_failures result;
+    if(!parallel)
+    {
+        check(static_cast<std::size_t>(0), size, result);
+        return result;
+    }
+
+    std::mutex lock;
+    parallel_for(size, [&check, &lock, &result](std::size_t begin, std::size_t end)
+    {
+        range_failures local;
+        check(begin, end, local);
+        if(local.f_failed != 0)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            result.f_failed += local.f_failed;
+            result.f_indices.insert(result.f_indices.end(), local.f_indices.begin(), local.f_indices.end());
+        }
+    });
+
+    // each chunk kept its first failures so the first ones overall are here
+    //
+    std::sort(result.f_indices.begin(), result.f_indices.end());
+    if(result.f_indices.size() > RANGE_REPORTED_FAILURES)
+    {
+        result.f_indices.resize(RANGE_REPORTED_FAILURES);
+    }
+    return result;
+}
+
+
+template<typename Range>
+constexpr bool is_random_access_range()
+{
+    return std::is_base_of<
+              std::random_access_iterator_tag
+            , typename std::iterator_traits<decltype(std::begin(std::declval<Range const &>()))>::iterator_category>::value;
+}
+
+
+template<typename Range>
+decltype(auto) range_element(Range const & range, std::size_t idx)
+{
+    return *std::next(std::begin(range), static_cast<std::ptrdiff_t>(idx));
+}
+
+
+/** \brief The expression of a range assertion.
+ *
+ * The range assertions count as a single Catch2 assertion. The text
+ * describing the failing elements is only generated when the assertion
+ * fails.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
+class range_expression final
+    : public Catch::ITransientExpression
+{
+public:
+    range_expression(std::size_t size, std::size_t failed, std::string && details)
+        : ITransientExpression(false, failed == 0 && details.empty())
+        , m_size(size)
+        , m_failed(failed)
+        , m_details(std::move(details))
+    {
+    }
+
+    void streamReconstructedExpression(std::ostream & os) const override
+    {
+        if(getResult())
+        {
+            os << "all " << m_size << " elements passed";
+            return;
+        }
+        os << m_failed << " of " << m_size << " elements failed" << m_details;
+    }
+
+private:
+    std::size_t         m_size = 0;
+    std::size_t         m_failed = 0;
+    std::string         m_details = std::string();
+};
+#pragma GCC diagnostic pop
+
+
+/** \brief Check all the elements of a range against a predicate.
+ *
+ * This is the implementation of CATCH_REQUIRE_ALL(). Ranges with random
+ * access iterators are checked in parallel so the \p predicate must be
+ * safe to call from multiple threads.
+ *
+ * \param[in] range  The range to check.
+ * \param[in] predicate  The predicate returning true for valid elements.
+ *
+ * \return The expression to pass to the Catch2 assertion handler.
+ */
+template<typename Range, typename Predicate>
+range_expression require_all(Range const & range, Predicate const & predicate)
+{
+    std::size_t const size(static_cast<std::size_t>(std::distance(std::begin(range), std::end(range))));
+    range_failures const failures(scan_range(
+              size
+            , is_random_access_range<Range>()
+            , [&range, &predicate](std::size_t begin, std::size_t end, range_failures & result)
+            {
+                auto it(std::next(std::begin(range), static_cast<std::ptrdiff_t>(begin)));
+                for(; begin < end; ++begin, ++it)
+                {
+                    if(!predicate(*it))
+                    {
+                        result.add(begin);
+                    }
+                }
+            }));
+
+    std::string details;
+    for(auto const idx : failures.f_indices)
+    {
+        details += "\n  [" + std::to_string(idx) + "] " + Catch::Detail::stringify(range_element(range, idx));
+    }
+    return range_expression(size, failures.f_failed, std::move(details));
+}
+
+
+/** \brief Compare two ranges element by element.
+ *
+ * This is the implementation of CATCH_REQUIRE_RANGE_EQUAL(). When both
+ * ranges have random access iterators, they are compared in parallel.
+ *
+ * \param[in] lhs  The range being checked.
+ * \param[in] rhs  The expected range.
+ *
+ * \return The expression to pass to the Catch2 assertion handler.
+ */
+template<typename LhsRange, typename RhsRange>
+range_expression require_range_equal(LhsRange const & lhs, RhsRange const & rhs)
+{
+    std::size_t const lhs_size(static_cast<std::size_t>(std::distance(std::begin(lhs), std::end(lhs))));
+    std::size_t const rhs_size(static_cast<std::size_t>(std::distance(std::begin(rhs), std::end(rhs))));
+    std::size_t const size(std::min(lhs_size, rhs_size));
+    range_failures const failures(scan_range(
+              size
+            , is_random_access_range<LhsRange>() && is_random_access_range<RhsRange>()
+            , [&lhs, &rhs](std::size_t begin, std::size_t end, range_failures & result)
+            {
+                auto l(std::next(std::begin(lhs), static_cast<std::ptrdiff_t>(begin)));
+                auto r(std::next(std::begin(rhs), static_cast<std::ptrdiff_t>(begin)));
+                for(; begin < end; ++begin, ++l, ++r)
+                {
+                    if(!(*l == *r))
+                    {
+                        result.add(begin);
+                    }
+                }
+            }));
+
+    std::string details;
+    if(lhs_size != rhs_size)
+    {
+        details += "\n  sizes differ: "
+                 + std::to_string(lhs_size)
+                 + " != "
+                 + std::to_string(rhs_size);
+    }
+    for(auto const idx : failures.f_indices)
+    {
+        details += "\n  ["
+                 + std::to_string(idx)
+                 + "] "
+                 + Catch::Detail::stringify(range_element(lhs, idx))
+                 + " != "
+                 + Catch::Detail::stringify(range_element(rhs, idx));
+    }
+    return range_expression(size, failures.f_failed, std::move(details));
+}
+
+
+/** \brief The maximum edit distance searched by CATCH_REQUIRE_CONTAINERS_EQUAL().
+ *
+ * The diff costs O((N + M) * D) where D is the number of inserted and
+ * removed elements. Past this distance, the differences are reported
+ * by position only.
+ */
+constexpr std::ptrdiff_t const CONTAINER_MAX_EDIT_DISTANCE = 256;
+
+
+template<typename T, typename = void>
+struct is_associative_container
+    : std::false_type
+{
+};
+
+
+template<typename T>
+struct is_associative_container<T, std::void_t<typename T::key_type>>
+    : std::true_type
+{
+};
+
+
+template<typename T, typename = void>
+struct is_map_container
+    : std::false_type
+{
+};
+
+
+template<typename T>
+struct is_map_container<T, std::void_t<typename T::mapped_type>>
+    : std::true_type
+{
+};
+
+
+template<typename T, typename = void>
+struct is_ordered_container
+    : std::false_type
+{
+};
+
+
+template<typename T>
+struct is_ordered_container<T, std::void_t<typename T::key_compare>>
+    : std::true_type
+{
+};
+
+
+/** \brief The differences found between two containers.
+ *
+ * Only the first few differences are described; the elements are only
+ * converted to strings for those.
+ */
+class container_differences
+{
+public:
+    template<typename Describe>
+    void changed(std::string const & position, Describe const & describe)
+    {
+        ++m_changed;
+        if(m_lines.size() < RANGE_REPORTED_FAILURES)
+        {
+            add(position + " changed: " + describe());
+        }
+    }
+
+    template<typename Describe>
+    void inserted(std::string const & position, Describe const & describe)
+    {
+        ++m_inserted;
+        if(m_lines.size() < RANGE_REPORTED_FAILURES)
+        {
+            add(position + " inserted: " + describe());
+        }
+    }
+
+    template<typename Describe>
+    void removed(std::string const & position, Describe const & describe)
+    {
+        ++m_removed;
+        if(m_lines.size() < RANGE_REPORTED_FAILURES)
+        {
+            add(position + " removed: " + describe());
+        }
+    }
+
+    /** \brief Count differences which are not described.
+     */
+    void more(std::size_t changed, std::size_t inserted, std::size_t removed)
+    {
+        m_changed += changed;
+        m_inserted += inserted;
+        m_removed += removed;
+    }
+
+    bool full() const
+    {
+        return m_lines.size() >= RANGE_REPORTED_FAILURES;
+    }
+
+    std::size_t count() const
+    {
+        return m_changed + m_inserted + m_removed;
+    }
+
+    std::string details(std::size_t lhs_size, std::size_t rhs_size) const
+    {
+        if(count() == 0)
+        {
+            return std::string();
+        }
+
+        std::string result;
+        if(lhs_size != rhs_size)
+        {
+            result += "\n  sizes differ: "
+                    + std::to_string(lhs_size)
+                    + " != "
+                    + std::to_string(rhs_size);
+        }
+        result += "\n  "
+                + std::to_string(m_changed)
+                + " changed, "
+                + std::to_string(m_inserted)
+                + " inserted, "
+                + std::to_string(m_removed)
+                + " removed";
+        for(auto const & l : m_lines)
+        {
+            result += "\n  " + l;
+        }
+        if(count() > m_lines.size())
+        {
+            result += "\n  ... and "
+                    + std::to_string(count() - m_lines.size())
+                    + " more";
+        }
+        return result;
+    }
+
+private:
+    void add(std::string const & line)
+    {
+        if(m_lines.size() < RANGE_REPORTED_FAILURES)
+        {
+            m_lines.push_back(line);
+        }
+    }
+
+    std::size_t                 m_changed = 0;
+    std::size_t                 m_inserted = 0;
+    std::size_t                 m_removed = 0;
+    std::vector<std::string>    m_lines = std::vector<std::string>();
+};
+
+
+/** \brief Compute the shortest edit script between two sequences.
+ *
+ * This is the Myers O((N + M) * D) algorithm. It stops once the edit
+ * distance goes over \p max_distance.
+ *
+ * \param[in] lhs  The elements of the first sequence (a sequence_window).
+ * \param[in] rhs  The elements of the second sequence (a sequence_window).
+ * \param[in] max_distance  The maximum edit distance to search.
+ * \param[out] script  The edits: '=' (same), '+' (only in \p lhs) or
+ * '-' (only in \p rhs).
+ *
+ * \return true if the edit distance is at most \p max_distance.
+ */
+template<typename Lhs, typename Rhs>
+bool shortest_edit_script(
+      Lhs const & lhs
+    , Rhs const & rhs
+    , std::ptrdiff_t max_distance
+    , std::string & script)
+{
+    std::ptrdiff_t const n(static_cast<std::ptrdiff_t>(lhs.size()));
+    std::ptrdiff_t const m(static_cast<std::ptrdiff_t>(rhs.size()));
+    std::ptrdiff_t const max(std::min(max_distance, n + m));
+    std::ptrdiff_t const offset(max + 1);
+    std::vector<std::ptrdiff_t> v(2 * offset + 1, 0);
+    std::vector<std::vector<std::ptrdiff_t>> trace;
+
+    std::ptrdiff_t distance(-1);
+    for(std::ptrdiff_t d(0); d <= max && distance < 0; ++d)
+    {
+        trace.push_back(v);
+        for(std::ptrdiff_t k(-d); k <= d; k += 2)
+        {
+            std::ptrdiff_t x(k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])
+                        ? v[offset + k + 1]
+                        : v[offset + k - 1] + 1);
+            std::ptrdiff_t y(x - k);
+            while(x < n
+               && y < m
+               && lhs[static_cast<std::size_t>(x)] == rhs[static_cast<std::size_t>(y)])
+            {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if(x >= n && y >= m)
+            {
+                distance = d;
+                break;
+            }
+        }
+    }
+    if(distance < 0)
+    {
+        return false;
+    }
+
+    // walk back from the end to find the path
+    //
+    script.clear();
+    std::ptrdiff_t x(n);
+    std::ptrdiff_t y(m);
+    for(std::ptrdiff_t d(distance); d > 0; --d)
+    {
+        std::vector<std::ptrdiff_t> const & pv(trace[d]);
+        std::ptrdiff_t const k(x - y);
+        std::ptrdiff_t const prev_k(k == -d || (k != d && pv[offset + k - 1] < pv[offset + k + 1])
+                        ? k + 1
+                        : k - 1);
+        std::ptrdiff_t const prev_x(pv[offset + prev_k]);
+        std::ptrdiff_t const prev_y(prev_x - prev_k);
+        while(x > prev_x && y > prev_y)
+        {
+            script += '=';
+            --x;
+            --y;
+        }
+        script += x == prev_x ? '-' : '+';
+        x = prev_x;
+        y = prev_y;
+    }
+    script.append(static_cast<std::size_t>(x), '=');
+    std::reverse(script.begin(), script.end());
+    return true;
+}
+
+
+/** \brief Access the elements of a part of a sequence by index.
+ *
+ * The diff of require_sequences_equal() reads the elements between the
+ * common prefix and suffix many times. With random access iterators the
+ * elements are read in place. Otherwise the iterators of that part only
+ * are saved so accessing an element does not walk the sequence again.
+ *
+ * The elements are returned as the iterators return them so containers
+ * with proxy iterators such as `std::vector<bool>` work too.
+ */
+template<typename Range>
+class sequence_window
+{
+public:
+    typedef decltype(std::begin(std::declval<Range const &>()))     iterator_t;
+
+    sequence_window(Range const & range, std::size_t begin, std::size_t end)
+        : m_begin(std::next(std::begin(range), static_cast<std::ptrdiff_t>(begin)))
+        , m_size(end - begin)
+    {
+        if constexpr (!is_random_access_range<Range>())
+        {
+            m_iterators.reserve(m_size);
+            iterator_t it(m_begin);
+            for(std::size_t idx(0); idx < m_size; ++idx, ++it)
+            {
+                m_iterators.push_back(it);
+            }
+        }
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    decltype(auto) operator [] (std::size_t idx) const
+    {
+        if constexpr (is_random_access_range<Range>())
+        {
+            return *std::next(m_begin, static_cast<std::ptrdiff_t>(idx));
+        }
+        else
+        {
+            return *m_iterators[idx];
+        }
+    }
+
+private:
+    iterator_t                  m_begin;
+    std::size_t                 m_size = 0;
+    std::vector<iterator_t>     m_iterators = std::vector<iterator_t>();
+};
+
+
+/** \brief Compare two sequences and describe their differences.
+ *
+ * The common prefix is found by comparing chunks of both sequences in
+ * parallel (when they have random access iterators), then the common
+ * suffix is found in one pass over the rest of the sequences. Only the
+ * elements in between are diffed to find the
+ * changed, inserted and removed elements. If the edit distance is too
+ * large, the elements are compared by position instead.
+ */
+template<typename LhsRange, typename RhsRange>
+range_expression require_sequences_equal(LhsRange const & lhs, RhsRange const & rhs)
+{
+    std::size_t const lhs_size(static_cast<std::size_t>(std::distance(std::begin(lhs), std::end(lhs))));
+    std::size_t const rhs_size(static_cast<std::size_t>(std::distance(std::begin(rhs), std::end(rhs))));
+    std::size_t const size(std::min(lhs_size, rhs_size));
+    range_failures const positional(scan_range(
+              size
+            , is_random_access_range<LhsRange>() && is_random_access_range<RhsRange>()
+            , [&lhs, &rhs](std::size_t begin, std::size_t end, range_failures & result)
+            {
+                auto l(std::next(std::begin(lhs), static_cast<std::ptrdiff_t>(begin)));
+                auto r(std::next(std::begin(rhs), static_cast<std::ptrdiff_t>(begin)));
+                for(; begin < end; ++begin, ++l, ++r)
+                {
+                    if(!(*l == *r))
+                    {
+                        result.add(begin);
+                    }
+                }
+            }));
+
+    container_differences differences;
+    auto element = [](auto const & value)
+    {
+        return [&value]()
+        {
+            return Catch::Detail::stringify(value);
+        };
+    };
+    auto position = [](std::size_t idx)
+    {
+        return "[" + std::to_string(idx) + "]";
+    };
+
+    if(positional.f_failed == 0 && lhs_size == rhs_size)
+    {
+        return range_expression(lhs_size, 0, std::string());
+    }
+
+    // skip the common prefix and suffix
+    //
+    std::size_t const prefix(positional.f_failed == 0 ? size : positional.f_indices[0]);
+    std::size_t suffix(0);
+    {
+        // align the ends of both sequences and count the equal elements
+        // found after the last difference; this only needs forward
+        // iterators
+        //
+        std::size_t const lhs_rest(lhs_size - prefix);
+        std::size_t const rhs_rest(rhs_size - prefix);
+        std::size_t const tail(std::min(lhs_rest, rhs_rest));
+        auto lit(std::next(std::begin(lhs), static_cast<std::ptrdiff_t>(lhs_size - tail)));
+        auto rit(std::next(std::begin(rhs), static_cast<std::ptrdiff_t>(rhs_size - tail)));
+        for(std::size_t idx(0); idx < tail; ++idx, ++lit, ++rit)
+        {
+            if(*lit == *rit)
+            {
+                ++suffix;
+            }
+            else
+            {
+                suffix = 0;
+            }
+        }
+
+        sequence_window<LhsRange> const l(lhs, prefix, lhs_size - suffix);
+        sequence_window<RhsRange> const r(rhs, prefix, rhs_size - suffix);
+
+        // with the same size, changed elements cost 2 edits each so the
+        // diff is only useful if it finds less edits than that
+        //
+        std::ptrdiff_t max_distance(CONTAINER_MAX_EDIT_DISTANCE);
+        if(lhs_size == rhs_size)
+        {
+            max_distance = std::min(
+                      max_distance
+                    , static_cast<std::ptrdiff_t>(positional.f_failed * 2 - 1));
+        }
+        std::string script;
+        if(shortest_edit_script(l, r, max_distance, script))
+        {
+            std::size_t li(0);
+            std::size_t ri(0);
+            for(std::size_t idx(0); idx < script.length(); )
+            {
+                if(script[idx] == '=')
+                {
+                    ++li;
+                    ++ri;
+                    ++idx;
+                    continue;
+                }
+
+                // pair the inserted and removed elements of one block
+                // as changed elements
+                //
+                std::size_t inserted(0);
+                std::size_t removed(0);
+                for(; idx < script.length() && script[idx] != '='; ++idx)
+                {
+                    if(script[idx] == '+')
+                    {
+                        ++inserted;
+                    }
+                    else
+                    {
+                        ++removed;
+                    }
+                }
+                std::size_t const changed(std::min(inserted, removed));
+                for(std::size_t c(0); c < changed; ++c, ++li, ++ri)
+                {
+                    differences.changed(position(prefix + li), [&l, &r, li, ri]()
+                        {
+                            return Catch::Detail::stringify(l[li])
+                                 + " != "
+                                 + Catch::Detail::stringify(r[ri]);
+                        });
+                }
+                for(std::size_t c(changed); c < inserted; ++c, ++li)
+                {
+                    differences.inserted(position(prefix + li), element(l[li]));
+                }
+                for(std::size_t c(changed); c < removed; ++c, ++ri)
+                {
+                    differences.removed(position(prefix + li), element(r[ri]));
+                }
+            }
+            return range_expression(
+                      std::max(lhs_size, rhs_size)
+                    , differences.count()
+                    , differences.details(lhs_size, rhs_size));
+        }
+    }
+
+    // too many differences for a diff, compare by position
+    //
+    for(auto const idx : positional.f_indices)
+    {
+        differences.changed(position(idx), [&lhs, &rhs, idx]()
+            {
+                return Catch::Detail::stringify(range_element(lhs, idx))
+                     + " != "
+                     + Catch::Detail::stringify(range_element(rhs, idx));
+            });
+    }
+    differences.more(
+              positional.f_failed - positional.f_indices.size()
+            , lhs_size > rhs_size ? lhs_size - size : 0
+            , rhs_size > lhs_size ? rhs_size - size : 0);
+    return range_expression(
+              std::max(lhs_size, rhs_size)
+            , differences.count()
+            , differences.details(lhs_size, rhs_size));
+}
+
+
+/** \brief Compare two associative containers and describe their differences.
+ *
+ * Ordered containers are walked in parallel in key order. Unordered
+ * containers are compared by looking up each key in the other container.
+ */
+template<typename Container>
+range_expression require_associative_equal(Container const & lhs, Container const & rhs)
+{
+    container_differences differences;
+
+    auto key_of = [](auto const & value) -> auto const &
+    {
+        if constexpr (is_map_container<Container>::value)
+        {
+            return value.first;
+        }
+        else
+        {
+            return value;
+        }
+    };
+    auto position = [](auto const & key)
+    {
+        return "[" + Catch::Detail::stringify(key) + "]";
+    };
+    auto describe = [](auto const & value)
+    {
+        return [&value]()
+        {
+            if constexpr (is_map_container<Container>::value)
+            {
+                return Catch::Detail::stringify(value.second);
+            }
+            else
+            {
+                return Catch::Detail::stringify(value);
+            }
+        };
+    };
+    auto compare = [&](auto const & l, auto const & r)
+    {
+        if constexpr (is_map_container<Container>::value)
+        {
+            if(!(l.second == r.second))
+            {
+                differences.changed(
+                          differences.full() ? std::string() : position(l.first)
+                        , [&l, &r]()
+                        {
+                            return Catch::Detail::stringify(l.second)
+                                 + " != "
+                                 + Catch::Detail::stringify(r.second);
+                        });
+            }
+        }
+        else
+        {
+            static_cast<void>(l);
+            static_cast<void>(r);
+        }
+    };
+
+    if constexpr (is_ordered_container<Container>::value)
+    {
+        auto const less(lhs.key_comp());
+        auto l(lhs.begin());
+        auto r(rhs.begin());
+        while(l != lhs.end() || r != rhs.end())
+        {
+            if(r == rhs.end()
+            || (l != lhs.end() && less(key_of(*l), key_of(*r))))
+            {
+                differences.inserted(differences.full() ? std::string() : position(key_of(*l)), describe(*l));
+                ++l;
+            }
+            else if(l == lhs.end()
+                 || less(key_of(*r), key_of(*l)))
+            {
+                differences.removed(differences.full() ? std::string() : position(key_of(*r)), describe(*r));
+                ++r;
+            }
+            else
+            {
+                compare(*l, *r);
+                ++l;
+                ++r;
+            }
+        }
+    }
+    else
+    {
+        for(auto const & l : lhs)
+        {
+            auto const it(rhs.find(key_of(l)));
+            if(it == rhs.end())
+            {
+                differences.inserted(differences.full() ? std::string() : position(key_of(l)), describe(l));
+            }
+            else
+            {
+                compare(l, *it);
+            }
+        }
+        for(auto const & r : rhs)
+        {
+            if(lhs.find(key_of(r)) == lhs.end())
+            {
+                differences.removed(differences.full() ? std::string() : position(key_of(r)), describe(r));
+            }
+        }
+    }
+
+    return range_expression(
+              std::max(lhs.size(), rhs.size())
+            , differences.count()
+            , differences.details(lhs.size(), rhs.size()));
+}
+
+
+/** \brief Compare two large containers.
+ *
+ * This is the implementation of CATCH_REQUIRE_CONTAINERS_EQUAL().
+ *
+ * \param[in] lhs  The container being checked.
+ * \param[in] rhs  The expected container.
+ *
+ * \return The expression to pass to the Catch2 assertion handler.
+ */
+template<typename LhsContainer, typename RhsContainer>
+range_expression require_containers_equal(LhsContainer const & lhs, RhsContainer const & rhs)
+{
+    if constexpr (is_associative_container<LhsContainer>::value
+               && std::is_same_v<LhsContainer, RhsContainer>)
+    {
+        return require_associative_equal(lhs, rhs);
+    }
+    else
+    {
+        return require_sequences_equal(lhs, rhs);
+    }
+}
+
+
+/** \brief The expression of the CATCH_REQUIRE_VALID_UTF8() macro.
+ *
+ * On failure, the bytes found around the first invalid byte are shown
+ * in hexadecimal.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
+class utf8_expression final
+    : public Catch::ITransientExpression
+{
+public:
+    utf8_expression(std::string_view s)
+        : ITransientExpression(false, find_invalid_utf8(s) == std::string_view::npos)
+        , m_string(s)
+    {
+    }
+
+    void streamReconstructedExpression(std::ostream & os) const override
+    {
+        if(getResult())
+        {
+            os << "valid UTF-8 string of " << m_string.length() << " bytes";
+            return;
+        }
+
+        std::size_t const pos(find_invalid_utf8(m_string));
+        std::size_t const start(pos < 8 ? 0 : pos - 8);
+        std::size_t const end(std::min(m_string.length(), pos + 8));
+        os << "invalid UTF-8 at offset " << pos << ":";
+        for(std::size_t idx(start); idx < end; ++idx)
+        {
+            os << (idx == pos ? " [" : " ")
+               << std::hex << std::setfill('0') << std::setw(2)
+               << static_cast<int>(static_cast<unsigned char>(m_string[idx]))
+               << std::dec
+               << (idx == pos ? "]" : "");
+        }
+    }
+
+private:
+    std::string_view        m_string = std::string_view();
+};
+#pragma GCC diagnostic pop
+
+
+} // detail namespace
+
+
+/** \brief The state passed to the body of a stress test.
+ *
+ * Each thread gets its own context. The seed is derived from the
+ * `--seed` value and the thread number so a run can be reproduced.
+ */
+struct stress_context
+{
+    /** \brief Record a failure.
+     *
+     * The body of a stress test may use the CHECK family of assertions
+     * but each one takes the Catch2 lock. This function only saves the
+     * failure in this thread's context so it does not slow down the
+     * threads. Throwing an exception also reports a failure.
+     *
+     * \param[in] message  A message describing the failure.
+     */
+    void fail(std::string const & message)
+    {
+        ++f_failures;
+        if(f_first_failure.empty())
+        {
+            f_first_failure = message;
+        }
+    }
+
+    std::size_t             f_thread = 0;
+    std::uint64_t           f_iteration = 0;
+    std::uint64_t           f_seed = 0;
+    std::mt19937_64         f_random = std::mt19937_64();
+    std::uint64_t           f_failures = 0;
+    std::string             f_first_failure = std::string();
+};
+
+
+/** \brief The results of a stress test.
+ */
+struct stress_result
+{
+    struct thread_t
+    {
+        int                 f_cpu = -1;
+        std::uint64_t       f_operations = 0;
+        double              f_seconds = 0.0;
+        double              f_rate = 0.0;
+        std::uint64_t       f_failures = 0;
+        std::string         f_first_failure = std::string();
+    };
+
+    std::vector<thread_t>   f_threads = std::vector<thread_t>();
+    double                  f_seconds = 0.0;
+    double                  f_rate = 0.0;       // operations per second, all threads
+    double                  f_spread = 0.0;     // (max - min) / mean of the thread rates
+    std::uint64_t           f_failures = 0;
+
+    void report(std::ostream & out) const
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(3)
+           << "stress: "
+           << f_threads.size()
+           << " threads, "
+           << f_seconds
+           << "s\n";
+        for(std::size_t idx(0); idx < f_threads.size(); ++idx)
+        {
+            thread_t const & t(f_threads[idx]);
+            ss << "  thread " << idx;
+            if(t.f_cpu >= 0)
+            {
+                ss << " (cpu " << t.f_cpu << ")";
+            }
+            ss << ": "
+               << t.f_operations
+               << " ops, "
+               << std::setprecision(0) << t.f_rate << std::setprecision(3)
+               << " ops/s, "
+               << t.f_failures
+               << " failures\n";
+        }
+        ss << "  total: "
+           << std::setprecision(0) << f_rate << std::setprecision(3)
+           << " ops/s, spread "
+           << std::setprecision(1) << f_spread * 100.0 << std::setprecision(3)
+           << "%, "
+           << f_failures
+           << " failures\n";
+        out << ss.str() << std::flush;
+    }
+
+    std::string failures() const
+    {
+        std::string result;
+        for(std::size_t idx(0); idx < f_threads.size(); ++idx)
+        {
+            if(f_threads[idx].f_failures != 0)
+            {
+                result += "thread "
+                        + std::to_string(idx)
+                        + ": "
+                        + std::to_string(f_threads[idx].f_failures)
+                        + " failures, first: "
+                        + f_threads[idx].f_first_failure
+                        + "\n";
+            }
+        }
+        return result;
+    }
+};
+
+
+namespace detail
+{
+
+
+template<typename F>
+stress_result run_stress(
+          std::size_t threads
+        , std::uint64_t iterations
+        , std::chrono::nanoseconds duration
+        , F const & body)
+{
+    typedef std::chrono::steady_clock   clock_t;
+
+    threads = std::max<std::size_t>(threads, 1);
+    std::vector<int> const cpus(available_cpus());
+
+    stress_result result;
+    result.f_threads.resize(threads);
+
+    // spin barrier: each thread increments `ready` and then waits for
+    // `go` so they all start at the same time
+    //
+    std::atomic<std::size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    bool const oversubscribed(threads > cpus.size());
+
+    auto run = [&](std::size_t idx)
+    {
+        stress_result::thread_t & t(result.f_threads[idx]);
+        if(!cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            t.f_cpu = cpus[idx % cpus.size()];
+            CPU_SET(t.f_cpu, &set);
+            if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            {
+                t.f_cpu = -1;
+            }
+        }
+
+        stress_context ctx;
+        ctx.f_thread = idx;
+        ctx.f_seed = sub_seed(g_seed(), idx);
+        ctx.f_random.seed(ctx.f_seed);
+
+        ready.fetch_add(1, std::memory_order_acq_rel);
+        while(!go.load(std::memory_order_acquire))
+        {
+            if(oversubscribed)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        clock_t::time_point const start(clock_t::now());
+        for(; iterations == 0 || ctx.f_iteration < iterations; ++ctx.f_iteration)
+        {
+            if(iterations == 0
+            && stop.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+            try
+            {
+                body(ctx);
+            }
+            catch(std::exception const & e)
+            {
+                ctx.fail(e.what());
+            }
+            catch(...)
+            {
+                ctx.fail("unknown exception");
+            }
+        }
+        t.f_seconds = std::chrono::duration<double>(clock_t::now() - start).count();
+        t.f_operations = ctx.f_iteration;
+        t.f_failures = ctx.f_failures;
+        t.f_first_failure = ctx.f_first_failure;
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for(std::size_t idx(0); idx < threads; ++idx)
+    {
+        workers.emplace_back(run, idx);
+    }
+    while(ready.load(std::memory_order_acquire) != threads)
+    {
+        std::this_thread::yield();
+    }
+    clock_t::time_point const start(clock_t::now());
+    go.store(true, std::memory_order_release);
+    if(iterations == 0)
+    {
+        std::this_thread::sleep_for(duration);
+        stop.store(true, std::memory_order_relaxed);
+    }
+    for(auto & w : workers)
+    {
+        w.join();
+    }
+    result.f_seconds = std::chrono::duration<double>(clock_t::now() - start).count();
+
+    double min_rate(std::numeric_limits<double>::max());
+    double max_rate(0.0);
+    for(auto & t : result.f_threads)
+    {
+        t.f_rate = t.f_seconds > 0.0 ? static_cast<double>(t.f_operations) / t.f_seconds : 0.0;
+        result.f_rate += t.f_rate;
+        result.f_failures += t.f_failures;
+        min_rate = std::min(min_rate, t.f_rate);
+        max_rate = std::max(max_rate, t.f_rate);
+    }
+    double const mean(result.f_rate / static_cast<double>(threads));
+    result.f_spread = mean > 0.0 ? (max_rate - min_rate) / mean : 0.0;
+
+    return result;
+}
+
+
+} // detail namespace
+
+
+/** \brief Run a stress test for a number of iterations.
+ *
+ * This function starts \p threads threads, each pinned to a different
+ * CPU (when possible). They all wait on a spin barrier so they start at
+ * the same time. Then each thread calls \p body \p iterations times
+ * with its own stress_context.
+ *
+ * The \p body may use the CHECK family of assertions (Catch2 is built
+ * with thread safe assertions) but not the REQUIRE family. It can also
+ * report failures with stress_context::fail() or by throwing an exception.
+ *
+ * \param[in] threads  The number of threads to start.
+ * \param[in] iterations  The number of times each thread calls \p body.
+ * \param[in] body  The function to stress, called with a stress_context.
+ *
+ * \return The per thread and aggregate results.
+ */
+template<typename F>
+stress_result run_stress(std::size_t threads, std::uint64_t iterations, F const & body)
+{
+    return detail::run_stress(threads, std::max<std::uint64_t>(iterations, 1), std::chrono::nanoseconds(), body);
+}
+
+
+/** \brief Run a stress test for a fixed duration.
+ *
+ * This function is the same as the other run_stress() except that the
+ * threads call \p body until \p duration elapsed.
+ *
+ * \param[in] threads  The number of threads to start.
+ * \param[in] duration  How long the threads run.
+ * \param[in] body  The function to stress, called with a stress_context.
+ *
+ * \return The per thread and aggregate results.
+ */
+template<typename Rep, typename Period, typename F>
+stress_result run_stress(std::size_t threads, std::chrono::duration<Rep, Period> duration, F const & body)
+{
+    return detail::run_stress(threads, 0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration), body);
+}
+
+
+/** \brief The result of a differential test.
+ *
+ * See check_equivalent().
+ */
+struct equivalence_result
+{
+    static constexpr std::size_t const  NO_FAILURE = static_cast<std::size_t>(-1);
+
+    std::size_t             f_count = 0;                    // number of inputs requested
+    std::size_t             f_checked = 0;                  // number of inputs actually compared
+    std::size_t             f_failed_index = NO_FAILURE;
+    std::uint64_t           f_seed = 0;                     // seed of the failing input
+    std::string             f_input = std::string();
+    std::string             f_reference = std::string();
+    std::string             f_candidate = std::string();
+    double                  f_reference_seconds = 0.0;
+    double                  f_candidate_seconds = 0.0;
+
+    bool passed() const
+    {
+        return f_failed_index == NO_FAILURE;
+    }
+
+    /** \brief How many times faster the candidate is.
+     *
+     * \return The reference time divided by the candidate time.
+     */
+    double speedup() const
+    {
+        return f_candidate_seconds > 0.0
+                    ? f_reference_seconds / f_candidate_seconds
+                    : 0.0;
+    }
+
+    void report(std::ostream & out) const
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(3)
+           << "equivalence: "
+           << f_checked
+           << " of "
+           << f_count
+           << " inputs, reference "
+           << f_reference_seconds
+           << "s, candidate "
+           << f_candidate_seconds
+           << "s, speedup "
+           << std::setprecision(2) << speedup()
+           << "x\n";
+        out << ss.str() << std::flush;
+    }
+};
+
+
+namespace detail
+{
+
+
+/** \brief The expression of the CATCH_REQUIRE_EQUIVALENT() macro.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
+class equivalence_expression final
+    : public Catch::ITransientExpression
+{
+public:
+    equivalence_expression(equivalence_result const & result)
+        : ITransientExpression(false, result.passed())
+        , m_result(result)
+    {
+    }
+
+    void streamReconstructedExpression(std::ostream & os) const override
+    {
+        if(getResult())
+        {
+            os << "all " << m_result.f_count << " inputs gave equivalent results";
+            return;
+        }
+        os << "input #" << m_result.f_failed_index
+           << " (seed 0x" << std::hex << m_result.f_seed << std::dec << ") differs:"
+           << "\n  input: " << m_result.f_input
+           << "\n  reference: " << m_result.f_reference
+           << "\n  candidate: " << m_result.f_candidate;
+    }
+
+private:
+    equivalence_result const &  m_result;
+};
+#pragma GCC diagnostic pop
+
+
+} // detail namespace
+
+
+/** \brief Compare a candidate implementation against a reference.
+ *
+ * This function generates \p count inputs and checks that \p candidate
+ * returns the same result as \p reference for each one of them. The
+ * inputs are processed by several threads. Input number `n` is created
+ * by calling \p generator with an std::mt19937_64 seeded with
+ * `detail::sub_seed(g_seed(), n)` so the inputs do not depend on the
+ * number of threads and a failure can be reproduced with `--seed`.
+ *
+ * The threads stop as soon as a mismatch is found, except that the
+ * inputs with a smaller index are still checked. This way, the reported
+ * failure is always the one with the smallest index.
+ *
+ * The time spent in \p reference and \p candidate is accumulated so the
+ * speed ratio between both can be reported.
+ *
+ * \warning
+ * The \p reference, \p candidate, \p generator and \p equal functions
+ * are called from several threads at once.
+ *
+ * \param[in] reference  The simple, trusted implementation.
+ * \param[in] candidate  The implementation being checked.
+ * \param[in] generator  A function returning an input, called with an
+ * std::mt19937_64 reference.
+ * \param[in] count  The number of inputs to check.
+ * \param[in] equal  The function comparing the two results.
+ *
+ * \return The result of the comparison.
+ */
+template<typename Reference, typename Candidate, typename Generator, typename Equal = std::equal_to<>>
+equivalence_result check_equivalent(
+      Reference const & reference
+    , Candidate const & candidate
+    , Generator const & generator
+    , std::size_t count
+    , Equal const & equal = Equal())
+{
+    typedef std::chrono::steady_clock   clock_t;
+
+    equivalence_result result;
+    result.f_count = count;
+
+    std::uint64_t const seed(g_seed());
+    std::atomic<std::size_t> first_failure(equivalence_result::NO_FAILURE);
+    std::mutex lock;
+    detail::parallel_for(count, [&](std::size_t begin, std::size_t end)
+    {
+        std::size_t checked(0);
+        clock_t::duration reference_time(0);
+        clock_t::duration candidate_time(0);
+        for(std::size_t idx(begin); idx < end && idx < first_failure.load(std::memory_order_relaxed); ++idx)
+        {
+            std::uint64_t const input_seed(detail::sub_seed(seed, idx));
+            std::mt19937_64 random(input_seed);
+            auto const input(generator(random));
+
+            auto const start(clock_t::now());
+            auto const expected(reference(input));
+            auto const middle(clock_t::now());
+            auto const actual(candidate(input));
+            auto const stop(clock_t::now());
+            reference_time += middle - start;
+            candidate_time += stop - middle;
+            ++checked;
+
+            if(!equal(expected, actual))
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if(idx < result.f_failed_index)
+                {
+                    result.f_failed_index = idx;
+                    result.f_seed = input_seed;
+                    result.f_input = Catch::Detail::stringify(input);
+                    result.f_reference = Catch::Detail::stringify(expected);
+                    result.f_candidate = Catch::Detail::stringify(actual);
+                    first_failure.store(idx, std::memory_order_relaxed);
+                }
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        result.f_checked += checked;
+        result.f_reference_seconds += std::chrono::duration<double>(reference_time).count();
+        result.f_candidate_seconds += std::chrono::duration<double>(candidate_time).count();
+    }, 16);
+
+    return result;
+}
+
+
+namespace detail
+{
+
+
+/** \brief A fast random number engine.
+ *
+ * This is the splitmix64 generator. It is much faster to seed and run
+ * than std::mt19937_64 and it passes BigCrush, which is more than enough
+ * to generate benchmark inputs. It satisfies the UniformRandomBitGenerator
+ * requirements so it can be used with the standard distributions.
+ */
+class data_engine
+{
+public:
+    typedef std::uint64_t       result_type;
+
+    explicit data_engine(std::uint64_t seed)
+        : m_state(seed)
+    {
+    }
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator () ()
+    {
+        std::uint64_t z(m_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /** \brief Get a number in [0, 1).
+     *
+     * \return A double with 53 random bits.
+     */
+    double real()
+    {
+        return static_cast<double>((*this)() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /** \brief Get a number in [0, range).
+     *
+     * When \p range is 0, the full 64 bits are returned.
+     *
+     * \param[in] range  The number of possible values.
+     *
+     * \return A random number.
+     */
+    std::uint64_t below(std::uint64_t range)
+    {
+        if(range == 0)
+        {
+            return (*this)();
+        }
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        return static_cast<std::uint64_t>((static_cast<unsigned __int128>((*this)()) * range) >> 64);
+#pragma GCC diagnostic pop
+    }
+
+private:
+    std::uint64_t       m_state = 0;
+};
+
+
+/** \brief Sample a Zipf distribution.
+ *
+ * This is the rejection-inversion method of W. Hormann and G. Derflinger.
+ * It does not need any table, the setup and each sample take O(1) even
+ * with millions of distinct keys.
+ *
+ * The returned rank is in [1, n]. 1 is the most frequent.
+ */
+class zipf_sampler
+{
+public:
+    zipf_sampler(std::uint64_t n, double s)
+        : m_n(std::max<std::uint64_t>(n, 1))
+        , m_s(s)
+    {
+        m_h_integral_x1 = h_integral(1.5) - 1.0;
+        m_h_integral_n = h_integral(static_cast<double>(m_n) + 0.5);
+        m_threshold = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    std::uint64_t operator () (data_engine & engine) const
+    {
+        for(;;)
+        {
+            double const u(m_h_integral_n + engine.real() * (m_h_integral_x1 - m_h_integral_n));
+            double const x(h_integral_inverse(u));
+            double k(std::floor(x + 0.5));
+            if(k < 1.0)
+            {
+                k = 1.0;
+            }
+            else if(k > static_cast<double>(m_n))
+            {
+                k = static_cast<double>(m_n);
+            }
+            if(k - x <= m_threshold
+            || u >= h_integral(k + 0.5) - h(k))
+            {
+                return static_cast<std::uint64_t>(k);
+            }
+        }
+    }
+
+private:
+    double h(double x) const
+    {
+        return std::exp(-m_s * std::log(x));
+    }
+
+    double h_integral(double x) const
+    {
+        double const log_x(std::log(x));
+        return helper2((1.0 - m_s) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        double t(x * (1.0 - m_s));
+        if(t < -1.0)
+        {
+            t = -1.0;
+        }
+        return std::exp(helper1(t) * x);
+    }
+
+    // log(1 + x) / x, precise near 0
+    static double helper1(double x)
+    {
+        return std::abs(x) > 1e-8
+                    ? std::log1p(x) / x
+                    : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // (exp(x) - 1) / x, precise near 0
+    static double helper2(double x)
+    {
+        return std::abs(x) > 1e-8
+                    ? std::expm1(x) / x
+                    : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    std::uint64_t       m_n = 1;
+    double              m_s = 1.0;
+    double              m_h_integral_x1 = 0.0;
+    double              m_h_integral_n = 0.0;
+    double              m_threshold = 0.0;
+};
+
+
+/** \brief The type of the items of a contiguous container.
+ *
+ * \tparam C  A container supported by std::data().
+ */
+template<typename C>
+using data_value_t = std::remove_cv_t<std::remove_reference_t<decltype(*std::data(std::declval<C &>()))>>;
+
+
+} // detail namespace
+
+
+/** \brief Generate large benchmark inputs.
+ *
+ * The functions of this class fill a contiguous container (std::vector,
+ * std::array, std::span, etc.) with values following a distribution.
+ *
+ * The data is reproducible: it only depends on `--seed` (g_seed()), the
+ * \p stream number given to the constructor and the number of calls made
+ * on the generator so far. Use a different stream in each test which
+ * needs independent data.
+ *
+ * The buffers are cut in blocks of 16K items. Each block gets its own
+ * engine seeded from the block number so the blocks are generated in
+ * parallel and the result does not depend on the number of CPUs.
+ *
+ * \code
+ *     std::vector<std::uint32_t> keys(10'000'000);
+ *     SNAP_CATCH2_NAMESPACE::data_generator gen(1);
+ *     gen.fill_zipf(keys, 1'000'000, 0.99);
+ * \endcode
+ */
+class data_generator
+{
+public:
+    static constexpr std::size_t const  BLOCK_SIZE = 16 * 1024;
+
+    /** \brief Initialize the generator.
+     *
+     * \param[in] stream  The stream number, combined with g_seed().
+     */
+    explicit data_generator(std::uint64_t stream = 0)
+        : m_seed(detail::sub_seed(g_seed(), stream))
+    {
+    }
+
+    /** \brief Fill a container with uniformly distributed values.
+     *
+     * The values are in [\p min, \p max]. For floating point types, \p max
+     * is excluded.
+     *
+     * \param[out] c  The container to fill.
+     * \param[in] min  The smallest value.
+     * \param[in] max  The largest value.
+     */
+    template<typename C>
+    void fill_uniform(C && c, detail::data_value_t<C> min, detail::data_value_t<C> max)
+    {
+        typedef detail::data_value_t<C> T;
+        fill(c, [min, max](detail::data_engine & engine) -> T
+            {
+                if constexpr(std::is_floating_point_v<T>)
+                {
+                    return static_cast<T>(min + (max - min) * engine.real());
+                }
+                else
+                {
+                    static_assert(sizeof(T) <= sizeof(std::uint64_t), "fill_uniform() supports integers of up to 64 bits");
+                    std::uint64_t const range(static_cast<std::uint64_t>(max) - static_cast<std::uint64_t>(min) + 1);
+                    return static_cast<T>(static_cast<std::uint64_t>(min) + engine.below(range));
+                }
+            });
+    }
+
+    /** \brief Fill a container with normally distributed values.
+     *
+     * Integers get the value rounded to the nearest integer.
+     *
+     * \param[out] c  The container to fill.
+     * \param[in] mean  The mean of the distribution.
+     * \param[in] stddev  The standard deviation of the distribution.
+     */
+    template<typename C>
+    void fill_normal(C && c, double mean, double stddev)
+    {
+        typedef detail::data_value_t<C> T;
+        fill(c, [mean, stddev](detail::data_engine & engine) -> T
+            {
+                // Box-Muller, the second value is dropped so each item only
+                // depends on the engine state
+                //
+                double const u1(1.0 - engine.real());
+                double const u2(engine.real());
+                double const v(mean + stddev * std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2));
+                return to_value<T>(v);
+            });
+    }
+
+    /** \brief Fill a container with exponentially distributed values.
+     *
+     * This is the distribution of the time between events which happen
+     * at a rate of \p lambda per unit of time. The mean is 1 / \p lambda.
+     *
+     * \param[out] c  The container to fill.
+     * \param[in] lambda  The rate of the distribution.
+     */
+    template<typename C>
+    void fill_exponential(C && c, double lambda)
+    {
+        typedef detail::data_value_t<C> T;
+        fill(c, [lambda](detail::data_engine & engine) -> T
+            {
+                return to_value<T>(-std::log(1.0 - engine.real()) / lambda);
+            });
+    }
+
+    /** \brief Fill a container with Zipf distributed keys.
+     *
+     * The keys are in [0, \p n). Key 0 is the most frequent, key 1 the
+     * second most frequent, etc. The probability of key k is proportional
+     * to 1 / (k + 1)^\p s. Web caches and database keys usually have an
+     * \p s close to 1.
+     *
+     * \param[out] c  The container to fill.
+     * \param[in] n  The number of distinct keys.
+     * \param[in] s  The exponent of the distribution.
+     */
+    template<typename C>
+    void fill_zipf(C && c, std::uint64_t n, double s = 1.0)
+    {
+        typedef detail::data_value_t<C> T;
+        static_assert(std::is_integral_v<T>, "fill_zipf() generates integer keys");
+
+        detail::zipf_sampler const sampler(n, s);
+        fill(c, [&sampler](detail::data_engine & engine) -> T
+            {
+                return static_cast<T>(sampler(engine) - 1);
+            });
+    }
+
+    /** \brief Sort a container, leaving some of the items out of place.
+     *
+     * The container is sorted and then `size * unsorted_ratio / 2` pairs
+     * of items get swapped. With a ratio of 0.0, the container is fully
+     * sorted.
+     *
+     * \param[in,out] c  The container to sort.
+     * \param[in] unsorted_ratio  The ratio of items which end up out of place.
+     */
+    template<typename C>
+    void make_sorted(C && c, double unsorted_ratio = 0.0)
+    {
+        auto * const data(std::data(c));
+        std::size_t const size(std::size(c));
+        std::sort(data, data + size);
+
+        std::size_t const swaps(static_cast<std::size_t>(static_cast<double>(size) * unsorted_ratio / 2.0));
+        if(swaps == 0 || size < 2)
+        {
+            return;
+        }
+        detail::data_engine engine(next_seed());
+        for(std::size_t idx(0); idx < swaps; ++idx)
+        {
+            std::swap(data[engine.below(size)], data[engine.below(size)]);
+        }
+    }
+
+    /** \brief Replace some items with a copy of other items.
+     *
+     * A \p ratio of the items (0.0 to 1.0) gets replaced by a copy of
+     * another item of the container chosen at random.
+     *
+     * \param[in,out] c  The container to update.
+     * \param[in] ratio  The ratio of items to replace with a duplicate.
+     */
+    template<typename C>
+    void make_duplicates(C && c, double ratio)
+    {
+        auto * const data(std::data(c));
+        std::size_t const size(std::size(c));
+        std::size_t const count(static_cast<std::size_t>(static_cast<double>(size) * ratio));
+        if(count == 0 || size < 2)
+        {
+            return;
+        }
+        detail::data_engine engine(next_seed());
+        for(std::size_t idx(0); idx < count; ++idx)
+        {
+            data[engine.below(size)] = data[engine.below(size)];
+        }
+    }
+
+private:
+    template<typename T>
+    static T to_value(double v)
+    {
+        if constexpr(std::is_floating_point_v<T>)
+        {
+            return static_cast<T>(v);
+        }
+        else
+        {
+            return static_cast<T>(std::llround(v));
+        }
+    }
+
+    std::uint64_t next_seed()
+    {
+        return detail::sub_seed(m_seed, m_calls++);
+    }
+
+    template<typename C, typename F>
+    void fill(C & c, F const & f)
+    {
+        auto * const data(std::data(c));
+        std::size_t const size(std::size(c));
+        std::size_t const blocks((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        std::uint64_t const seed(next_seed());
+        detail::parallel_for(blocks, [data, size, seed, &f](std::size_t begin, std::size_t end)
+            {
+                for(std::size_t block(begin); block < end; ++block)
+                {
+                    detail::data_engine engine(detail::sub_seed(seed, block));
+                    std::size_t const last(std::min(size, (block + 1) * BLOCK_SIZE));
+                    for(std::size_t idx(block * BLOCK_SIZE); idx < last; ++idx)
+                    {
+                        data[idx] = f(engine);
+                    }
+                }
+            }, 4);
+    }
+
+    std::uint64_t       m_seed = 0;
+    std::uint64_t       m_calls = 0;
+};
+
+
+/** \brief Load a generated dataset from disk or generate it.
+ *
+ * Generating hundreds of megabytes of benchmark input takes time. This
+ * function saves the data generated by \p generate under
+ * `<binary-dir>/snapcatch2-datasets/` and loads it back on the next run
+ * instead of calling \p generate again.
+ *
+ * The filename includes \p name, the seed, the number of items and the
+ * type of the items. Make sure \p name changes whenever the parameters
+ * used by \p generate change.
+ *
+ * When g_binary_dir() is empty, nothing gets cached.
+ *
+ * \code
+ *     std::vector<std::uint64_t> const keys(
+ *         SNAP_CATCH2_NAMESPACE::cached_dataset<std::uint64_t>(
+ *               "zipf-1m-0.99"
+ *             , 100'000'000
+ *             , [](std::vector<std::uint64_t> & data)
+ *               {
+ *                   SNAP_CATCH2_NAMESPACE::data_generator(1).fill_zipf(data, 1'000'000, 0.99);
+ *               }));
+ * \endcode
+ *
+ * \tparam T  The type of the items, it has to be trivially copyable.
+ * \param[in] name  The name of the dataset.
+ * \param[in] size  The number of items in the dataset.
+ * \param[in] generate  The function called to fill the dataset.
+ *
+ * \return The dataset.
+ */
+template<typename T, typename F>
+std::vector<T> cached_dataset(std::string const & name, std::size_t size, F const & generate)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "cached_dataset() only supports trivially copyable types");
+
+    std::vector<T> result(size);
+    if(g_binary_dir().empty())
+    {
+        generate(result);
+        return result;
+    }
+
+    std::string safe_name(name);
+    for(auto & c : safe_name)
+    {
+        if(!isalnum(static_cast<unsigned char>(c))
+        && c != '-'
+        && c != '_'
+        && c != '.')
+        {
+            c = '_';
+        }
+    }
+    char const type(std::is_floating_point_v<T>
+                        ? 'f'
+                        : (std::is_signed_v<T> ? 'i' : 'u'));
+    std::filesystem::path const dir(std::filesystem::path(g_binary_dir()) / "snapcatch2-datasets");
+    std::filesystem::path const filename(dir
+            / (safe_name
+                + '-' + std::to_string(g_seed())
+                + '-' + std::to_string(size)
+                + '-' + type + std::to_string(sizeof(T) * 8)
+                + ".bin"));
+
+    std::size_t const bytes(size * sizeof(T));
+    std::error_code ec;
+    if(std::filesystem::file_size(filename, ec) == bytes && !ec)
+    {
+        std::ifstream in(filename, std::ios::binary);
+        if(in.read(reinterpret_cast<char *>(result.data()), static_cast<std::streamsize>(bytes)))
+        {
+            return result;
+        }
+    }
+
+    generate(result);
+
+    std::filesystem::create_directories(dir, ec);
+    std::string const tmp(filename.string() + ".tmp" + std::to_string(getpid()));
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out.write(reinterpret_cast<char const *>(result.data()), static_cast<std::streamsize>(bytes));
+        if(!out)
+        {
+            std::cerr << "warning: could not save dataset \""
+                      << filename.string()
+                      << "\".\n";
+            unlink(tmp.c_str());
+            return result;
+        }
+    }
+    rename(tmp.c_str(), filename.c_str());
+
+    return result;
+}
+
+
+namespace detail
+{
+
+
+/** \brief Process-wide cache of the memory mapped fixture files.
+ *
+ * The files are mapped read-only once and stay mapped until the process
+ * exits. When a file changes (its modification time, size or inode differ)
+ * it gets mapped again. The old mapping is kept since views on it may
+ * still be in use.
+ */
+class fixture_cache
+{
+public:
+    static fixture_cache & instance()
+    {
+        static fixture_cache cache;
+
+        return cache;
+    }
+
+    fixture_cache(fixture_cache const &) = delete;
+    fixture_cache & operator = (fixture_cache const &) = delete;
+
+    ~fixture_cache()
+    {
+        for(auto const & m : m_mappings)
+        {
+            munmap(m.first, m.second);
+        }
+    }
+
+    std::string_view get(std::string const & path, bool prefault)
+    {
+        struct stat st = {};
+        if(stat(path.c_str(), &st) != 0)
+        {
+            throw std::runtime_error(
+                      "could not find fixture \""
+                    + path
+                    + "\": "
+                    + strerror(errno));
+        }
+
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        auto it(m_files.find(path));
+        if(it != m_files.end()
+        && it->second.f_inode == st.st_ino
+        && it->second.f_size == st.st_size
+        && it->second.f_mtime.tv_sec == st.st_mtim.tv_sec
+        && it->second.f_mtime.tv_nsec == st.st_mtim.tv_nsec)
+        {
+            return it->second.f_view;
+        }
+
+        file_t file;
+        file.f_inode = st.st_ino;
+        file.f_size = st.st_size;
+        file.f_mtime = st.st_mtim;
+        if(st.st_size > 0)
+        {
+            int const fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+            if(fd == -1)
+            {
+                throw std::runtime_error(
+                          "could not open fixture \""
+                        + path
+                        + "\": "
+                        + strerror(errno));
+            }
+            std::size_t const size(static_cast<std::size_t>(st.st_size));
+            void * const addr(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+            close(fd);
+            if(addr == MAP_FAILED)
+            {
+                throw std::runtime_error(
+                          "could not map fixture \""
+                        + path
+                        + "\": "
+                        + strerror(errno));
+            }
+            if(prefault)
+            {
+                madvise(addr, size, MADV_WILLNEED);
+            }
+            m_mappings.emplace_back(addr, size);
+            file.f_view = std::string_view(static_cast<char const *>(addr), size);
+        }
+        m_files[path] = file;
+
+        return file.f_view;
+    }
+
+private:
+    struct file_t
+    {
+        ino_t               f_inode = 0;
+        off_t               f_size = 0;
+        timespec            f_mtime = timespec();
+        std::string_view    f_view = std::string_view();
+    };
+
+    fixture_cache()
+    {
+    }
+
+    std::mutex                                  m_lock = std::mutex();
+    std::map<std::string, file_t>               m_files = std::map<std::string, file_t>();
+    std::vector<std::pair<void *, std::size_t>> m_mappings = std::vector<std::pair<void *, std::size_t>>();
+};
+
+
+} // detail namespace
+
+
+/** \brief Get the contents of a fixture file without copying it.
+ *
+ * Large input files used by many test cases get memory mapped read-only
+ * the first time they are used. The following calls return a view of
+ * the same mapping, so reading a fixture costs one stat() instead of a
+ * copy of the whole file in a new std::string.
+ *
+ * The cache is keyed by path and modification time. If the file changes
+ * while the tests run, it gets mapped again. The views remain valid until
+ * the process exits.
+ *
+ * \warning
+ * Like with any mapping, a file modified in place also changes the data
+ * seen through the older views (and truncating it makes accessing them
+ * crash with SIGBUS). A test which updates a fixture should write a new
+ * file and rename() it over the old one.
+ *
+ * \code
+ *     std::string_view const data(SNAP_CATCH2_NAMESPACE::fixture_view(
+ *                 SNAP_CATCH2_NAMESPACE::g_source_dir() + "/tests/data/large.json"));
+ * \endcode
+ *
+ * \exception std::runtime_error
+ * The file does not exist, cannot be opened or cannot be mapped.
+ *
+ * \param[in] path  The path to the fixture file.
+ * \param[in] prefault  Whether to ask the kernel to read the whole file
+ * ahead of time (MADV_WILLNEED).
+ *
+ * \return A view of the file contents.
+ */
+inline std::string_view fixture_view(std::string const & path, bool prefault = true)
+{
+    return detail::fixture_cache::instance().get(path, prefault);
+}
+
+
+#if __cplusplus >= 202002L
+/** \brief Get the contents of a fixture file as bytes.
+ *
+ * This is the same as fixture_view() for binary files.
+ *
+ * \param[in] path  The path to the fixture file.
+ * \param[in] prefault  Whether to ask the kernel to read the whole file
+ * ahead of time (MADV_WILLNEED).
+ *
+ * \return A span over the file contents.
+ */
+inline std::span<std::uint8_t const> fixture_bytes(std::string const & path, bool prefault = true)
+{
+    std::string_view const view(fixture_view(path, prefault));
+    return std::span<std::uint8_t const>(reinterpret_cast<std::uint8_t const *>(view.data()), view.size());
+}
+#endif
+
+
+namespace detail
+{
+
+
+/** \brief The number of rows located before they get processed.
+ *
+ * The rows of a table are located by the calling thread one batch at a
+ * time and each batch is then processed by several threads. This way
+ * the table is never materialized as a whole.
+ */
+constexpr std::size_t const TABLE_ROW_BATCH = 64 * 1024;
+
+
+/** \brief The minimum number of rows processed by one thread.
+ */
+constexpr std::size_t const TABLE_ROW_GRAIN = 1024;
+
+
+/** \brief The formats supported by the table tests.
+ */
+enum class table_format_t
+{
+    TABLE_FORMAT_CSV,
+    TABLE_FORMAT_TSV,
+    TABLE_FORMAT_JSON_LINES,
+};
+
+
+/** \brief The position of one row in a table file.
+ */
+struct table_row_t
+{
+    std::size_t                 f_begin = 0;
+    std::size_t                 f_end = 0;
+    std::size_t                 f_line = 0;
+};
+
+
+/** \brief The fields of one row.
+ *
+ * The fields are views in the mapped file unless they had to be
+ * unescaped in which case they are views of the strings saved in
+ * f_storage. For JSON lines, f_keys has the name of each field.
+ */
+struct table_fields_t
+{
+    void clear()
+    {
+        f_keys.clear();
+        f_values.clear();
+        f_storage.clear();
+    }
+
+    std::string_view save(std::string && value)
+    {
+        f_storage.push_back(std::move(value));
+        return f_storage.back();
+    }
+
+    std::vector<std::string_view>   f_keys = std::vector<std::string_view>();
+    std::vector<std::string_view>   f_values = std::vector<std::string_view>();
+    std::deque<std::string>         f_storage = std::deque<std::string>();
+};
+
+
+/** \brief Convert a field to the type of a parameter.
+ *
+ * Strings and string views are used as is, integers and floating points
+ * must be valid numbers with nothing after them, booleans are "true",
+ * "false", "1" or "0". Any other type is read with its `operator >> ()`.
+ *
+ * \param[in] value  The field to convert.
+ * \param[out] result  The converted value.
+ *
+ * \return true if the whole field was converted.
+ */
+template<typename T>
+bool table_convert(std::string_view value, T & result)
+{
+    if constexpr (std::is_same_v<T, std::string_view>)
+    {
+        result = value;
+        return true;
+    }
+    else if constexpr (std::is_same_v<T, std::string>)
+    {
+        result.assign(value.data(), value.size());
+        return true;
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        if(value == "true" || value == "1")
+        {
+            result = true;
+            return true;
+        }
+        if(value == "false" || value == "0")
+        {
+            result = false;
+            return true;
+        }
+        return false;
+    }
+    else if constexpr (std::is_same_v<T, char>)
+    {
+        if(value.size() != 1)
+        {
+            return false;
+        }
+        result = value[0];
+        return true;
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        char const * end(value.data() + value.size());
+        std::from_chars_result const r(std::from_chars(value.data(), end, result));
+        return r.ec == std::errc() && r.ptr == end;
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        std::string const s(value);
+        if(s.empty() || isspace(static_cast<unsigned char>(s[0])))
+        {
+            return false;
+        }
+        char * end(nullptr);
+        errno = 0;
+        long double const r(strtold(s.c_str(), &end));
+        if(errno != 0 || end != s.c_str() + s.size())
+        {
+            return false;
+        }
+        result = static_cast<T>(r);
+        return true;
+    }
+    else
+    {
+        std::istringstream in{std::string(value)};
+        in >> result;
+        return !in.fail() && (in >> std::ws).eof();
+    }
+}
+
+
+/** \brief Deduce the parameters of the function called with each row.
+ *
+ * The columns get converted to the decayed type of each parameter so the
+ * function must not be a generic lambda.
+ */
+template<typename F>
+struct table_function
+    : table_function<decltype(&F::operator())>
+{
+};
+
+
+template<typename R, typename ... A>
+struct table_function<R (*)(A ...)>
+{
+    typedef std::tuple<std::decay_t<A> ...>     arguments_t;
+};
+
+
+template<typename C, typename R, typename ... A>
+struct table_function<R (C::*)(A ...)>
+    : table_function<R (*)(A ...)>
+{
+};
+
+
+template<typename C, typename R, typename ... A>
+struct table_function<R (C::*)(A ...) const>
+    : table_function<R (*)(A ...)>
+{
+};
+
+
+/** \brief Read the rows of a CSV, TSV or JSON lines file.
+ *
+ * The file is mapped with fixture_view(). The rows are located one batch
+ * at a time by next_rows() and then each row is parsed on its own with
+ * parse_row() so the rows can be processed by several threads.
+ *
+ * Empty lines are ignored. The first row of a CSV or TSV file is the
+ * name of the columns. A field within double quotes can include the
+ * separator, new lines and double quotes (written twice). Each line of
+ * a JSON lines file is one object; nested objects and arrays are kept
+ * as JSON text and null is an empty field.
+ */
+class table_reader
+{
+public:
+    table_reader(std::string const & path)
+        : m_path(path)
+    {
+        std::string filename(path);
+        if(!filename.empty()
+        && filename[0] != '/'
+        && !g_source_dir().empty())
+        {
+            filename = g_source_dir() + '/' + filename;
+        }
+
+        std::string::size_type const pos(path.rfind('.'));
+        std::string const extension(pos == std::string::npos ? std::string() : path.substr(pos));
+        if(extension == ".csv")
+        {
+            m_format = table_format_t::TABLE_FORMAT_CSV;
+        }
+        else if(extension == ".tsv")
+        {
+            m_format = table_format_t::TABLE_FORMAT_TSV;
+            m_separator = '\t';
+        }
+        else if(extension == ".jsonl"
+             || extension == ".ndjson")
+        {
+            m_format = table_format_t::TABLE_FORMAT_JSON_LINES;
+        }
+        else
+        {
+            throw std::runtime_error(
+                      "table \""
+                    + path
+                    + "\" must be a .csv, .tsv, .jsonl or .ndjson file.");
+        }
+
+        m_data = fixture_view(filename);
+
+        if(m_format != table_format_t::TABLE_FORMAT_JSON_LINES)
+        {
+            std::vector<table_row_t> header;
+            if(next_rows(header, 1) == 0)
+            {
+                throw std::runtime_error("table \"" + path + "\" has no header.");
+            }
+            std::string error;
+            if(!parse_row(header[0], m_header, error))
+            {
+                throw std::runtime_error(location(header[0]) + ": " + error);
+            }
+        }
+    }
+
+    table_reader(table_reader const &) = delete;
+    table_reader & operator = (table_reader const &) = delete;
+
+    table_format_t format() const
+    {
+        return m_format;
+    }
+
+    std::vector<std::string> header() const
+    {
+        return std::vector<std::string>(m_header.f_values.begin(), m_header.f_values.end());
+    }
+
+    /** \brief Get the index of the named columns.
+     *
+     * For JSON lines, the columns are searched in each row instead.
+     *
+     * \exception std::runtime_error
+     * A CSV or TSV column does not exist.
+     *
+     * \param[in] columns  The names of the columns.
+     *
+     * \return The index of each column in the header.
+     */
+    std::vector<std::size_t> column_indices(std::vector<std::string> const & columns) const
+    {
+        std::vector<std::size_t> result;
+        for(auto const & c : columns)
+        {
+            auto const it(std::find(m_header.f_values.begin(), m_header.f_values.end(), c));
+            if(it == m_header.f_values.end())
+            {
+                throw std::runtime_error(
+                          "table \""
+                        + m_path
+                        + "\" has no column named \""
+                        + c
+                        + "\".");
+            }
+            result.push_back(it - m_header.f_values.begin());
+        }
+        return result;
+    }
+
+    /** \brief Locate the next rows of the table.
+     *
+     * \param[out] rows  The vector receiving the position of the rows.
+     * \param[in] max  The maximum number of rows to locate.
+     *
+     * \return The number of rows found, 0 at the end of the file.
+     */
+    std::size_t next_rows(std::vector<table_row_t> & rows, std::size_t max)
+    {
+        rows.clear();
+        bool const quotes(m_format != table_format_t::TABLE_FORMAT_JSON_LINES);
+        std::size_t const size(m_data.size());
+        while(rows.size() < max && m_pos < size)
+        {
+            table_row_t row;
+            row.f_begin = m_pos;
+            row.f_line = m_line;
+            bool quoted(false);
+            bool empty(true);
+            for(; m_pos < size; ++m_pos)
+            {
+                char const c(m_data[m_pos]);
+                if(c == '\n')
+                {
+                    ++m_line;
+                    if(!quoted)
+                    {
+                        break;
+                    }
+                }
+                else if(c == '"' && quotes)
+                {
+                    quoted = !quoted;
+                }
+                if(!isspace(static_cast<unsigned char>(c)))
+                {
+                    empty = false;
+                }
+            }
+            row.f_end = m_pos;
+            if(m_pos < size)
+            {
+                ++m_pos;
+            }
+            if(!empty)
+            {
+                rows.push_back(row);
+            }
+        }
+        return rows.size();
+    }
+
+    /** \brief Split a row in fields.
+     *
+     * \param[in] row  The row to parse.
+     * \param[out] fields  The fields of the row.
+     * \param[out] error  The error message when the row is invalid.
+     *
+     * \return true if the row is valid.
+     */
+    bool parse_row(table_row_t const & row, table_fields_t & fields, std::string & error) const
+    {
+        fields.clear();
+        std::string_view line(m_data.substr(row.f_begin, row.f_end - row.f_begin));
+        if(!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if(m_format == table_format_t::TABLE_FORMAT_JSON_LINES)
+        {
+            return parse_json(line, fields, error);
+        }
+        return parse_separated(line, fields, error);
+    }
+
+    /** \brief Find the fields bound to the named columns.
+     *
+     * \param[in] fields  The fields of a row.
+     * \param[in] columns  The names of the columns.
+     * \param[in] indices  The indices returned by column_indices().
+     * \param[out] values  The fields of the columns in order.
+     * \param[out] error  The error message when a field is missing.
+     *
+     * \return true if all the fields were found.
+     */
+    bool select(
+          table_fields_t const & fields
+        , std::vector<std::string> const & columns
+        , std::vector<std::size_t> const & indices
+        , std::vector<std::string_view> & values
+        , std::string & error) const
+    {
+        values.clear();
+        if(m_format == table_format_t::TABLE_FORMAT_JSON_LINES)
+        {
+            for(auto const & c : columns)
+            {
+                auto const it(std::find(fields.f_keys.begin(), fields.f_keys.end(), c));
+                if(it == fields.f_keys.end())
+                {
+                    error = "missing field \"" + c + "\".";
+                    return false;
+                }
+                values.push_back(fields.f_values[it - fields.f_keys.begin()]);
+            }
+            return true;
+        }
+
+        if(fields.f_values.size() != m_header.f_values.size())
+        {
+            error = "found "
+                  + std::to_string(fields.f_values.size())
+                  + " fields, expected "
+                  + std::to_string(m_header.f_values.size())
+                  + ".";
+            return false;
+        }
+        for(auto const idx : indices)
+        {
+            values.push_back(fields.f_values[idx]);
+        }
+        return true;
+    }
+
+    std::string location(table_row_t const & row) const
+    {
+        return m_path + ':' + std::to_string(row.f_line);
+    }
+
+private:
+    bool parse_separated(std::string_view line, table_fields_t & fields, std::string & error) const
+    {
+        std::size_t pos(0);
+        for(;;)
+        {
+            if(pos < line.size() && line[pos] == '"')
+            {
+                std::size_t const start(++pos);
+                bool escaped(false);
+                for(;; ++pos)
+                {
+                    if(pos >= line.size())
+                    {
+                        error = "missing closing quote.";
+                        return false;
+                    }
+                    if(line[pos] == '"')
+                    {
+                        if(pos + 1 < line.size() && line[pos + 1] == '"')
+                        {
+                            escaped = true;
+                            ++pos;
+                            continue;
+                        }
+                        break;
+                    }
+                }
+                std::string_view value(line.substr(start, pos - start));
+                if(escaped)
+                {
+                    std::string unescaped;
+                    unescaped.reserve(value.size());
+                    for(std::size_t idx(0); idx < value.size(); ++idx)
+                    {
+                        unescaped += value[idx];
+                        if(value[idx] == '"')
+                        {
+                            ++idx;
+                        }
+                    }
+                    value = fields.save(std::move(unescaped));
+                }
+                fields.f_values.push_back(value);
+                ++pos;
+                if(pos < line.size() && line[pos] != m_separator)
+                {
+                    error = "unexpected character after a quoted field.";
+                    return false;
+                }
+            }
+            else
+            {
+                std::size_t const end(std::min(line.find(m_separator, pos), line.size()));
+                fields.f_values.push_back(line.substr(pos, end - pos));
+                pos = end;
+            }
+            if(pos >= line.size())
+            {
+                return true;
+            }
+            ++pos;
+        }
+    }
+
+    static void skip_spaces(std::string_view line, std::size_t & pos)
+    {
+        while(pos < line.size() && isspace(static_cast<unsigned char>(line[pos])))
+        {
+            ++pos;
+        }
+    }
+
+    static void append_utf8(std::string & result, std::uint32_t c)
+    {
+        if(c < 0x80)
+        {
+            result += static_cast<char>(c);
+        }
+        else if(c < 0x800)
+        {
+            result += static_cast<char>(0xC0 | (c >> 6));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if(c < 0x10000)
+        {
+            result += static_cast<char>(0xE0 | (c >> 12));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            result += static_cast<char>(0xF0 | (c >> 18));
+            result += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    static bool parse_hex4(std::string_view line, std::size_t pos, std::uint32_t & c)
+    {
+        if(pos + 4 > line.size())
+        {
+            return false;
+        }
+        char const * end(line.data() + pos + 4);
+        std::from_chars_result const r(std::from_chars(line.data() + pos, end, c, 16));
+        return r.ec == std::errc() && r.ptr == end;
+    }
+
+    static bool parse_json_string(
+          std::string_view line
+        , std::size_t & pos
+        , table_fields_t & fields
+        , std::string_view & value
+        , std::string & error)
+    {
+        std::size_t const start(++pos);
+        std::size_t end(start);
+        while(end < line.size() && line[end] != '"' && line[end] != '\\')
+        {
+            ++end;
+        }
+        if(end < line.size() && line[end] == '"')
+        {
+            value = line.substr(start, end - start);
+            pos = end + 1;
+            return true;
+        }
+
+        std::string result(line.substr(start, end - start));
+        for(pos = end; pos < line.size(); ++pos)
+        {
+            char c(line[pos]);
+            if(c == '"')
+            {
+                ++pos;
+                value = fields.save(std::move(result));
+                return true;
+            }
+            if(c != '\\')
+            {
+                result += c;
+                continue;
+            }
+            ++pos;
+            c = pos < line.size() ? line[pos] : '\0';
+            switch(c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                result += c;
+                break;
+
+            case 'b':
+                result += '\b';
+                break;
+
+            case 'f':
+                result += '\f';
+                break;
+
+            case 'n':
+                result += '\n';
+                break;
+
+            case 'r':
+                result += '\r';
+                break;
+
+            case 't':
+                result += '\t';
+                break;
+
+            case 'u':
+                {
+                    std::uint32_t code(0);
+                    if(!parse_hex4(line, pos + 1, code))
+                    {
+                        error = "invalid \\u escape sequence.";
+                        return false;
+                    }
+                    pos += 4;
+                    if(code >= 0xD800 && code < 0xDC00)
+                    {
+                        std::uint32_t low(0);
+                        if(pos + 2 >= line.size()
+                        || line[pos + 1] != '\\'
+                        || line[pos + 2] != 'u'
+                        || !parse_hex4(line, pos + 3, low)
+                        || low < 0xDC00
+                        || low >= 0xE000)
+                        {
+                            error = "invalid UTF-16 surrogate pair.";
+                            return false;
+                        }
+                        pos += 6;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    else if(code >= 0xDC00 && code < 0xE000)
+                    {
+                        error = "invalid UTF-16 surrogate pair.";
+                        return false;
+                    }
+                    append_utf8(result, code);
+                }
+                break;
+
+            default:
+                error = "invalid escape sequence.";
+                return false;
+
+            }
+        }
+        error = "missing closing quote.";
+        return false;
+    }
+
+    static bool parse_json_value(
+          std::string_view line
+        , std::size_t & pos
+        , table_fields_t & fields
+        , std::string_view & value
+        , std::string & error)
+    {
+        if(pos >= line.size())
+        {
+            error = "missing value.";
+            return false;
+        }
+        if(line[pos] == '"')
+        {
+            return parse_json_string(line, pos, fields, value, error);
+        }
+
+        std::size_t const start(pos);
+        if(line[pos] == '{' || line[pos] == '[')
+        {
+            // keep nested objects and arrays as JSON text
+            //
+            std::size_t depth(0);
+            bool quoted(false);
+            for(; pos < line.size(); ++pos)
+            {
+                char const c(line[pos]);
+                if(quoted)
+                {
+                    if(c == '\\')
+                    {
+                        ++pos;
+                    }
+                    else if(c == '"')
+                    {
+                        quoted = false;
+                    }
+                }
+                else if(c == '"')
+                {
+                    quoted = true;
+                }
+                else if(c == '{' || c == '[')
+                {
+                    ++depth;
+                }
+                else if(c == '}' || c == ']')
+                {
+                    --depth;
+                    if(depth == 0)
+                    {
+                        ++pos;
+                        value = line.substr(start, pos - start);
+                        return true;
+                    }
+                }
+            }
+            error = "unterminated object or array.";
+            return false;
+        }
+
+        while(pos < line.size()
+           && line[pos] != ','
+           && line[pos] != '}'
+           && !isspace(static_cast<unsigned char>(line[pos])))
+        {
+            ++pos;
+        }
+        value = line.substr(start, pos - start);
+        if(value.empty())
+        {
+            error = "missing value.";
+            return false;
+        }
+        if(value == "null")
+        {
+            value = std::string_view();
+        }
+        return true;
+    }
+
+    static bool parse_json(std::string_view line, table_fields_t & fields, std::string & error)
+    {
+        std::size_t pos(0);
+        skip_spaces(line, pos);
+        if(pos >= line.size() || line[pos] != '{')
+        {
+            error = "each line must be a JSON object.";
+            return false;
+        }
+        ++pos;
+        skip_spaces(line, pos);
+        if(pos < line.size() && line[pos] == '}')
+        {
+            ++pos;
+        }
+        else
+        {
+            for(;;)
+            {
+                std::string_view key;
+                if(pos >= line.size()
+                || line[pos] != '"')
+                {
+                    error = "expected a field name.";
+                    return false;
+                }
+                if(!parse_json_string(line, pos, fields, key, error))
+                {
+                    return false;
+                }
+                skip_spaces(line, pos);
+                if(pos >= line.size() || line[pos] != ':')
+                {
+                    error = "expected ':' after a field name.";
+                    return false;
+                }
+                ++pos;
+                skip_spaces(line, pos);
+                std::string_view value;
+                if(!parse_json_value(line, pos, fields, value, error))
+                {
+                    return false;
+                }
+                fields.f_keys.push_back(key);
+                fields.f_values.push_back(value);
+                skip_spaces(line, pos);
+                if(pos < line.size() && line[pos] == '}')
+                {
+                    ++pos;
+                    break;
+                }
+                if(pos >= line.size() || line[pos] != ',')
+                {
+                    error = "expected ',' or '}' after a value.";
+                    return false;
+                }
+                ++pos;
+                skip_spaces(line, pos);
+            }
+        }
+        skip_spaces(line, pos);
+        if(pos != line.size())
+        {
+            error = "unexpected data after the JSON object.";
+            return false;
+        }
+        return true;
+    }
+
+    std::string                 m_path = std::string();
+    table_format_t              m_format = table_format_t::TABLE_FORMAT_CSV;
+    char                        m_separator = ',';
+    std::string_view            m_data = std::string_view();
+    std::size_t                 m_pos = 0;
+    std::size_t                 m_line = 1;
+    table_fields_t              m_header = table_fields_t();
+};
+
+
+template<typename T, std::size_t ... I>
+bool table_convert_all(
+      std::vector<std::string_view> const & values
+    , std::vector<std::string> const & columns
+    , T & arguments
+    , std::string & error
+    , std::index_sequence<I ...>)
+{
+    std::size_t failed(sizeof...(I));
+    static_cast<void>(((table_convert(values[I], std::get<I>(arguments)) || (failed = I, false)) && ...));
+    if(failed == sizeof...(I))
+    {
+        return true;
+    }
+    error = "cannot convert \""
+          + std::string(values[failed])
+          + "\" of column \""
+          + columns[failed]
+          + "\".";
+    return false;
+}
+
+
+/** \brief Implementation of for_each_row() and for_each_row_parallel().
+ *
+ * \param[in] path  The path to the table file.
+ * \param[in] columns  The names of the columns passed to \p f.
+ * \param[in] f  The function called with each row.
+ * \param[in] parallel  Whether the rows get split across threads.
+ *
+ * \return The number of rows processed.
+ */
+template<typename F>
+std::size_t for_each_row(
+      std::string const & path
+    , std::vector<std::string> const & columns
+    , F f
+    , bool parallel)
+{
+    typedef typename table_function<F>::arguments_t arguments_t;
+    constexpr std::size_t const argument_count(std::tuple_size_v<arguments_t>);
+
+    table_reader reader(path);
+    std::vector<std::string> names(columns);
+    if(names.empty())
+    {
+        if(reader.format() == table_format_t::TABLE_FORMAT_JSON_LINES)
+        {
+            throw std::logic_error("for_each_row() requires the name of the columns of a JSON lines file.");
+        }
+        std::vector<std::string> const header(reader.header());
+        names.assign(header.begin(), header.begin() + std::min(argument_count, header.size()));
+    }
+    if(names.size() != argument_count)
+    {
+        throw std::logic_error(
+                  "for_each_row() got "
+                + std::to_string(names.size())
+                + " columns for a function with "
+                + std::to_string(argument_count)
+                + " parameters.");
+    }
+    std::vector<std::size_t> const indices(
+            reader.format() == table_format_t::TABLE_FORMAT_JSON_LINES
+                ? std::vector<std::size_t>()
+                : reader.column_indices(names));
+
+    std::vector<table_row_t> rows;
+    auto run = [&](std::size_t begin, std::size_t end)
+    {
+        table_fields_t fields;
+        std::vector<std::string_view> values;
+        std::string error;
+        for(std::size_t idx(begin); idx < end; ++idx)
+        {
+            std::string const location(reader.location(rows[idx]));
+            arguments_t arguments;
+            if(!reader.parse_row(rows[idx], fields, error)
+            || !reader.select(fields, names, indices, values, error)
+            || !table_convert_all(
+                      values
+                    , names
+                    , arguments
+                    , error
+                    , std::make_index_sequence<argument_count>()))
+            {
+                CATCH_FAIL_CHECK(location << ": " << error);
+                continue;
+            }
+            CATCH_INFO("row at " << location);
+            std::apply(f, arguments);
+        }
+    };
+
+#ifndef CATCH_CONFIG_THREAD_SAFE_ASSERTIONS
+    // the assertions can only be used from one thread at a time
+    //
+    parallel = false;
+#endif
+
+    std::size_t count(0);
+    while(reader.next_rows(rows, TABLE_ROW_BATCH) > 0)
+    {
+        if(parallel)
+        {
+            parallel_for(rows.size(), run, TABLE_ROW_GRAIN);
+        }
+        else
+        {
+            run(0, rows.size());
+        }
+        count += rows.size();
+    }
+    return count;
+}
+
+
+} // detail namespace
+
+
+/** \brief Run a function with each row of a CSV, TSV or JSON lines file.
+ *
+ * The file is mapped in memory (see fixture_view()) and read one batch
+ * of rows at a time so large tables of test vectors are never loaded as
+ * a whole. A relative \p path is taken from the source directory.
+ *
+ * The named columns are converted to the type of the parameters of \p f
+ * (std::string_view, std::string, bool, integers, floating points or any
+ * type with an `operator >> ()`), in order. If \p columns is empty, the
+ * first columns of the header are used. A std::string_view parameter
+ * is only valid during the call.
+ *
+ * Each call is done with a CATCH_INFO() giving the file and line of the
+ * row so failing assertions tell which row failed. Rows which cannot be
+ * parsed or converted are reported with CATCH_FAIL_CHECK() and skipped.
+ *
+ * The rows are processed in order, in the calling thread. See
+ * for_each_row_parallel() to split them across threads.
+ *
+ * \code
+ *     SNAP_CATCH2_NAMESPACE::for_each_row(
+ *           "tests/vectors/base64.csv"
+ *         , {"input", "encoded"}
+ *         , [](std::string_view input, std::string_view encoded)
+ *           {
+ *               CATCH_CHECK(base64_encode(input) == encoded);
+ *           });
+ * \endcode
+ *
+ * \exception std::runtime_error
+ * The file cannot be read, its format is not supported or a column does
+ * not exist.
+ *
+ * \param[in] path  The path to the table file.
+ * \param[in] columns  The names of the columns passed to \p f.
+ * \param[in] f  The function called with each row.
+ *
+ * \return The number of rows processed.
+ */
+template<typename F>
+std::size_t for_each_row(
+      std::string const & path
+    , std::vector<std::string> const & columns
+    , F f)
+{
+    return detail::for_each_row(path, columns, f, false);
+}
+
+
+/** \brief Run a function with each row of a table file, in parallel.
+ *
+ * This function is the same as for_each_row() except that, when Catch2
+ * was compiled with thread safe assertions, the rows of each batch are
+ * split across threads. \p f must then be safe to call from several
+ * threads at once and must not use CATCH_REQUIRE() since a failure
+ * does not stop the other threads. Without thread safe assertions, the
+ * rows are processed in the calling thread.
+ *
+ * \exception std::runtime_error
+ * The file cannot be read, its format is not supported or a column does
+ * not exist.
+ *
+ * \param[in] path  The path to the table file.
+ * \param[in] columns  The names of the columns passed to \p f.
+ * \param[in] f  The function called with each row.
+ *
+ * \return The number of rows processed.
+ */
+template<typename F>
+std::size_t for_each_row_parallel(
+      std::string const & path
+    , std::vector<std::string> const & columns
+    , F f)
+{
+    return detail::for_each_row(path, columns, f, true);
+}
+
+
+namespace detail
+{
+
+
+/** \brief Exception used to stop a thread on a CATCH_THREAD_REQUIRE().
+ *
+ * Like Catch2's own test failure exception, this one is not derived
+ * from std::exception so it is not caught by the code under test.
+ */
+struct thread_require_failed
+{
+};
+
+
+/** \brief An expression saved for later reporting.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
+class saved_expression final
+    : public Catch::ITransientExpression
+{
+public:
+    saved_expression(bool result, std::string const & text)
+        : ITransientExpression(false, result)
+        , m_text(text)
+    {
+    }
+
+    void streamReconstructedExpression(std::ostream & os) const override
+    {
+        os << m_text;
+    }
+
+private:
+    std::string const &     m_text;
+};
+#pragma GCC diagnostic pop
+
+
+/** \brief The assertion results of one worker thread.
+ *
+ * Only the thread owning the buffer writes to it, so recording a result
+ * does not need a lock. Passing assertions are only counted. Failures
+ * are converted to text in the worker thread and reported by the test
+ * case thread at the next CATCH_MERGE_THREAD_ASSERTIONS().
+ */
+class thread_assertion_buffer
+{
+public:
+    struct failure_t
+    {
+        char const *                        f_macro = nullptr;
+        Catch::SourceLineInfo               f_line = Catch::SourceLineInfo("", 0);
+        bool                                f_has_line = false;
+        char const *                        f_expression = "";
+        std::string                         f_expanded = std::string();
+        Catch::ResultDisposition::Flags     f_disposition = Catch::ResultDisposition::ContinueOnFailure;
+    };
+
+    thread_assertion_buffer(std::size_t thread)
+        : m_thread(thread)
+    {
+    }
+
+    void add(
+          char const * macro
+        , Catch::SourceLineInfo const & line
+        , char const * expression
+        , Catch::ResultDisposition::Flags disposition
+        , Catch::ITransientExpression const & result)
+    {
+        if(result.getResult())
+        {
+            ++m_passed;
+            return;
+        }
+
+        std::stringstream ss;
+        result.streamReconstructedExpression(ss);
+        failure_t f;
+        f.f_macro = macro;
+        f.f_line = line;
+        f.f_has_line = true;
+        f.f_expression = expression;
+        f.f_expanded = ss.str();
+        f.f_disposition = disposition;
+        m_failures.push_back(std::move(f));
+
+        if(disposition == Catch::ResultDisposition::Normal)
+        {
+            throw thread_require_failed();
+        }
+    }
+
+    template<typename T>
+    void add(
+          char const * macro
+        , Catch::SourceLineInfo const & line
+        , char const * expression
+        , Catch::ResultDisposition::Flags disposition
+        , Catch::ExprLhs<T> const & lhs)
+    {
+        add(macro, line, expression, disposition, lhs.makeUnaryExpr());
+    }
+
+    void add_exception(std::string const & message)
+    {
+        failure_t f;
+        f.f_macro = "CATCH_MERGE_THREAD_ASSERTIONS";
+        f.f_expanded = "unexpected exception: " + message;
+        m_failures.push_back(std::move(f));
+    }
+
+    std::size_t thread() const
+    {
+        return m_thread;
+    }
+
+    std::uint64_t passed() const
+    {
+        return m_passed;
+    }
+
+    std::vector<failure_t> const & failures() const
+    {
+        return m_failures;
+    }
+
+private:
+    std::size_t             m_thread = 0;
+    std::uint64_t           m_passed = 0;
+    std::vector<failure_t>  m_failures = std::vector<failure_t>();
+};
+
+
+inline thread_assertion_buffer * & current_thread_buffer()
+{
+    static thread_local thread_assertion_buffer * buffer = nullptr;
+
+    return buffer;
+}
+
+
+} // detail namespace
+
+
+/** \brief Collect the assertions of worker threads.
+ *
+ * Catch2 assertions are not safe to use from worker threads unless
+ * Catch2 was compiled with thread safe assertions and then each assertion
+ * takes a global lock. This class gives each worker thread its own buffer
+ * instead. The CATCH_THREAD_CHECK() and CATCH_THREAD_REQUIRE() macros
+ * record their results there and the CATCH_MERGE_THREAD_ASSERTIONS()
+ * macro reports them in the running test case once the threads were
+ * joined.
+ *
+ * \code
+ *     SNAP_CATCH2_NAMESPACE::thread_assertions results;
+ *     std::thread t(results.wrap([&]()
+ *         {
+ *             CATCH_THREAD_CHECK(queue.pop() == 5);
+ *         }));
+ *     t.join();
+ *     CATCH_MERGE_THREAD_ASSERTIONS(results);
+ * \endcode
+ */
+class thread_assertions
+{
+public:
+    thread_assertions()
+    {
+    }
+
+    thread_assertions(thread_assertions const &) = delete;
+    thread_assertions & operator = (thread_assertions const &) = delete;
+
+    /** \brief Wrap the function run by a worker thread.
+     *
+     * The returned function attaches a new buffer to the thread, runs
+     * \p f and detaches the buffer. A failed CATCH_THREAD_REQUIRE()
+     * stops \p f and any other exception is recorded as a failure.
+     *
+     * \param[in] f  The function to run in the worker thread.
+     *
+     * \return A function to pass to std::thread.
+     */
+    template<typename F>
+    auto wrap(F f)
+    {
+        return [this, f]() mutable
+        {
+            detail::thread_assertion_buffer * buffer(attach());
+            try
+            {
+                f();
+            }
+            catch(detail::thread_require_failed const &)
+            {
+            }
+            catch(std::exception const & e)
+            {
+                buffer->add_exception(e.what());
+            }
+            catch(...)
+            {
+                buffer->add_exception("unknown exception");
+            }
+            detail::current_thread_buffer() = nullptr;
+        };
+    }
+
+    /** \brief Report the buffered results in the current test case.
+     *
+     * Each failure is reported at the line of its assertion. Then one
+     * more assertion summarizes the results; it fails (and ends the
+     * test case) if any worker assertion failed. The buffers are cleared
+     * so the object can be reused for the next batch of threads.
+     *
+     * Only call this function from the test case thread once all the
+     * worker threads were joined.
+     *
+     * \param[in] line  The location of the merge.
+     * \param[in] expression  The name of this object at the merge.
+     */
+    void merge(Catch::SourceLineInfo const & line, char const * expression)
+    {
+        std::vector<std::unique_ptr<detail::thread_assertion_buffer>> buffers;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            buffers.swap(m_buffers);
+        }
+
+        std::uint64_t passed(0);
+        std::uint64_t failed(0);
+        for(auto const & b : buffers)
+        {
+            passed += b->passed();
+            for(auto const & f : b->failures())
+            {
+                ++failed;
+                std::string const text(f.f_expanded + "\nin thread " + std::to_string(b->thread()));
+                Catch::AssertionHandler handler(
+                          Catch::StringRef(f.f_macro)
+                        , f.f_has_line ? f.f_line : line
+                        , Catch::StringRef(f.f_has_line ? f.f_expression : expression)
+                        , Catch::ResultDisposition::ContinueOnFailure);
+                handler.handleExpr(detail::saved_expression(false, text));
+                handler.complete();
+            }
+        }
+
+        std::string const summary(
+                  std::to_string(passed + failed)
+                + " assertions in "
+                + std::to_string(buffers.size())
+                + " threads, "
+                + std::to_string(failed)
+                + " failed");
+        Catch::AssertionHandler handler(
+                  "CATCH_MERGE_THREAD_ASSERTIONS"_catch_sr
+                , line
+                , Catch::StringRef(expression)
+                , Catch::ResultDisposition::Normal);
+        handler.handleExpr(detail::saved_expression(failed == 0, summary));
+        handler.complete();
+    }
+
+private:
+    detail::thread_assertion_buffer * attach()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_buffers.push_back(std::make_unique<detail::thread_assertion_buffer>(m_next_thread++));
+        detail::current_thread_buffer() = m_buffers.back().get();
+        return m_buffers.back().get();
+    }
+
+    std::mutex                                                      m_mutex = std::mutex();
+    std::size_t                                                     m_next_thread = 0;
+    std::vector<std::unique_ptr<detail::thread_assertion_buffer>>   m_buffers = std::vector<std::unique_ptr<detail::thread_assertion_buffer>>();
+};
+
+
+/** \brief An HDR style histogram of latencies.
+ *
+ * The values (nanoseconds) are saved in log-linear buckets: each power
+ * of two is cut in 64 buckets so the precision is better than 1.6%
+ * over the entire 64 bit range while the histogram remains small enough
+ * to record every single call.
+ */
+class latency_histogram
+{
+public:
+    static constexpr int const          SUB_BUCKET_BITS = 7;
+    static constexpr std::uint64_t const SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+    static constexpr std::uint64_t const SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr std::size_t const  BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF;
+
+    void record(std::uint64_t value)
+    {
+        ++m_counts[bucket(value)];
+        ++m_count;
+        m_total += value;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    std::uint64_t count() const
+    {
+        return m_count;
+    }
+
+    std::uint64_t min() const
+    {
+        return m_count == 0 ? 0 : m_min;
+    }
+
+    std::uint64_t max() const
+    {
+        return m_max;
+    }
+
+    double mean() const
+    {
+        return m_count == 0 ? 0.0 : static_cast<double>(m_total) / static_cast<double>(m_count);
+    }
+
+    /** \brief Get the value at a given percentile.
+     *
+     * \param[in] p  The percentile, from 0.0 to 100.0.
+     *
+     * \return The highest value equivalent to the one at that percentile.
+     */
+    std::uint64_t percentile(double p) const
+    {
+        if(m_count == 0)
+        {
+            return 0;
+        }
+        std::uint64_t const rank(std::max<std::uint64_t>(1, static_cast<std::uint64_t>(
+                std::ceil(std::min(std::max(p, 0.0), 100.0) / 100.0 * static_cast<double>(m_count)))));
+        std::uint64_t seen(0);
+        for(std::size_t idx(0); idx < BUCKET_COUNT; ++idx)
+        {
+            seen += m_counts[idx];
+            if(seen >= rank)
+            {
+                return std::min(highest_value(idx), m_max);
+            }
+        }
+        return m_max;
+    }
+
+private:
+    static std::size_t bucket(std::uint64_t value)
+    {
+        if(value < SUB_BUCKET_COUNT)
+        {
+            return static_cast<std::size_t>(value);
+        }
+        int const shift(63 - __builtin_clzll(value) - (SUB_BUCKET_BITS - 1));
+        return static_cast<std::size_t>(static_cast<std::uint64_t>(shift) * SUB_BUCKET_HALF + (value >> shift));
+    }
+
+    static std::uint64_t highest_value(std::size_t idx)
+    {
+        if(idx < SUB_BUCKET_COUNT)
+        {
+            return idx;
+        }
+        std::uint64_t const shift(idx / SUB_BUCKET_HALF - 1);
+        std::uint64_t const sub(idx - shift * SUB_BUCKET_HALF);
+        return (sub << shift) + ((1ULL << shift) - 1);
+    }
+
+    std::vector<std::uint64_t>  m_counts = std::vector<std::uint64_t>(BUCKET_COUNT);
+    std::uint64_t               m_count = 0;
+    std::uint64_t               m_total = 0;
+    std::uint64_t               m_min = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t               m_max = 0;
+};
+
+
+/** \brief One percentile of a latency measurement.
+ *
+ * This object compares against std::chrono durations so it can be used
+ * directly in an assertion:
+ *
+ * \code
+ *     CATCH_REQUIRE_LATENCY(latency.p99() < 50us);
+ * \endcode
+ */
+struct latency_percentile
+{
+    std::string                                 f_name = std::string();
+    double                                      f_percentile = 0.0;
+    std::chrono::nanoseconds                    f_value = std::chrono::nanoseconds();
+    std::shared_ptr<latency_histogram const>    f_histogram = std::shared_ptr<latency_histogram const>();
+};
+
+
+template<typename Rep, typename Period>
+bool operator < (latency_percentile const & lhs, std::chrono::duration<Rep, Period> const & rhs)
+{
+    return lhs.f_value < rhs;
+}
+
+
+template<typename Rep, typename Period>
+bool operator <= (latency_percentile const & lhs, std::chrono::duration<Rep, Period> const & rhs)
+{
+    return lhs.f_value <= rhs;
+}
+
+
+template<typename Rep, typename Period>
+bool operator > (latency_percentile const & lhs, std::chrono::duration<Rep, Period> const & rhs)
+{
+    return lhs.f_value > rhs;
+}
+
+
+template<typename Rep, typename Period>
+bool operator >= (latency_percentile const & lhs, std::chrono::duration<Rep, Period> const & rhs)
+{
+    return lhs.f_value >= rhs;
+}
+
+
+namespace detail
+{
+
+
+inline void write_latency_table(std::ostream & out, std::string const & name, latency_histogram const & histogram)
+{
+    std::stringstream ss;
+    ss << "latency \""
+       << name
+       << "\": "
+       << histogram.count()
+       << " calls, min "
+       << histogram.min()
+       << "ns, mean "
+       << std::fixed << std::setprecision(1) << histogram.mean()
+       << "ns";
+    ss << std::defaultfloat << std::setprecision(6);
+    for(double const p : { 50.0, 90.0, 99.0, 99.9, 99.99, 100.0 })
+    {
+        ss << "\n  p"
+           << std::left << std::setw(7) << p
+           << std::right << std::setw(14) << histogram.percentile(p)
+           << " ns";
+    }
+    out << ss.str();
+}
+
+
+} // detail namespace
+
+
+/** \brief Print a percentile.
+ *
+ * Catch2 uses this operator to show a percentile in the expansion of an
+ * assertion, so a failure also shows the whole percentile table.
+ */
+inline std::ostream & operator << (std::ostream & out, latency_percentile const & p)
+{
+    out << "p" << p.f_percentile << " of \"" << p.f_name << "\" = " << p.f_value.count() << "ns";
+    if(p.f_histogram != nullptr)
+    {
+        out << "\n";
+        detail::write_latency_table(out, p.f_name, *p.f_histogram);
+    }
+    return out;
+}
+
+
+/** \brief The result of a CATCH_MEASURE_LATENCY().
+ */
+class latency_result
+{
+public:
+    latency_result(std::string const & name, latency_histogram const & histogram)
+        : m_name(name)
+        , m_histogram(std::make_shared<latency_histogram const>(histogram))
+    {
+    }
+
+    std::string const & name() const
+    {
+        return m_name;
+    }
+
+    latency_histogram const & histogram() const
+    {
+        return *m_histogram;
+    }
+
+    latency_percentile percentile(double p) const
+    {
+        return latency_percentile{
+                  m_name
+                , p
+                , std::chrono::nanoseconds(m_histogram->percentile(p))
+                , m_histogram
+            };
+    }
+
+    latency_percentile p50() const
+    {
+        return percentile(50.0);
+    }
+
+    latency_percentile p90() const
+    {
+        return percentile(90.0);
+    }
+
+    latency_percentile p99() const
+    {
+        return percentile(99.0);
+    }
+
+    latency_percentile p999() const
+    {
+        return percentile(99.9);
+    }
+
+    latency_percentile max() const
+    {
+        return percentile(100.0);
+    }
+
+    /** \brief Write the percentile table.
+     *
+     * \param[in] out  The output stream.
+     */
+    void report(std::ostream & out) const
+    {
+        detail::write_latency_table(out, m_name, *m_histogram);
+        out << std::endl;
+    }
+
+    /** \brief Save the percentile table to a file.
+     *
+     * The file is a CSV file with one line per percentile so it can be
+     * kept along your benchmark baselines and compared between runs.
+     *
+     * \param[in] filename  The name of the output file.
+     *
+     * \return true if the file was saved.
+     */
+    bool save(std::string const & filename) const
+    {
+        std::ofstream out(filename);
+        out << "percentile,nanoseconds\n";
+        for(double const p : { 50.0, 75.0, 90.0, 99.0, 99.9, 99.99, 100.0 })
+        {
+            out << p << ',' << m_histogram->percentile(p) << '\n';
+        }
+        out.close();
+        return !out.fail();
+    }
+
+private:
+    std::string                                 m_name = std::string();
+    std::shared_ptr<latency_histogram const>    m_histogram = std::shared_ptr<latency_histogram const>();
+};
+
+
+namespace detail
+{
+
+
+/** \brief A low overhead clock for latency measurements.
  *
- *     int finish_init(Catch::Session & session)
- *     {
- *         std::string cmd("rm -rf ");
- *         cmd += g_conf_dir;
- *         cmd += "/my-project";
- *         if(system(cmd.c_str()) != 0)
- *         {
- *             perror(cmd.c_str());
- *             return 1;
- *         }
+ * On x86, the time stamp counter is used and converted to nanoseconds
+ * using a factor calibrated once against the steady clock. Other
+ * platforms use the steady clock directly.
  *
- *         return 0;
- *     }
+ * The `rdtsc` instruction is not serializing so the CPU may execute it
+ * before the end of the previous instructions or after the start of
+ * the following ones. The start() function waits for the previous
+ * instructions with an `lfence` and the stop() function uses `rdtscp`,
+ * which waits for the measured code, followed by an `lfence` so the
+ * following instructions do not start early.
+ */
+class latency_clock
+{
+public:
+    static std::uint64_t start()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_lfence();
+        std::uint64_t const ticks(__rdtsc());
+        _mm_lfence();
+        return ticks;
+#else
+        return steady_now();
+#endif
+    }
+
+    static std::uint64_t stop()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int aux(0);
+        std::uint64_t const ticks(__rdtscp(&aux));
+        _mm_lfence();
+        return ticks;
+#else
+        return steady_now();
+#endif
+    }
+
+    static double nanoseconds_per_tick()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        static double const factor([]()
+            {
+                auto const start(std::chrono::steady_clock::now());
+                std::uint64_t const start_ticks(__rdtsc());
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                std::uint64_t const end_ticks(__rdtsc());
+                auto const end(std::chrono::steady_clock::now());
+                return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count())
+                     / static_cast<double>(end_ticks - start_ticks);
+            }());
+        return factor;
+#else
+        return 1.0;
+#endif
+    }
+
+private:
+    static std::uint64_t steady_now()
+    {
+        return static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+};
+
+
+inline std::string latency_filename(std::string const & name)
+{
+    std::string result((g_binary_dir().empty() ? std::string(".") : g_binary_dir()) + "/latency-");
+    for(auto const c : name)
+    {
+        result += std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ? c : '_';
+    }
+    return result + ".csv";
+}
+
+
+} // detail namespace
+
+
+/** \brief Measure the latency of each call of a function.
  *
- *     }
+ * This function calls \p body \p iterations times and records the
+ * duration of each call in a latency_histogram. The percentile table is
+ * attached to the next assertion (CATCH_UNSCOPED_INFO()) so it shows
+ * when that assertion fails or with `-s`. With `--save-latency`, the
+ * table is also saved in `latency-<name>.csv` in the binary directory
+ * (see `--binary-dir`); a failure to save it is reported as a warning.
  *
- *     ...snip...
+ * \param[in] name  The name of the measurement.
+ * \param[in] iterations  The number of calls.
+ * \param[in] body  The function to measure.
  *
- *     snap_catch2_main(
- *           "libutf8"
- *         , "1.2.3"
- *         , argc
- *         , argv
- *         , nullptr
- *         , nullptr
- *         , &finish_init
- *     );
- * \endcode
+ * \return The result, used to check percentiles.
+ */
+template<typename F>
+latency_result measure_latency(std::string const & name, std::uint64_t iterations, F body)
+{
+    // make sure the calibration does not happen within the measurements
+    //
+    double const factor(detail::latency_clock::nanoseconds_per_tick());
+
+    latency_histogram histogram;
+    for(std::uint64_t idx(0); idx < iterations; ++idx)
+    {
+        std::uint64_t const start(detail::latency_clock::start());
+        body();
+        std::uint64_t const end(detail::latency_clock::stop());
+        histogram.record(static_cast<std::uint64_t>(static_cast<double>(end - start) * factor));
+    }
+
+    latency_result const result(name, histogram);
+    std::stringstream table;
+    detail::write_latency_table(table, name, histogram);
+    CATCH_UNSCOPED_INFO(table.str());
+    if(g_save_latency())
+    {
+        std::string const filename(detail::latency_filename(name));
+        if(!result.save(filename))
+        {
+            CATCH_WARN("could not save latency table to \"" << filename << "\".");
+        }
+    }
+    return result;
+}
+
+
+/** \brief An in-process stand-in server.
  *
- * Once the tests ran, we call the \p finished_callback as well. This gives
- * you the ability to test futher things such as making sure that everything
- * was cleaned up, resources released, etc. For example, in our advgetopt
- * we use a FIFO to handle error messages. If an error never occurs that
- * FIFO will not be empty on exit. This is actually an error in the test.
- * Only errors that do occur have to be added to the FIFO. So on exit we
- * want to verify that the FIFO is indeed empty.
+ * This class creates a server listening on an ephemeral TCP port of the
+ * loopback interface, on a Unix socket created under g_tmp_dir(), or on
+ * one end of a socketpair(). Since nothing is fixed, many tests can run
+ * such servers concurrently.
  *
- * \param[in] project_name  The name of the project (i.e. "libutf8").
- * \param[in] project_version  The version string of the project
- *                     (i.e. "LIBUTF8_VERSION_STRING").
- * \param[in] argc  The number of arguments on the command line.
- * \param[in] argv  An array of strings with the command line arguments.
- * \param[in] init_callback  Callback called before anything else.
- * \param[in] add_user_options  A callback giving you the opportunity to add
- *                              command line options before argv gets parsed.
- * \param[in] callback  A callback called just before we run the tests.
- * \param[in] finished_callback  The callback called just after all the tests
- *                               ran.
+ * The server runs on its own thread using epoll. The data received on
+ * a connection is passed to the handler which returns the number of
+ * bytes it consumed (0 if it needs more data) and appends its reply to
+ * the output. Each connection gets its own copy of the handler so a
+ * handler can keep per connection state.
  *
- * \return The exit code, usually 0 on success and 1 on an error.
+ * If the handler throws, the error is recorded (see failures()) and the
+ * connection is closed.
+ *
+ * \code
+ *     SNAP_CATCH2_NAMESPACE::local_server server(
+ *               SNAP_CATCH2_NAMESPACE::local_server::type_t::TYPE_TCP
+ *             , SNAP_CATCH2_NAMESPACE::script_handler({
+ *                   { "HELLO\n", "WELCOME\n" },
+ *                   { "QUIT\n", "BYE\n" },
+ *               }));
+ *     my_client client("127.0.0.1", server.port());
+ *     ...
+ *     CATCH_REQUIRE(server.failures().empty());
+ * \endcode
  */
-inline int snap_catch2_main(
-          char const * project_name
-        , char const * project_version
-        , int argc
-        , char * argv[]
-        , void (*init_callback)() = nullptr
-        , void (*add_user_options)(Catch::Clara::Parser & cli) = nullptr
-        , int (*callback)(Catch::Session & session) = nullptr
-        , void (*finished_callback)() = nullptr)
+class local_server
 {
-    typedef unsigned int seed_t; // see `man srand(3)` for type
+public:
+    typedef std::function<std::size_t(std::string_view input, std::string & output)>  handler_t;
 
-    try
+    enum class type_t
     {
-        if(init_callback != nullptr)
+        TYPE_TCP,
+        TYPE_UNIX,
+        TYPE_PAIR,
+    };
+
+    struct stats_t
+    {
+        std::uint64_t       f_connections = 0;
+        std::uint64_t       f_requests = 0;
+        std::uint64_t       f_bytes_in = 0;
+        std::uint64_t       f_bytes_out = 0;
+    };
+
+    local_server(type_t type, handler_t handler)
+        : m_type(type)
+        , m_handler(handler)
+    {
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_stop = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if(m_epoll == -1
+        || m_stop == -1)
         {
-            init_callback();
+            close_all();
+            throw std::runtime_error("could not create the local server event loop.");
         }
+        watch(m_stop);
 
-        Catch::Session session;
+        try
+        {
+            switch(m_type)
+            {
+            case type_t::TYPE_TCP:
+                listen_tcp();
+                break;
 
-        bool version(false);
-        seed_t seed(static_cast<seed_t>(time(NULL)));
+            case type_t::TYPE_UNIX:
+                listen_unix();
+                break;
 
-        auto cli = session.cli();
-        cli |= Catch::Clara::Opt(seed, "seed")
-                    ["-S"]["--seed"]
-                    ("value to seed the randomizer, if not specified, use time()")
-                 | Catch::Clara::Opt(g_progress())
-                    ["-p"]["--progress"]
-                    ("print name of test section being run")
-                 | Catch::Clara::Opt(g_source_dir(), "source_dir")
-                    ["--source-dir"]
-                    ("specify the full path to the source directory")
-                 | Catch::Clara::Opt(g_binary_dir(), "binary_dir")
-                    ["--binary-dir"]
-                    ("specify the full path to the binary directory")
-                 | Catch::Clara::Opt(g_dist_dir(), "dist_dir")
-                    ["--dist-dir"]
-                    ("specify the full path to the dist directory")
-                 | Catch::Clara::Opt(g_tmp_dir(), "tmp_dir")
-                    ["-T"]["--tmp-dir"]
-                    ("specify a temporary directory")
-                 | Catch::Clara::Opt(g_verbose())
-                    ["--verbose"]
-                    ("print additional information from within our own tests")
-                 | Catch::Clara::Opt(version)
-                    ["-V"]["--version"]
-                    ("print out the libutf8 library version these unit tests pertain to");
+            case type_t::TYPE_PAIR:
+                {
+                    int fds[2] = { -1, -1 };
+                    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+                    {
+                        throw std::runtime_error("could not create a socket pair for the local server.");
+                    }
+                    m_client = fds[1];
+                    add_connection(fds[0]);
+                }
+                break;
 
-        if(add_user_options != nullptr)
+            }
+        }
+        catch(...)
         {
-            add_user_options(cli);
+            close_all();
+            throw;
         }
 
-        session.cli(cli);
+        m_thread = std::thread(&local_server::run, this);
+    }
 
-        if(session.applyCommandLine(argc, argv) != 0)
-        {
-            std::cerr << "fatal error: invalid command line." << std::endl;
-            return 1;
-        }
+    local_server(local_server const &) = delete;
+    local_server & operator = (local_server const &) = delete;
 
-        if(version)
+    ~local_server()
+    {
+        std::uint64_t const one(1);
+        if(write(m_stop, &one, sizeof(one)) != sizeof(one))
         {
-            std::cout << project_version << std::endl;
-            return 0;
+            std::cerr << "warning: could not stop the local server thread.\n";
         }
+        m_thread.join();
+        close_all();
+    }
 
-        // also turn on verbosity if the VERBOSE environment variable
-        // is set to a value other than 0, false, off
-        //
-        char const * verbose(getenv("VERBOSE"));
-        if(verbose != nullptr)
+    type_t type() const
+    {
+        return m_type;
+    }
+
+    /** \brief The TCP port the server listens on.
+     *
+     * \return The port or 0 if this is not a TCP server.
+     */
+    int port() const
+    {
+        return m_port;
+    }
+
+    /** \brief The path of the Unix socket.
+     *
+     * \return The path or an empty string if this is not a Unix server.
+     */
+    std::string const & path() const
+    {
+        return m_path;
+    }
+
+    /** \brief Connect a new client to the server.
+     *
+     * For a socketpair() server, this function returns the client end
+     * of the pair the first time and throws afterward. The caller owns
+     * the returned socket and must close it.
+     *
+     * \return A blocking socket connected to the server.
+     */
+    int connect()
+    {
+        if(m_type == type_t::TYPE_PAIR)
         {
-            if(strcmp(verbose, "0") != 0
-            && strcmp(verbose, "false") != 0
-            && strcmp(verbose, "off") != 0)
+            if(m_client == -1)
             {
-                g_verbose() = true;
+                throw std::logic_error("the client end of a socket pair can only be retrieved once.");
             }
+            int const fd(m_client);
+            m_client = -1;
+            return fd;
         }
-        if(g_verbose())
+
+        int const fd(socket(m_type == type_t::TYPE_TCP ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if(fd == -1)
         {
-            std::cout << "info: verbosity activated." << std::endl;
+            throw std::runtime_error("could not create a client socket.");
+        }
+        int r(-1);
+        if(m_type == type_t::TYPE_TCP)
+        {
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<std::uint16_t>(m_port));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            r = ::connect(fd, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr));
         }
+        else
+        {
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path) - 1);
+            r = ::connect(fd, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr));
+        }
+        if(r != 0)
+        {
+            close(fd);
+            throw std::runtime_error("could not connect to the local server.");
+        }
+        return fd;
+    }
 
-        detail::init_tmp_dir(project_name);
+    stats_t stats() const
+    {
+        stats_t result;
+        result.f_connections = m_connections_count.load();
+        result.f_requests = m_requests.load();
+        result.f_bytes_in = m_bytes_in.load();
+        result.f_bytes_out = m_bytes_out.load();
+        return result;
+    }
 
-        // by default we get a different seed each time; that really helps
-        // in detecting errors! At least it helped me many times.
-        //
-        srand(seed);
-        srand48(seed);
+    std::vector<std::string> failures() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_failures;
+    }
 
-        // save the seed, it can be practical opposed to searching your
-        // test output
-        //
+private:
+    struct connection_t
+    {
+        handler_t       f_handler = handler_t();
+        std::string     f_input = std::string();
+        std::string     f_output = std::string();
+        bool            f_eof = false;
+    };
+
+    void watch(int fd, std::uint32_t events = EPOLLIN)
+    {
+        epoll_event e = {};
+        e.events = events;
+        e.data.fd = fd;
+        if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &e) != 0)
         {
-            std::ofstream seed_file;
-            seed_file.open("seed.txt");
-            if(seed_file.is_open())
-            {
-                seed_file << seed << std::endl;
-            }
+            throw std::runtime_error("could not add a socket to the local server event loop.");
         }
+    }
 
-        if(callback != nullptr)
+    void listen_tcp()
+    {
+        m_listen = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if(m_listen == -1)
         {
-            int const e(callback(session));
-            if(e != 0)
-            {
-                return e;
-            }
+            throw std::runtime_error("could not create the local server TCP socket.");
         }
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = 0;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t size(sizeof(addr));
+        if(bind(m_listen, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) != 0
+        || listen(m_listen, SOMAXCONN) != 0
+        || getsockname(m_listen, reinterpret_cast<sockaddr *>(&addr), &size) != 0)
+        {
+            throw std::runtime_error("could not listen on an ephemeral TCP port.");
+        }
+        m_port = ntohs(addr.sin_port);
+        watch(m_listen);
+    }
 
-        std::cout << project_name
-                  << " v"
-                  << project_version
-                  << " ["
-                  << getpid()
-                  << "]:unittest: seed is "
-                  << seed
-                  << "\n"
-                     "source directory: \""
-                  << g_source_dir()
-                  << "\"\n"
-                     "binary directory: \""
-                  << g_binary_dir()
-                  << "\"\n"
-                     "dist directory: \""
-                  << g_dist_dir()
-                  << "\"\n"
-                     "temporary directory: \""
-                  << g_tmp_dir()
-                  << "\""
-                  << std::endl;
-
-        auto const r(session.run());
-
-        if(finished_callback != nullptr)
+    void listen_unix()
+    {
+        static std::atomic<int> counter(0);
+
+        m_path = (g_tmp_dir().empty() ? std::string("/tmp") : g_tmp_dir())
+               + "/local-server-"
+               + std::to_string(getpid())
+               + "-"
+               + std::to_string(++counter)
+               + ".sock";
+        sockaddr_un addr = {};
+        if(m_path.length() >= sizeof(addr.sun_path))
         {
-            finished_callback();
+            std::string const path(m_path);
+            m_path.clear();
+            throw std::runtime_error("Unix socket path \"" + path + "\" is too long.");
         }
-
-        return r;
+        m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if(m_listen == -1)
+        {
+            throw std::runtime_error("could not create the local server Unix socket.");
+        }
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(m_path.c_str());
+        if(bind(m_listen, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) != 0
+        || listen(m_listen, SOMAXCONN) != 0)
+        {
+            throw std::runtime_error("could not listen on Unix socket \"" + m_path + "\".");
+        }
+        watch(m_listen);
     }
-    catch(std::logic_error const & e)
+
+    void add_connection(int fd)
     {
-        std::cerr << "fatal error: caught a logic error in "
-                  << project_name
-                  << " unit tests: "
-                  << e.what()
-                  << "\n";
-        return 1;
+        int const flags(fcntl(fd, F_GETFL));
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        connection_t c;
+        c.f_handler = m_handler;
+        m_connections[fd] = std::move(c);
+        ++m_connections_count;
+        watch(fd);
     }
-    catch(std::runtime_error const & e)
+
+    void close_connection(int fd)
     {
-        std::cerr << "fatal error: caught a run-time error in "
-                  << project_name
-                  << " unit tests: "
-                  << e.what()
-                  << "\n";
-        return 1;
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        m_connections.erase(fd);
     }
-    catch(std::exception const & e)
+
+    void failed(std::string const & message)
     {
-        std::cerr << "fatal error: caught a standard exception in "
-                  << project_name
-                  << " unit tests: "
-                  << e.what()
-                  << "\n";
-        return 1;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failures.push_back(message);
     }
-}
-#endif
-
 
-
-inline void catch_compare_long_strings(std::string const & a, std::string const & b)
-{
-    auto print_char = [](char c)
+    /** \brief Send the pending output of a connection.
+     *
+     * Once the client closed its side of the connection, only the output
+     * remains to be sent and the connection is done once it is empty.
+     *
+     * \return false if the connection broke or is done.
+     */
+    bool flush(int fd, connection_t & c)
     {
-        if(c == 0x20)
+        while(!c.f_output.empty())
         {
-            // Possible characters to make spaces visible are:
-            //      U+23B5      BOTTOM SQUARE BRACKET
-            //      U+2420      SYMBOL FOR SPACE
-            //      U+2423      OPEN BOX
-            //
-            std::cout << "\xE2\x90\xA3";
+            ssize_t const r(send(fd, c.f_output.data(), c.f_output.length(), MSG_NOSIGNAL));
+            if(r < 0)
+            {
+                if(errno == EAGAIN)
+                {
+                    break;
+                }
+                return errno == EINTR;
+            }
+            m_bytes_out += static_cast<std::uint64_t>(r);
+            c.f_output.erase(0, static_cast<std::size_t>(r));
         }
-        else if(static_cast<unsigned char>(c) < 0x20)
+
+        if(c.f_eof)
         {
-            // control character
+            if(c.f_output.empty())
+            {
+                return false;
+            }
+
+            // EPOLLIN would fire again and again on the end of the input
             //
-            std::cout << '^' << static_cast<char>(c + 0x40);
+            epoll_event e = {};
+            e.events = EPOLLOUT;
+            e.data.fd = fd;
+            epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &e);
+            return true;
         }
-        else if(static_cast<unsigned char>(c) < 0x80)
+
+        // only ask for EPOLLOUT while some output is pending
+        //
+        epoll_event e = {};
+        e.events = c.f_output.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+        e.data.fd = fd;
+        epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &e);
+        return true;
+    }
+
+    /** \brief Read and process the data available on a connection.
+     *
+     * When the client closes its side of the connection, the data read
+     * so far still goes through the handler and the replies are sent
+     * before the connection gets closed.
+     *
+     * \return false if the connection is closed.
+     */
+    bool receive(int fd, connection_t & c)
+    {
+        char buf[64 * 1024];
+        for(;;)
         {
-            // standard character
-            //
-            std::cout << c;
+            ssize_t const r(read(fd, buf, sizeof(buf)));
+            if(r == 0)
+            {
+                c.f_eof = true;
+                break;
+            }
+            if(r < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                if(errno != EAGAIN)
+                {
+                    return false;
+                }
+                break;
+            }
+            m_bytes_in += static_cast<std::uint64_t>(r);
+            c.f_input.append(buf, static_cast<std::size_t>(r));
         }
-        else if(static_cast<unsigned char>(c) < 0xA0)
+
+        try
         {
-            // graphical control
-            //
-            std::cout << '@' << static_cast<char>(c - 0x40);
+            std::size_t pos(0);
+            while(pos < c.f_input.length())
+            {
+                std::size_t const used(c.f_handler(std::string_view(c.f_input).substr(pos), c.f_output));
+                if(used == 0)
+                {
+                    break;
+                }
+                ++m_requests;
+                pos += used;
+            }
+            c.f_input.erase(0, pos);
         }
-        else
+        catch(std::exception const & e)
         {
-            // UTF-8 characters cannot be written as is since we are breaking
-            // up the string into bytes instead of characters; so instead show
-            // the corresponding \xXX value
-            //
-            std::cout << "\\x" << std::hex << static_cast<int>(static_cast<std::uint8_t>(c));
+            failed(e.what());
+            return false;
         }
-    };
 
-    if(a != b)
-    {
-        std::cout << "error: long strings do not match.\n"
-                  << "---------------------------------------------------\n";
+        return flush(fd, c);
+    }
 
-        // TODO: we may want to look into supporting UTF-8 properly
-        //
-        std::size_t const max(std::min(a.length(), b.length()));
-        bool err(false);
-        for(std::size_t idx(0); idx < max; ++idx)
+    void run()
+    {
+        epoll_event events[64];
+        for(;;)
         {
-            if(a[idx] == b[idx])
+            int const count(epoll_wait(m_epoll, events, 64, -1));
+            if(count < 0)
             {
-                if(err)
+                if(errno == EINTR)
                 {
-                    err = false;
-                    std::cout << "\033[0m";
+                    continue;
                 }
-                std::cout << a[idx];
+                failed("epoll_wait() failed.");
+                return;
             }
-            else
+            for(int idx(0); idx < count; ++idx)
             {
-                if(!err)
+                int const fd(events[idx].data.fd);
+                if(fd == m_stop)
                 {
-                    err = true;
-                    std::cout << "\033[7m";
+                    return;
+                }
+                if(fd == m_listen)
+                {
+                    for(;;)
+                    {
+                        int const client(accept4(m_listen, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK));
+                        if(client == -1)
+                        {
+                            break;
+                        }
+                        add_connection(client);
+                    }
+                    continue;
+                }
+
+                auto const it(m_connections.find(fd));
+                if(it == m_connections.end())
+                {
+                    continue;
+                }
+                bool ok(true);
+                if((events[idx].events & EPOLLOUT) != 0)
+                {
+                    ok = flush(fd, it->second);
+                }
+                if(ok && (events[idx].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0)
+                {
+                    ok = receive(fd, it->second);
+                }
+                if(!ok)
+                {
+                    close_connection(fd);
                 }
-                std::cout << '[';
-                print_char(a[idx]);
-                std::cout << '/';
-                print_char(b[idx]);
-                std::cout << ']';
             }
         }
-        if(err)
+    }
+
+    void close_all()
+    {
+        for(auto const & c : m_connections)
         {
-            err = false;
-            std::cout << "\033[0m";
+            close(c.first);
         }
-
-        std::cout << std::endl
-                  << "---------------------------------------------------" << std::endl;
-
-        if(a.length() > b.length())
+        m_connections.clear();
+        for(int * fd : { &m_listen, &m_client, &m_stop, &m_epoll })
         {
-            std::cout << "Left hand side string is longer ("
-                      << a.length()
-                      << " versus "
-                      << b.length()
-                      << ")."
-                      << std::endl;
+            if(*fd != -1)
+            {
+                close(*fd);
+                *fd = -1;
+            }
         }
-        else if(b.length() > a.length())
+        if(!m_path.empty())
         {
-            std::cout << "Right hand side string is longer ("
-                      << a.length()
-                      << " versus "
-                      << b.length()
-                      << ")."
-                      << std::endl;
+            unlink(m_path.c_str());
         }
     }
 
-    // to generate the standard error too
-    //
-    CATCH_REQUIRE(a == b);
-}
+    type_t                              m_type = type_t::TYPE_TCP;
+    handler_t                           m_handler = handler_t();
+    int                                 m_epoll = -1;
+    int                                 m_stop = -1;
+    int                                 m_listen = -1;
+    int                                 m_client = -1;
+    int                                 m_port = 0;
+    std::string                         m_path = std::string();
+    std::map<int, connection_t>         m_connections = std::map<int, connection_t>();
+    std::thread                         m_thread = std::thread();
+    mutable std::mutex                  m_mutex = std::mutex();
+    std::vector<std::string>            m_failures = std::vector<std::string>();
+    std::atomic<std::uint64_t>          m_connections_count = 0;
+    std::atomic<std::uint64_t>          m_requests = 0;
+    std::atomic<std::uint64_t>          m_bytes_in = 0;
+    std::atomic<std::uint64_t>          m_bytes_out = 0;
+};
 
 
-inline void catch_compare_large_buffers(void const * a, std::size_t a_size, void const * b, std::size_t b_size)
+/** \brief Create a handler for line based protocols.
+ *
+ * The function \p f is called once per line (without the '\\n') and
+ * its result, followed by a '\\n', is sent back.
+ *
+ * \param[in] f  The function called with each line.
+ *
+ * \return A handler for a local_server.
+ */
+inline local_server::handler_t line_handler(std::function<std::string(std::string_view line)> f)
 {
-    if(a_size == b_size
-    && memcmp(a, b, a_size) == 0)
-    {
-        return;
-    }
-
-    std::cout << "error: large buffers do not match.\n"
-              << "---------------------------------------------------\n";
-
-    std::uint8_t const * a_ptr(reinterpret_cast<std::uint8_t const *>(a));
-    std::uint8_t const * b_ptr(reinterpret_cast<std::uint8_t const *>(b));
-    std::size_t const max(std::min(a_size, b_size));
-
-    // skip start as long as equal
-    //
-    std::size_t idx(0);
-    for(; idx < max; ++idx)
+    return [f](std::string_view input, std::string & output) -> std::size_t
     {
-        if(a_ptr[idx] != b_ptr[idx])
+        std::string_view::size_type const pos(input.find('\n'));
+        if(pos == std::string_view::npos)
         {
-            break;
+            return 0;
         }
-    }
-    if(idx > 10)
-    {
-        // adjust pointer to include some equal data and then a multiple of 16
-        //
-        idx -= 10;
-        idx &= -16;
-    }
-    else
-    {
-        idx = 0;
-    }
+        output += f(input.substr(0, pos));
+        output += '\n';
+        return pos + 1;
+    };
+}
 
-    // limit the output to 4 lines of data
-    //
-    std::size_t const limit(std::min(idx + 64, max));
 
-    bool err(false);
-    bool first(true);
-    std::cout << std::hex << std::setfill('0');
-    for(; idx < limit; ++idx)
+/** \brief Create a handler following a script.
+ *
+ * Each step of the script is a request and the response to send back
+ * when exactly that request is received. The steps must happen in order.
+ * Any other request is a failure.
+ *
+ * \param[in] steps  The list of request/response pairs.
+ *
+ * \return A handler for a local_server.
+ */
+inline local_server::handler_t script_handler(std::vector<std::pair<std::string, std::string>> const & steps)
+{
+    return [steps, step = static_cast<std::size_t>(0)](std::string_view input, std::string & output) mutable -> std::size_t
     {
-        if((idx & 15) == 0)
+        if(step >= steps.size())
         {
-            if(first)
-            {
-                first = false;
-            }
-            else
-            {
-                std::cout << '\n';
-            }
-            std::cout << "\033[0m" << std::setw(8) << idx << "- ";
-            err = false;
+            throw std::runtime_error("unexpected request after the end of the script.");
         }
-        if(a_ptr[idx] == b_ptr[idx])
+        std::string const & expected(steps[step].first);
+        std::size_t const size(std::min(expected.length(), input.length()));
+        if(input.substr(0, size) != std::string_view(expected).substr(0, size))
         {
-            if(err)
-            {
-                err = false;
-                std::cout << "\033[0m";
-            }
-            std::cout << std::setw(2) << a_ptr[idx] << ' ';
+            throw std::runtime_error(
+                      "step "
+                    + std::to_string(step + 1)
+                    + " of script expected \""
+                    + expected
+                    + "\" and got \""
+                    + std::string(input.substr(0, std::min<std::size_t>(input.length(), 64)))
+                    + "\".");
         }
-        else
+        if(input.length() < expected.length())
         {
-            if(!err)
-            {
-                err = true;
-                std::cout << "\033[7m";
-            }
-            std::cout << '[';
-            std::cout << std::setw(2) << a_ptr[idx];
-            std::cout << '/';
-            std::cout << std::setw(2) << b_ptr[idx];
-            std::cout << "] ";
+            return 0;
         }
-    }
-    if(err)
+        output += steps[step].second;
+        ++step;
+        return expected.length();
+    };
+}
+
+
+
+
+
+} // SNAP_CATCH2_NAMESPACE namespace
+
+
+#if defined(CATCH_CONFIG_RUNNER) && defined(SNAP_CATCH2_VIRTUAL_TIME)
+/** \brief Interpose the C library time functions.
+ *
+ * When SNAP_CATCH2_VIRTUAL_TIME is defined in the file defining
+ * CATCH_CONFIG_RUNNER, the test binary overrides the C library time and
+ * sleep functions. Outside of a virtual_time object (or in threads with
+ * the bypass flag), these call the C library functions. Since
+ * libstdc++ uses these functions, the std::chrono clocks and
+ * std::this_thread::sleep_for() follow the virtual time too.
+ *
+ * \note
+ * Timeouts handled by the kernel (condition variables, poll(), select(),
+ * etc.) are not virtualized.
+ */
+namespace SNAP_CATCH2_NAMESPACE
+{
+namespace detail
+{
+
+
+template<typename F>
+F real_function(char const * name)
+{
+    void * f(dlsym(RTLD_NEXT, name));
+    if(f == nullptr)
     {
-        err = false;
-        std::cout << "\033[0m";
+        std::cerr << "fatal error: could not find \"" << name << "\" in the C library.\n";
+        abort();
     }
+    return reinterpret_cast<F>(f);
+}
 
-    std::cout << (limit != max ? "..." : "") << '\n'
-              << "---------------------------------------------------" << std::endl;
 
-    if(a_size > b_size)
+inline bool is_virtual_clock(clockid_t clk)
+{
+    switch(clk)
     {
-        std::cout << "Left hand side buffer is longer ("
-                  << a_size
-                  << " versus "
-                  << b_size
-                  << ")."
-                  << std::endl;
+    case CLOCK_REALTIME:
+    case CLOCK_REALTIME_COARSE:
+    case CLOCK_MONOTONIC:
+    case CLOCK_MONOTONIC_COARSE:
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_BOOTTIME:
+        return virtual_time_state::instance().active();
+
+    default:
+        return false;
+
     }
-    else if(b_size > a_size)
+}
+
+
+inline std::int64_t virtual_clock_ns(clockid_t clk)
+{
+    virtual_time_state const & state(virtual_time_state::instance());
+    return clk == CLOCK_REALTIME || clk == CLOCK_REALTIME_COARSE
+                ? state.realtime()
+                : state.monotonic();
+}
+
+
+inline std::int64_t timespec_ns(timespec const & ts)
+{
+    return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+
+} // detail namespace
+} // SNAP_CATCH2_NAMESPACE namespace
+
+
+extern "C" {
+
+
+int clock_gettime(clockid_t clk, struct timespec * ts) noexcept
+{
+    typedef int (*func_t)(clockid_t, struct timespec *);
+    static func_t const real(SNAP_CATCH2_NAMESPACE::detail::real_function<func_t>("clock_gettime"));
+
+    if(!SNAP_CATCH2_NAMESPACE::detail::is_virtual_clock(clk))
     {
-        std::cout << "Right hand side buffer is longer ("
-                  << a_size
-                  << " versus "
-                  << b_size
-                  << ")."
-                  << std::endl;
+        return real(clk, ts);
     }
-
-    // to generate the standard error too
-    //
-    CATCH_REQUIRE(!"large buffers a and b differ");
+    std::int64_t const ns(SNAP_CATCH2_NAMESPACE::detail::virtual_clock_ns(clk));
+    ts->tv_sec = static_cast<time_t>(ns / 1'000'000'000);
+    ts->tv_nsec = static_cast<long>(ns % 1'000'000'000);
+    return 0;
 }
 
 
-template<typename F>
-F default_epsilon()
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 31)
+int gettimeofday(struct timeval * tv, void * tz) noexcept
 {
-    return static_cast<F>(0.00001);
+    typedef int (*func_t)(struct timeval *, void *);
+    static func_t const real(SNAP_CATCH2_NAMESPACE::detail::real_function<func_t>("gettimeofday"));
+
+    if(!SNAP_CATCH2_NAMESPACE::detail::is_virtual_clock(CLOCK_REALTIME))
+    {
+        return real(tv, tz);
+    }
+    std::int64_t const ns(SNAP_CATCH2_NAMESPACE::detail::virtual_clock_ns(CLOCK_REALTIME));
+    tv->tv_sec = static_cast<time_t>(ns / 1'000'000'000);
+    tv->tv_usec = static_cast<suseconds_t>(ns % 1'000'000'000 / 1'000);
+    return 0;
 }
+#endif
 
 
-template<typename F>
-bool nearly_equal(
-      F const lhs
-    , F const rhs
-    , F epsilon = default_epsilon<F>())
+time_t time(time_t * t) noexcept
 {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wfloat-equal"
-    // already equal?
-    if(lhs == rhs)
+    typedef time_t (*func_t)(time_t *);
+    static func_t const real(SNAP_CATCH2_NAMESPACE::detail::real_function<func_t>("time"));
+
+    if(!SNAP_CATCH2_NAMESPACE::detail::is_virtual_clock(CLOCK_REALTIME))
     {
-        return true;
+        return real(t);
+    }
+    time_t const result(static_cast<time_t>(SNAP_CATCH2_NAMESPACE::detail::virtual_clock_ns(CLOCK_REALTIME) / 1'000'000'000));
+    if(t != nullptr)
+    {
+        *t = result;
     }
+    return result;
+}
 
-    F const diff(std::abs(lhs - rhs));
-    if(lhs == 0.0
-    || rhs == 0.0
-    || diff < std::numeric_limits<F>::min())
+
+int clock_nanosleep(clockid_t clk, int flags, struct timespec const * req, struct timespec * rem)
+{
+    typedef int (*func_t)(clockid_t, int, struct timespec const *, struct timespec *);
+    static func_t const real(SNAP_CATCH2_NAMESPACE::detail::real_function<func_t>("clock_nanosleep"));
+
+    if(!SNAP_CATCH2_NAMESPACE::detail::is_virtual_clock(clk))
     {
-        return diff < (epsilon * std::numeric_limits<F>::min());
+        return real(clk, flags, req, rem);
     }
-#pragma GCC diagnostic pop
+    SNAP_CATCH2_NAMESPACE::detail::virtual_time_state & state(SNAP_CATCH2_NAMESPACE::detail::virtual_time_state::instance());
+    std::int64_t const ns(SNAP_CATCH2_NAMESPACE::detail::timespec_ns(*req));
+    if((flags & TIMER_ABSTIME) != 0)
+    {
+        state.sleep_until(state.monotonic() + ns - SNAP_CATCH2_NAMESPACE::detail::virtual_clock_ns(clk));
+    }
+    else
+    {
+        state.sleep_until(state.monotonic() + ns);
+    }
+    if(rem != nullptr)
+    {
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
+    }
+    return 0;
+}
 
-    return diff / (std::abs(lhs) + std::abs(rhs)) < epsilon;
+
+int nanosleep(struct timespec const * req, struct timespec * rem)
+{
+    int const r(clock_nanosleep(CLOCK_REALTIME, 0, req, rem));
+    if(r != 0)
+    {
+        errno = r;
+        return -1;
+    }
+    return 0;
 }
 
 
+int usleep(useconds_t usec)
+{
+    struct timespec const req = {
+        static_cast<time_t>(usec / 1'000'000),
+        static_cast<long>(usec % 1'000'000 * 1'000),
+    };
+    return nanosleep(&req, nullptr);
+}
 
 
+unsigned int sleep(unsigned int seconds)
+{
+    struct timespec const req = { static_cast<time_t>(seconds), 0 };
+    struct timespec rem = {};
+    if(nanosleep(&req, &rem) != 0)
+    {
+        return static_cast<unsigned int>(rem.tv_sec);
+    }
+    return 0;
+}
 
-} // SNAP_CATCH2_NAMESPACE namespace
+
+}
+#endif
 
 
 /** \brief Start a new section.
@@ -1157,109 +11239,422 @@ bool nearly_equal(
  * command line option was specified.)
  *
  * \code
- *     CATCH_START_SECTION("my section name/description here")
- *         break_something(1, 2, 3);
- *     CATCH_END_SECTION()
+ *     CATCH_START_SECTION("my section name/description here")
+ *         break_something(1, 2, 3);
+ *     CATCH_END_SECTION()
+ * \endcode
+ *
+ * As you can see, you want to end the section with the CATCH_END_SECTION()
+ * macro.
+ *
+ * \note
+ * You do not need to add a block like you have to do with CATCH since
+ * the macros add them for you.
+ *
+ * \note
+ * The older version of Catch supported a description for a section.
+ * Now that's useless so we only offer a name here.
+ *
+ * \param[in] name  The name of the section.
+ */
+#define CATCH_START_SECTION(name) \
+    CATCH_SECTION(name) \
+    { \
+        if(SNAP_CATCH2_NAMESPACE::g_progress()) \
+        { \
+            std::cout << "SECTION: " << name << std::endl; \
+        }
+
+
+/** \brief End a section.
+ *
+ * This macro ends a section. The CATCH_START_SECTION() creates a
+ * block which this macro closes.
+ */
+#define CATCH_END_SECTION() \
+    }
+
+
+/** \brief Require that two long strings be equal.
+ *
+ * When testing with really long strings, the compare failing will give
+ * you both output but it's pretty much impossible to see the errors.
+ *
+ * Here we call our own function which will highlight the problems
+ * so that way you can immediately see where the first difference occurs.
+ *
+ * \param[in] a  The first string.
+ * \param[in] b  The second string.
+ */
+#define CATCH_REQUIRE_LONG_STRING(a, b) SNAP_CATCH2_NAMESPACE::catch_compare_long_strings(a, b)
+
+
+/** \brief Require that two long buffers be equal.
+ *
+ * When testing really large buffers, the compare failing lists all the
+ * bytes on each side. By default, Catch will output the complete left
+ * hand side and then the complete right hand side. In most cases, that's
+ * useless if the buffer is in the kilobytes in size.
+ *
+ * This macro calls a function which makes sure to render the bytes next
+ * to each other and shows the erroneous ones highlighter. It also shows
+ * the location inside the buffer as an offset or address.
+ *
+ * If the first error appears way down, then the part that is equal at
+ * the start is skipped. It also only shows the first 64 bytes with the
+ * first few errors. In most cases, fixing that part will be sufficient
+ * to move forward.
+ *
+ * \param[in] a  The first buffer.
+ * \param[in] a_size  The size of the first buffer.
+ * \param[in] b  The second buffer.
+ * \param[in] b_size  The size of the second buffer.
+ */
+#define CATCH_REQUIRE_LARGE_BUFFER(a, a_size, b, b_size) SNAP_CATCH2_NAMESPACE::catch_compare_large_buffers(a, a_size, b, b_size)
+
+
+
+/** \brief Compare two floating points for near equality.
+ *
+ * This macro is a helper which calls our nearly_equal() function with
+ * the default epsilon (1e-5).
+ *
+ * This is useful since comparing floating points with just `==` is
+ * often not a good choice if the math on both sides is not exactly
+ * the same (and then what are we testing?)
+ *
+ * \note
+ * To still use the equivalent of `==`, you can directly call the
+ * nearly_equal() function and set the epsilon to 0.0:
+ *
+ * \code
+ *     SNAP_CATCH2_NAMESPACE::nearly_equal(a, b, 0.0)
+ * \endcode
+ *
+ * \note
+ * Catch2 offers an approximation equality which uses a special literal:
+ *
+ * \code
+ *     CATCH_REQUIRE(a == 1.0_a); // equivalent to Approx(1.0)
+ * \endcode
+ *
+ * \param[in] a  The left hand side floating point to compare.
+ * \param[in] b  The right hand side floating point to compare.
+ */
+#define CATCH_REQUIRE_FLOATING_POINT(a, b) SNAP_CATCH2_NAMESPACE::nearly_equal(a, b)
+
+
+/** \brief Internal macro used by our assertions.
+ *
+ * This macro is similar to the Catch2 INTERNAL_CATCH_TEST() macro except
+ * that the expression is already evaluated by one of our functions which
+ * returns a Catch::ITransientExpression such as detail::range_expression.
+ */
+#define SNAP_CATCH2_EXPRESSION_TEST(macro_name, expression_text, expression) \
+    do \
+    { \
+        Catch::AssertionHandler catchAssertionHandler( \
+                  macro_name##_catch_sr \
+                , CATCH_INTERNAL_LINEINFO \
+                , expression_text \
+                , Catch::ResultDisposition::Normal); \
+        INTERNAL_CATCH_TRY \
+        { \
+            catchAssertionHandler.handleExpr(expression); \
+        } \
+        INTERNAL_CATCH_CATCH(catchAssertionHandler) \
+        catchAssertionHandler.complete(); \
+    } \
+    while(false)
+
+
+/** \brief Require that all the elements of a range satisfy a predicate.
+ *
+ * Calling CATCH_REQUIRE() in a loop over millions of elements is slow
+ * since each call goes through the whole Catch2 assertion machinery.
+ * This macro checks the entire range in a tight loop (in parallel when
+ * the range has random access iterators) and counts as one assertion.
+ * The failing elements are only converted to strings when the assertion
+ * fails and only the first few are shown along their index.
+ *
+ * The predicate is the last parameter so a lambda with commas can be
+ * used as is:
+ *
+ * \code
+ *     CATCH_REQUIRE_ALL(output, [&lo, &hi](int v) { return v >= lo && v <= hi; });
+ * \endcode
+ *
+ * \warning
+ * The predicate may be called from several threads at once.
+ *
+ * \param[in] range  The range to check.
+ * \param[in] ...  A predicate returning true for valid elements.
+ */
+#define CATCH_REQUIRE_ALL(range, ...) \
+    SNAP_CATCH2_EXPRESSION_TEST( \
+              "CATCH_REQUIRE_ALL" \
+            , #range ", " #__VA_ARGS__ \
+            , SNAP_CATCH2_NAMESPACE::detail::require_all(range, __VA_ARGS__))
+
+
+/** \brief Require that two ranges be equal element by element.
+ *
+ * This macro is the equivalent of CATCH_REQUIRE_ALL() comparing each
+ * element of \p a with the element at the same position in \p b using
+ * `operator == ()`. The ranges must also have the same size.
+ *
+ * \param[in] a  The range being checked.
+ * \param[in] b  The expected range.
+ */
+#define CATCH_REQUIRE_RANGE_EQUAL(a, b) \
+    SNAP_CATCH2_EXPRESSION_TEST( \
+              "CATCH_REQUIRE_RANGE_EQUAL" \
+            , #a ", " #b \
+            , SNAP_CATCH2_NAMESPACE::detail::require_range_equal(a, b))
+
+
+/** \brief Require that two large containers be equal.
+ *
+ * Comparing containers of millions of elements with CATCH_REQUIRE()
+ * either passes silently or converts both containers to strings. This
+ * macro compares sequences by chunks (in parallel for random access
+ * containers) to find the common prefix and suffix, then computes an
+ * element level diff of the region in between. Maps and sets are
+ * compared key by key.
+ *
+ * On failure, the number of changed, inserted (only found in \p a) and
+ * removed (only found in \p b) elements is shown along the first few of
+ * them with their index or key. Only those elements are converted to
+ * strings.
+ *
+ * \param[in] a  The container being checked.
+ * \param[in] b  The expected container.
+ */
+#define CATCH_REQUIRE_CONTAINERS_EQUAL(a, b) \
+    SNAP_CATCH2_EXPRESSION_TEST( \
+              "CATCH_REQUIRE_CONTAINERS_EQUAL" \
+            , #a ", " #b \
+            , SNAP_CATCH2_NAMESPACE::detail::require_containers_equal(a, b))
+
+
+/** \brief Require that a string be valid UTF-8.
+ *
+ * Overlong sequences, surrogates and characters over 0x10FFFF are
+ * considered invalid. On failure, the offset of the first invalid byte
+ * is shown along the bytes around it.
+ *
+ * \param[in] str  The string to validate (anything that converts to
+ * an std::string_view).
+ */
+#define CATCH_REQUIRE_VALID_UTF8(str) \
+    SNAP_CATCH2_EXPRESSION_TEST( \
+              "CATCH_REQUIRE_VALID_UTF8" \
+            , #str \
+            , SNAP_CATCH2_NAMESPACE::detail::utf8_expression(str))
+
+
+/** \brief Require that two implementations give the same results.
+ *
+ * This macro calls check_equivalent() with its parameters, attaches the
+ * time spent in each implementation to the assertion (CATCH_UNSCOPED_INFO())
+ * and then requires that all the results be equivalent. On failure, the smallest failing input index
+ * is shown along its seed, the input and both results.
+ *
+ * \code
+ *     CATCH_REQUIRE_EQUIVALENT(
+ *           [](std::string const & s) { return slow_escape(s); }
+ *         , [](std::string const & s) { return fast_escape(s); }
+ *         , [](std::mt19937_64 & random) { return make_input(random); }
+ *         , 100'000);
  * \endcode
  *
- * As you can see, you want to end the section with the CATCH_END_SECTION()
- * macro.
+ * \param[in] ...  The reference, candidate, generator, count and optional
+ * comparator (see check_equivalent()).
+ */
+#define CATCH_REQUIRE_EQUIVALENT(...) \
+    do \
+    { \
+        SNAP_CATCH2_NAMESPACE::equivalence_result const snap_catch2_equivalence_result( \
+                SNAP_CATCH2_NAMESPACE::check_equivalent(__VA_ARGS__)); \
+        std::stringstream snap_catch2_equivalence_timing; \
+        snap_catch2_equivalence_result.report(snap_catch2_equivalence_timing); \
+        CATCH_UNSCOPED_INFO(snap_catch2_equivalence_timing.str()); \
+        SNAP_CATCH2_EXPRESSION_TEST( \
+                  "CATCH_REQUIRE_EQUIVALENT" \
+                , #__VA_ARGS__ \
+                , SNAP_CATCH2_NAMESPACE::detail::equivalence_expression(snap_catch2_equivalence_result)); \
+    } \
+    while(false)
+
+
+/** \brief Run a multithreaded stress test.
  *
- * \note
- * You do not need to add a block like you have to do with CATCH since
- * the macros add them for you.
+ * This macro calls run_stress(), attaches the per thread and aggregate
+ * operations per second to the next assertion (CATCH_UNSCOPED_INFO())
+ * and then requires that no failures occurred, so the table shows when
+ * the stress test fails or with `-s`.
+ * The \p iterations parameter can also be an std::chrono duration to
+ * run for a fixed amount of time instead.
  *
- * \note
- * The older version of Catch supported a description for a section.
- * Now that's useless so we only offer a name here.
+ * The body is the last parameter so a lambda with commas can be used
+ * as is:
  *
- * \param[in] name  The name of the section.
+ * \code
+ *     CATCH_STRESS(8, 1'000'000, [&queue](SNAP_CATCH2_NAMESPACE::stress_context & ctx)
+ *     {
+ *         queue.push(ctx.f_random());
+ *         if(!queue.pop())
+ *         {
+ *             ctx.fail("queue was empty");
+ *         }
+ *     });
+ * \endcode
+ *
+ * \param[in] threads  The number of threads.
+ * \param[in] iterations  The number of iterations per thread or a duration.
+ * \param[in] ...  The body, called with an SNAP_CATCH2_NAMESPACE::stress_context.
  */
-#define CATCH_START_SECTION(name) \
-    CATCH_SECTION(name) \
+#define CATCH_STRESS(threads, iterations, ...) \
+    do \
     { \
-        if(SNAP_CATCH2_NAMESPACE::g_progress()) \
+        SNAP_CATCH2_NAMESPACE::stress_result const snap_catch2_stress_result( \
+                SNAP_CATCH2_NAMESPACE::run_stress(threads, iterations, __VA_ARGS__)); \
+        std::stringstream snap_catch2_stress_table; \
+        snap_catch2_stress_result.report(snap_catch2_stress_table); \
+        CATCH_UNSCOPED_INFO(snap_catch2_stress_table.str()); \
+        CATCH_INFO(snap_catch2_stress_result.failures()); \
+        CATCH_REQUIRE(snap_catch2_stress_result.f_failures == 0); \
+    } \
+    while(false)
+
+
+/** \brief Internal macro used by the thread assertions.
+ *
+ * In a thread started with thread_assertions::wrap(), the result is
+ * saved in the thread buffer without taking any lock. Anywhere else,
+ * this is a normal Catch2 assertion.
+ */
+#define SNAP_CATCH2_THREAD_TEST(macro_name, disposition, ...) \
+    do \
+    { \
+        SNAP_CATCH2_NAMESPACE::detail::thread_assertion_buffer * snap_catch2_buffer( \
+                SNAP_CATCH2_NAMESPACE::detail::current_thread_buffer()); \
+        if(snap_catch2_buffer == nullptr) \
         { \
-            std::cout << "SECTION: " << name << std::endl; \
-        }
+            INTERNAL_CATCH_TEST(macro_name, disposition, __VA_ARGS__); \
+        } \
+        else \
+        { \
+            CATCH_INTERNAL_START_WARNINGS_SUPPRESSION \
+            CATCH_INTERNAL_SUPPRESS_PARENTHESES_WARNINGS \
+            snap_catch2_buffer->add( \
+                      macro_name \
+                    , CATCH_INTERNAL_LINEINFO \
+                    , #__VA_ARGS__ \
+                    , disposition \
+                    , Catch::Decomposer() <= __VA_ARGS__); \
+            CATCH_INTERNAL_STOP_WARNINGS_SUPPRESSION \
+        } \
+    } \
+    while(false)
+
+
+/** \brief Check an expression from a worker thread.
+ *
+ * The thread must be started with thread_assertions::wrap(). The
+ * results are reported by CATCH_MERGE_THREAD_ASSERTIONS().
+ */
+#define CATCH_THREAD_CHECK(...) \
+    SNAP_CATCH2_THREAD_TEST("CATCH_THREAD_CHECK", Catch::ResultDisposition::ContinueOnFailure, __VA_ARGS__)
 
 
-/** \brief End a section.
+/** \brief Require an expression from a worker thread.
  *
- * This macro ends a section. The CATCH_START_SECTION() creates a
- * block which this macro closes.
+ * On failure, the worker thread function returns immediately. The
+ * failure is reported by CATCH_MERGE_THREAD_ASSERTIONS().
  */
-#define CATCH_END_SECTION() \
-    }
+#define CATCH_THREAD_REQUIRE(...) \
+    SNAP_CATCH2_THREAD_TEST("CATCH_THREAD_REQUIRE", Catch::ResultDisposition::Normal, __VA_ARGS__)
 
 
-/** \brief Require that two long strings be equal.
- *
- * When testing with really long strings, the compare failing will give
- * you both output but it's pretty much impossible to see the errors.
+/** \brief Report the results of the worker threads.
  *
- * Here we call our own function which will highlight the problems
- * so that way you can immediately see where the first difference occurs.
+ * Call this macro once the worker threads started with
+ * thread_assertions::wrap() were joined.
  *
- * \param[in] a  The first string.
- * \param[in] b  The second string.
+ * \param[in] results  The thread_assertions object.
  */
-#define CATCH_REQUIRE_LONG_STRING(a, b) SNAP_CATCH2_NAMESPACE::catch_compare_long_strings(a, b)
+#define CATCH_MERGE_THREAD_ASSERTIONS(results) \
+    (results).merge(CATCH_INTERNAL_LINEINFO, #results)
 
 
-/** \brief Require that two long buffers be equal.
+/** \brief Measure the latency distribution of a function.
  *
- * When testing really large buffers, the compare failing lists all the
- * bytes on each side. By default, Catch will output the complete left
- * hand side and then the complete right hand side. In most cases, that's
- * useless if the buffer is in the kilobytes in size.
+ * This macro calls measure_latency() and returns the latency_result so
+ * percentiles can then be checked with CATCH_REQUIRE_LATENCY():
  *
- * This macro calls a function which makes sure to render the bytes next
- * to each other and shows the erroneous ones highlighter. It also shows
- * the location inside the buffer as an offset or address.
+ * \code
+ *     using namespace std::chrono_literals;
  *
- * If the first error appears way down, then the part that is equal at
- * the start is skipped. It also only shows the first 64 bytes with the
- * first few errors. In most cases, fixing that part will be sufficient
- * to move forward.
+ *     auto const latency(CATCH_MEASURE_LATENCY("push", 100'000, [&]()
+ *         {
+ *             queue.push(5);
+ *         }));
+ *     CATCH_REQUIRE_LATENCY(latency.p99() < 50us);
+ *     CATCH_REQUIRE_LATENCY(latency.p999() < 200us);
+ * \endcode
  *
- * \param[in] a  The first buffer.
- * \param[in] a_size  The size of the first buffer.
- * \param[in] b  The second buffer.
- * \param[in] b_size  The size of the second buffer.
+ * \param[in] name  The name of the measurement.
+ * \param[in] iterations  The number of calls.
+ * \param[in] ...  The function to measure.
  */
-#define CATCH_REQUIRE_LARGE_BUFFER(a, a_size, b, b_size) SNAP_CATCH2_NAMESPACE::catch_compare_large_buffers(a, a_size, b, b_size)
-
+#define CATCH_MEASURE_LATENCY(name, iterations, ...) \
+    SNAP_CATCH2_NAMESPACE::measure_latency(name, iterations, __VA_ARGS__)
 
 
-/** \brief Compare two floating points for near equality.
+/** \brief Require a latency percentile.
  *
- * This macro is a helper which calls our nearly_equal() function with
- * the default epsilon (1e-5).
+ * The percentiles of a latency_result compare against std::chrono
+ * durations. On failure, the expansion shows the full percentile table
+ * of the measurement.
  *
- * This is useful since comparing floating points with just `==` is
- * often not a good choice if the math on both sides is not exactly
- * the same (and then what are we testing?)
+ * \param[in] ...  The comparison of a percentile against a duration.
+ */
+#define CATCH_REQUIRE_LATENCY(...) \
+    INTERNAL_CATCH_TEST("CATCH_REQUIRE_LATENCY", Catch::ResultDisposition::Normal, __VA_ARGS__)
+
+
+/** \brief Require that an expression throws with a specific message.
  *
- * \note
- * To still use the equivalent of `==`, you can directly call the
- * nearly_equal() function and set the epsilon to 0.0:
+ * This macro is a shortcut to the CATCH_REQUIRE_THROWS_MATCHES() macro
+ * used along the Catch::Matchers::ExceptionMessageEquals() matcher.
+ * The expected message is viewed (std::string_view), not copied, so it
+ * is cheap to use in table driven loops:
  *
  * \code
- *     SNAP_CATCH2_NAMESPACE::nearly_equal(a, b, 0.0)
- * \endcode
+ *     struct bad_input_t
+ *     {
+ *         char const *    f_input = nullptr;
+ *         char const *    f_message = nullptr;
+ *     };
  *
- * \note
- * Catch2 offers an approximation equality which uses a special literal:
+ *     constexpr bad_input_t const g_bad_inputs[] = { ... };
  *
- * \code
- *     CATCH_REQUIRE(a == 1.0_a); // equivalent to Approx(1.0)
+ *     for(auto const & bad : g_bad_inputs)
+ *     {
+ *         CATCH_REQUIRE_THROWS_MESSAGE(
+ *                   parse(bad.f_input)
+ *                 , my_lib::invalid_input
+ *                 , bad.f_message);
+ *     }
  * \endcode
  *
- * \param[in] a  The left hand side floating point to compare.
- * \param[in] b  The right hand side floating point to compare.
+ * \param[in] expr  The expression expected to throw.
+ * \param[in] type  The type of exception expected.
+ * \param[in] message  The exact message expected from what().
  */
-#define CATCH_REQUIRE_FLOATING_POINT(a, b) SNAP_CATCH2_NAMESPACE::nearly_equal(a, b)
+#define CATCH_REQUIRE_THROWS_MESSAGE(expr, type, message) \
+    CATCH_REQUIRE_THROWS_MATCHES(expr, type, Catch::Matchers::ExceptionMessageEquals(message))
 
 
 
@@ -1286,11 +11681,14 @@ public:
      */
     bool match(std::exception const & e) const override
     {
-        if(m_verbose)
+        bool const result(e.what() == m_expected_message);
+        if(!result && m_verbose)
         {
+            // only pay for the long string diff when it is useful
+            //
             SNAP_CATCH2_NAMESPACE::catch_compare_long_strings(e.what(), m_expected_message);
         }
-        return e.what() == m_expected_message;
+        return result;
     }
 
     /** \brief Describe this matcher.
@@ -1318,6 +11716,389 @@ inline ExceptionWatcher ExceptionMessage(std::string const & expected_message, b
 }
 
 
+/** \brief A precompiled exception message pattern.
+ *
+ * This class compiles a simple glob like pattern once so it can be
+ * matched against many exception messages without any further parsing
+ * or memory allocation.
+ *
+ * The pattern supports:
+ *
+ * \li `*` -- match any number of characters, including none
+ * \li `?` -- match exactly one character
+ * \li `\\` -- escape the following character (i.e. `\*` matches a `*`)
+ *
+ * The pattern is anchored at both ends, so use a `*` at the start and/or
+ * the end to match part of the message.
+ *
+ * \code
+ *     Catch::Matchers::ExceptionMessagePattern const pattern(
+ *             "parameter_error: value \"*\" is out of range.");
+ *
+ *     for(auto const & v : bad_values)
+ *     {
+ *         CATCH_REQUIRE_THROWS_MATCHES(
+ *                   f(v)
+ *                 , my_lib::parameter_error
+ *                 , Catch::Matchers::ExceptionMessageMatches(pattern));
+ *     }
+ * \endcode
+ */
+class ExceptionMessagePattern
+{
+public:
+    explicit ExceptionMessagePattern(std::string_view pattern)
+        : m_pattern(pattern)
+    {
+        // resolve the escapes in our copy of the pattern and cut it in
+        // tokens which reference that copy
+        //
+        std::size_t literal_start(0);
+        std::size_t out(0);
+        auto end_literal = [&]()
+        {
+            if(out > literal_start)
+            {
+                m_tokens.push_back({
+                      token_t::TOKEN_LITERAL
+                    , std::string_view(m_compiled).substr(literal_start, out - literal_start)
+                });
+            }
+        };
+        m_compiled.resize(pattern.length());
+        for(std::size_t idx(0); idx < pattern.length(); ++idx)
+        {
+            char c(pattern[idx]);
+            switch(c)
+            {
+            case '*':
+                end_literal();
+                if(m_tokens.empty()
+                || m_tokens.back().f_type != token_t::TOKEN_ANY_SEQUENCE)
+                {
+                    m_tokens.push_back({ token_t::TOKEN_ANY_SEQUENCE, std::string_view() });
+                }
+                literal_start = out;
+                continue;
+
+            case '?':
+                end_literal();
+                m_tokens.push_back({ token_t::TOKEN_ANY_CHARACTER, std::string_view() });
+                literal_start = out;
+                continue;
+
+            case '\\':
+                if(idx + 1 < pattern.length())
+                {
+                    ++idx;
+                    c = pattern[idx];
+                }
+                break;
+
+            }
+            m_compiled[out] = c;
+            ++out;
+        }
+        end_literal();
+    }
+
+    // the tokens reference m_compiled so we cannot just copy the members
+    //
+    ExceptionMessagePattern(ExceptionMessagePattern const & rhs) = delete;
+    ExceptionMessagePattern & operator = (ExceptionMessagePattern const & rhs) = delete;
+
+    /** \brief Check whether \p message matches this pattern.
+     *
+     * This function walks the message and the tokens. When a `*` is
+     * found, the position is saved so we can backtrack if the following
+     * tokens do not match.
+     *
+     * \param[in] message  The message to match against this pattern.
+     *
+     * \return true if the message matches the whole pattern.
+     */
+    bool match(std::string_view message) const
+    {
+        std::size_t const npos(static_cast<std::size_t>(-1));
+        std::size_t t(0);
+        std::size_t p(0);
+        std::size_t star_t(npos);
+        std::size_t star_p(0);
+        for(;;)
+        {
+            if(t < m_tokens.size())
+            {
+                token const & tok(m_tokens[t]);
+                switch(tok.f_type)
+                {
+                case token_t::TOKEN_ANY_SEQUENCE:
+                    ++t;
+                    star_t = t;
+                    star_p = p;
+                    continue;
+
+                case token_t::TOKEN_ANY_CHARACTER:
+                    if(p < message.length())
+                    {
+                        ++p;
+                        ++t;
+                        continue;
+                    }
+                    break;
+
+                case token_t::TOKEN_LITERAL:
+                    if(p + tok.f_text.length() <= message.length()
+                    && message.compare(p, tok.f_text.length(), tok.f_text) == 0)
+                    {
+                        p += tok.f_text.length();
+                        ++t;
+                        continue;
+                    }
+                    break;
+
+                }
+            }
+            else if(p == message.length())
+            {
+                return true;
+            }
+
+            // mismatch, backtrack to the last '*' if any
+            //
+            if(star_t == npos
+            || star_p >= message.length())
+            {
+                return false;
+            }
+            ++star_p;
+            p = star_p;
+            t = star_t;
+        }
+    }
+
+    std::string const & pattern() const
+    {
+        return m_pattern;
+    }
+
+private:
+    enum class token_t
+    {
+        TOKEN_LITERAL,
+        TOKEN_ANY_CHARACTER,
+        TOKEN_ANY_SEQUENCE,
+    };
+
+    struct token
+    {
+        token_t             f_type = token_t::TOKEN_LITERAL;
+        std::string_view    f_text = std::string_view();
+    };
+
+    std::string         m_pattern = std::string();
+    std::string         m_compiled = std::string();
+    std::vector<token>  m_tokens = std::vector<token>();
+};
+
+
+/** \brief Match exception messages without allocating memory.
+ *
+ * The ExceptionWatcher keeps a copy of the expected message in an
+ * std::string. When a test generates millions of exceptions, these
+ * copies become a bottleneck. This matcher instead keeps an
+ * std::string_view so the caller has to make sure that the string
+ * remains valid until the test is done with the matcher (a string
+ * literal or a table of expected messages are perfect for this purpose).
+ *
+ * On a successful match, nothing gets allocated. On a failure, the
+ * actual message is saved so the describe() function can render a
+ * short diff showing where the messages differ.
+ *
+ * Use the ExceptionMessageEquals(), ExceptionMessageStartsWith(),
+ * ExceptionMessageContains() and ExceptionMessageMatches() functions
+ * to create such matchers. The ExceptionMessagePattern given to
+ * ExceptionMessageMatches() is referenced too so it cannot be a
+ * temporary.
+ */
+class ExceptionMessageView
+    : public MatcherBase<std::exception>
+{
+public:
+    enum class mode_t
+    {
+        MODE_EQUALS,
+        MODE_STARTS_WITH,
+        MODE_CONTAINS,
+        MODE_PATTERN,
+    };
+
+    ExceptionMessageView(std::string_view expected_message, mode_t mode)
+        : m_expected_message(expected_message)
+        , m_mode(mode)
+    {
+    }
+
+    ExceptionMessageView(ExceptionMessagePattern const & pattern)
+        : m_expected_message(pattern.pattern())
+        , m_mode(mode_t::MODE_PATTERN)
+        , m_pattern(&pattern)
+    {
+    }
+
+    // the view keeps a pointer to the pattern so a temporary would dangle
+    //
+    ExceptionMessageView(ExceptionMessagePattern && pattern) = delete;
+
+    ExceptionMessageView(ExceptionMessageView const & rhs)
+        : MatcherBase<std::exception>(rhs)
+        , m_expected_message(rhs.m_expected_message)
+        , m_mode(rhs.m_mode)
+        , m_pattern(rhs.m_pattern)
+    {
+    }
+
+    ExceptionMessageView & operator = (ExceptionMessageView const & rhs) = delete;
+
+    /** \brief Check whether the exception message matches.
+     *
+     * \param[in] e  The exception to check.
+     *
+     * \return true if the what() message matches.
+     */
+    bool match(std::exception const & e) const override
+    {
+        std::string_view const what(e.what());
+        bool result(false);
+        switch(m_mode)
+        {
+        case mode_t::MODE_EQUALS:
+            result = what == m_expected_message;
+            break;
+
+        case mode_t::MODE_STARTS_WITH:
+            result = what.substr(0, m_expected_message.length()) == m_expected_message;
+            break;
+
+        case mode_t::MODE_CONTAINS:
+            result = what.find(m_expected_message) != std::string_view::npos;
+            break;
+
+        case mode_t::MODE_PATTERN:
+            result = m_pattern->match(what);
+            break;
+
+        }
+        if(result)
+        {
+            m_actual_message.clear();
+        }
+        else
+        {
+            // the exception is gone by the time describe() gets called
+            //
+            m_actual_message = what;
+        }
+        return result;
+    }
+
+    /** \brief Describe this matcher.
+     *
+     * This function is only called when the report needs it (i.e. on a
+     * failure or when successful results get reported too). It includes
+     * a small diff when the match failed.
+     *
+     * \return The description of this matcher.
+     */
+    virtual std::string describe() const override
+    {
+        std::string result;
+        switch(m_mode)
+        {
+        case mode_t::MODE_EQUALS:
+            result = "equals \"";
+            break;
+
+        case mode_t::MODE_STARTS_WITH:
+            result = "starts with \"";
+            break;
+
+        case mode_t::MODE_CONTAINS:
+            result = "contains \"";
+            break;
+
+        case mode_t::MODE_PATTERN:
+            result = "matches pattern \"";
+            break;
+
+        }
+        result += m_expected_message;
+        result += '"';
+        if(m_actual_message.empty())
+        {
+            return result;
+        }
+        switch(m_mode)
+        {
+        case mode_t::MODE_CONTAINS:
+            break;
+
+        case mode_t::MODE_PATTERN:
+            // a character diff against a pattern is meaningless
+            //
+            result += "\nmessage: \"";
+            result += m_actual_message;
+            result += '"';
+            break;
+
+        case mode_t::MODE_EQUALS:
+        case mode_t::MODE_STARTS_WITH:
+            result += '\n';
+            result += SNAP_CATCH2_NAMESPACE::detail::render_message_diff(
+                          m_expected_message
+                        , m_actual_message);
+            break;
+
+        }
+        return result;
+    }
+
+private:
+    std::string_view                m_expected_message = std::string_view();
+    mode_t                          m_mode = mode_t::MODE_EQUALS;
+    ExceptionMessagePattern const * m_pattern = nullptr;
+    mutable std::string             m_actual_message = std::string();
+};
+
+
+inline ExceptionMessageView ExceptionMessageEquals(std::string_view expected_message)
+{
+    return ExceptionMessageView(expected_message, ExceptionMessageView::mode_t::MODE_EQUALS);
+}
+
+
+inline ExceptionMessageView ExceptionMessageStartsWith(std::string_view expected_prefix)
+{
+    return ExceptionMessageView(expected_prefix, ExceptionMessageView::mode_t::MODE_STARTS_WITH);
+}
+
+
+inline ExceptionMessageView ExceptionMessageContains(std::string_view expected_part)
+{
+    return ExceptionMessageView(expected_part, ExceptionMessageView::mode_t::MODE_CONTAINS);
+}
+
+
+inline ExceptionMessageView ExceptionMessageMatches(ExceptionMessagePattern const & pattern)
+{
+    return ExceptionMessageView(pattern);
+}
+
+
+// the pattern must outlive the matcher, a temporary would not
+//
+ExceptionMessageView ExceptionMessageMatches(ExceptionMessagePattern && pattern) = delete;
+
+
 
 }
 // Matchers namespace